@@ -19,18 +19,132 @@
 
 #pragma once
 
+#include "prt/AttributeMap.h"
 #include "prt/Callbacks.h"
+#include "prt/SimpleOutputCallbacks.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 constexpr const wchar_t* ENCODER_ID_Maya = L"MayaEncoder";
 constexpr const wchar_t* EO_EMIT_ATTRIBUTES = L"emitAttributes";
 constexpr const wchar_t* EO_EMIT_MATERIALS = L"emitMaterials";
 constexpr const wchar_t* EO_EMIT_REPORTS = L"emitReports";
+constexpr const wchar_t* EO_PASS_HOLES = L"passHoles"; // if false, faces with holes are triangulated
+constexpr const wchar_t* EO_WELD_VERTICES = L"weldVertices"; // merge coincident vertices across meshes/materials
+constexpr const wchar_t* EO_WELD_TOLERANCE = L"weldTolerance"; // max distance of welded vertices (in PRT units)
+constexpr const wchar_t* EO_TEXTURE_ENCODING_THREADS = L"textureEncodingThreads"; // 0: one per hardware thread
+constexpr const wchar_t* EO_TEXTURE_PROFILE = L"textureProfile"; // one of the TEXTURE_PROFILE_* values
+
+// full resolution textures with default compression
+constexpr const wchar_t* TEXTURE_PROFILE_FINAL = L"final";
+// textures clamped to a maximum dimension with fastest compression, large textures are re-encoded even if they could be
+// copied, smaller ones keep their resolution
+constexpr const wchar_t* TEXTURE_PROFILE_INTERACTIVE = L"interactive";
 
 class IMayaCallbacks : public prt::Callbacks {
 public:
 	~IMayaCallbacks() override = default;
 
+	struct AttributeMapDestroyer {
+		void operator()(const prt::AttributeMap* am) const {
+			if (am != nullptr)
+				am->destroy();
+		}
+	};
+	using AttributeMapOwner = std::unique_ptr<const prt::AttributeMap, AttributeMapDestroyer>;
+
+	/**
+	 * Owning mesh buffers, handed over from the encoder to the callbacks by addMeshBuffer. The channels follow the
+	 * layout of the addMesh parameters. Consumers can keep (move) the vectors, no copy is required.
+	 */
+	struct MeshBuffer {
+		// bumped on every layout change, consumers must check mVersion before accessing the channels
+		static constexpr uint32_t VERSION = 1;
+		uint32_t mVersion = VERSION;
+
+		std::wstring mName;
+
+		std::vector<double> mCoords;
+		std::vector<double> mNormals;
+		std::vector<uint32_t> mFaceCounts;
+		std::vector<uint32_t> mVertexIndices;
+		std::vector<uint32_t> mNormalIndices;
+
+		std::vector<uint32_t> mHoleCounts; // empty if there are no holes
+		std::vector<uint32_t> mHoleIndices;
+
+		std::vector<std::vector<double>> mUvs; // per uv set
+		std::vector<std::vector<uint32_t>> mUvCounts;
+		std::vector<std::vector<uint32_t>> mUvIndices;
+
+		std::vector<uint32_t> mFaceRanges;
+		std::vector<AttributeMapOwner> mMaterials; // empty or mFaceRanges.size()-1 entries
+		std::vector<AttributeMapOwner> mReports;   // empty or mFaceRanges.size()-1 entries
+		std::vector<int32_t> mShapeIDs;            // mFaceRanges.size()-1 entries
+	};
+	using MeshBufferUPtr = std::unique_ptr<MeshBuffer>;
+
+	/**
+	 * Hands over the ownership of the mesh buffers. Might be called concurrently for different initial shapes.
+	 * The default implementation forwards to addMesh, override it to avoid copying the buffers.
+	 *
+	 * @param initialShapeIndex index of the initial shape the mesh has been generated from
+	 * @param mesh the generated mesh, never null
+	 */
+	virtual void addMeshBuffer(size_t initialShapeIndex, MeshBufferUPtr mesh) {
+		const size_t uvSets = mesh->mUvs.size();
+		std::vector<const double*> uvs(uvSets);
+		std::vector<size_t> uvsSizes(uvSets);
+		std::vector<const uint32_t*> uvCounts(uvSets);
+		std::vector<size_t> uvCountsSizes(uvSets);
+		std::vector<const uint32_t*> uvIndices(uvSets);
+		std::vector<size_t> uvIndicesSizes(uvSets);
+		for (size_t uvSet = 0; uvSet < uvSets; uvSet++) {
+			uvs[uvSet] = mesh->mUvs[uvSet].data();
+			uvsSizes[uvSet] = mesh->mUvs[uvSet].size();
+			uvCounts[uvSet] = mesh->mUvCounts[uvSet].data();
+			uvCountsSizes[uvSet] = mesh->mUvCounts[uvSet].size();
+			uvIndices[uvSet] = mesh->mUvIndices[uvSet].data();
+			uvIndicesSizes[uvSet] = mesh->mUvIndices[uvSet].size();
+		}
+
+		auto toPtrVec = [](const std::vector<AttributeMapOwner>& owners) {
+			std::vector<const prt::AttributeMap*> ptrs(owners.size());
+			for (size_t i = 0; i < owners.size(); i++)
+				ptrs[i] = owners[i].get();
+			return ptrs;
+		};
+		std::vector<const prt::AttributeMap*> materials = toPtrVec(mesh->mMaterials);
+		std::vector<const prt::AttributeMap*> reports = toPtrVec(mesh->mReports);
+
+		// clang-format off
+		addMesh(initialShapeIndex, mesh->mName.c_str(),
+		        mesh->mCoords.data(), mesh->mCoords.size(),
+		        mesh->mNormals.data(), mesh->mNormals.size(),
+		        mesh->mFaceCounts.data(), mesh->mFaceCounts.size(),
+		        mesh->mVertexIndices.data(), mesh->mVertexIndices.size(),
+		        mesh->mNormalIndices.data(), mesh->mNormalIndices.size(),
+		        mesh->mHoleCounts.data(), mesh->mHoleCounts.size(),
+		        mesh->mHoleIndices.data(), mesh->mHoleIndices.size(),
+		        uvs.data(), uvsSizes.data(),
+		        uvCounts.data(), uvCountsSizes.data(),
+		        uvIndices.data(), uvIndicesSizes.data(),
+		        uvSets,
+		        mesh->mFaceRanges.data(), mesh->mFaceRanges.size(),
+		        materials.empty() ? nullptr : materials.data(),
+		        reports.empty() ? nullptr : reports.data(),
+		        mesh->mShapeIDs.data());
+		// clang-format on
+	}
+
 	/**
+	 * Compatibility interface, the encoder only calls addMeshBuffer. The data is only valid during the call.
+	 * Might be called concurrently for different initial shapes.
+	 *
+	 * @param initialShapeIndex index of the initial shape the mesh has been generated from
 	 * @param name initial shape (primitive group) name, optionally used to create primitive groups on output
 	 * @param vtx vertex coordinate array
 	 * @param length of vertex coordinate array
@@ -40,6 +154,10 @@ public:
 	 * @param faceCountsSize number of faces (= size of faceCounts)
 	 * @param indices vertex attribute index array (grouped by counts)
 	 * @param indicesSize vertex attribute index array
+	 * @param holeCounts number of holes per face, empty if the mesh has no holes (see EO_PASS_HOLES)
+	 * @param holeCountsSize number of faces or 0
+	 * @param holeIndices face indices of the holes (grouped by holeCounts), hole faces are not part of the surface
+	 * @param holeIndicesSize length of hole index array
 	 * @param uvs array of texture coordinate arrays (same indexing as vertices per uv set)
 	 * @param uvsSizes lengths of uv arrays per uv set
 	 * @param uvSetsCount number of uv sets
@@ -50,13 +168,17 @@ public:
 	 * @param shapeIDs shape ids per face, contains faceRangesSize-1 values
 	 */
 	// clang-format off
-	virtual void addMesh(const wchar_t* name,
+	virtual void addMesh(size_t initialShapeIndex,
+	                     const wchar_t* name,
 	                     const double* vtx, size_t vtxSize,
 	                     const double* nrm, size_t nrmSize,
 	                     const uint32_t* faceCounts, size_t faceCountsSize,
 	                     const uint32_t* vertexIndices, size_t vertexIndicesSize,
 	                     const uint32_t* normalIndices, size_t normalIndicesSize,
 
+	                     const uint32_t* holeCounts, size_t holeCountsSize,
+	                     const uint32_t* holeIndices, size_t holeIndicesSize,
+
 	                     double const* const* uvs, size_t const* uvsSizes,
 	                     uint32_t const* const* uvCounts, size_t const* uvCountsSizes,
 	                     uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
@@ -75,9 +197,33 @@ public:
 	 *
 	 * @param uri the original asset within the RPK
 	 * @param fileName local fileName derived from the URI by the asset encoder. can be used to cache the asset.
-	 * @param [out] result file system path of the locally cached asset. Expected to be valid for the whole process
-	 * life-time.
+	 * @param [out] result file system path of the locally cached asset. The path is returned right away, the file
+	 * might be written asynchronously: it only exists after AssetCache::flush() and may be deleted again when the
+	 * cache is pruned (AssetCache::prune).
 	 */
 	virtual void addAsset(const wchar_t* uri, const wchar_t* fileName, const uint8_t* buffer, size_t size,
 	                      wchar_t* result, size_t& resultSize) = 0;
+
+	/**
+	 * Creates output callbacks for the encoder to write a single asset into (see addStagedAsset). Each call returns new
+	 * callbacks, they are owned by the IMayaCallbacks and stay valid as long as it does. The default implementation
+	 * does not support staging (nullptr), the encoder then passes the assets in memory to addAsset. Must be thread-safe,
+	 * the encoder calls it from its texture encoding threads.
+	 */
+	virtual prt::SimpleOutputCallbacks* createAssetStagingCallbacks() {
+		return nullptr;
+	}
+
+	/**
+	 * Like addAsset, but the asset has already been written to staging callbacks obtained from
+	 * createAssetStagingCallbacks. The callbacks take over the written file.
+	 *
+	 * @param [out] result file system path of the locally cached asset, it may be deleted again when the cache is
+	 * pruned (AssetCache::prune)
+	 */
+	virtual void addStagedAsset(const wchar_t* /*uri*/, const wchar_t* /*fileName*/,
+	                            prt::SimpleOutputCallbacks* /*stagingCallbacks*/, wchar_t* /*result*/,
+	                            size_t& resultSize) {
+		resultSize = 0;
+	}
 };
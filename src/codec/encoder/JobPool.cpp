@@ -0,0 +1,114 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "encoder/JobPool.h"
+
+#include <algorithm>
+#include <system_error>
+
+namespace {
+
+void runJobs(std::atomic<size_t>& nextJob, size_t jobCount, const JobPool::Job& job) {
+	for (size_t i = nextJob++; i < jobCount; i = nextJob++)
+		job(i);
+}
+
+} // namespace
+
+JobPool::JobPool(size_t maxHelperThreads) : mMaxHelperThreads(maxHelperThreads) {}
+
+JobPool::~JobPool() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mBatchAvailable.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+}
+
+void JobPool::run(size_t jobCount, size_t threadCount, const Job& job) {
+	if (jobCount == 0)
+		return;
+
+	Batch batch{job, jobCount, std::min(std::max<size_t>(threadCount, 1), jobCount) - 1};
+	if (batch.mMaxHelpers > 0) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mStopping) {
+			mBatches.push_back(&batch);
+			startHelpers(batch.mMaxHelpers);
+		}
+	}
+	mBatchAvailable.notify_all();
+
+	// the batch lives on this stack frame, no helper must access it after run() returns (also if a job throws)
+	struct BatchGuard {
+		JobPool& mPool;
+		Batch& mBatch;
+		~BatchGuard() {
+			std::unique_lock<std::mutex> lock(mPool.mMutex);
+			const auto it = std::find(mPool.mBatches.begin(), mPool.mBatches.end(), &mBatch);
+			if (it != mPool.mBatches.end())
+				mPool.mBatches.erase(it);
+			mPool.mHelperDone.wait(lock, [this]() { return mBatch.mHelpers == 0; });
+		}
+	} guard{*this, batch};
+
+	runJobs(batch.mNextJob, batch.mJobCount, batch.mJob);
+}
+
+void JobPool::startHelpers(size_t count) {
+	const size_t targetThreadCount = std::min(mMaxHelperThreads, count);
+	while (mThreads.size() < targetThreadCount) {
+		try {
+			mThreads.emplace_back(&JobPool::work, this);
+		}
+		catch (const std::system_error&) {
+			break; // e.g. the thread limit is reached, the calling threads do the work
+		}
+	}
+}
+
+JobPool::Batch* JobPool::findBatch() {
+	for (Batch* batch : mBatches) {
+		if (batch->mHelpers < batch->mMaxHelpers && batch->mNextJob < batch->mJobCount)
+			return batch;
+	}
+	return nullptr;
+}
+
+void JobPool::work() {
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true) {
+		Batch* batch = nullptr;
+		mBatchAvailable.wait(lock, [this, &batch]() {
+			batch = findBatch();
+			return mStopping || batch != nullptr;
+		});
+		if (mStopping)
+			return;
+
+		batch->mHelpers++;
+		lock.unlock();
+		runJobs(batch->mNextJob, batch->mJobCount, batch->mJob);
+		lock.lock();
+		batch->mHelpers--;
+		mHelperDone.notify_all();
+	}
+}
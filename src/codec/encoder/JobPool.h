@@ -0,0 +1,69 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent helper threads shared by all concurrent run() calls, e.g. PRT calls the encoder from several of its worker
+ * threads at once. The helpers are started on demand and live until the pool is destroyed. The calling thread always
+ * works on its own jobs too, so run() completes even if no helper thread is available.
+ */
+class JobPool {
+public:
+	using Job = std::function<void(size_t jobIndex)>;
+
+	explicit JobPool(size_t maxHelperThreads);
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+	~JobPool(); // waits for the jobs being executed and stops the helper threads
+
+	// runs job(i) for all i < jobCount on up to threadCount threads (incl. the calling one), job must not throw
+	void run(size_t jobCount, size_t threadCount, const Job& job);
+
+private:
+	struct Batch {
+		const Job& mJob;
+		const size_t mJobCount;
+		const size_t mMaxHelpers;
+		std::atomic<size_t> mNextJob{0};
+		size_t mHelpers = 0; // guarded by mMutex
+	};
+
+	void startHelpers(size_t count); // expects mMutex to be locked
+	Batch* findBatch();              // expects mMutex to be locked
+	void work();
+
+	const size_t mMaxHelperThreads;
+
+	std::mutex mMutex;
+	std::condition_variable mBatchAvailable;
+	std::condition_variable mHelperDone;
+	std::deque<Batch*> mBatches;
+	std::vector<std::thread> mThreads;
+	bool mStopping = false;
+};
@@ -20,6 +20,7 @@
 #include "encoder/IMayaCallbacks.h"
 #include "encoder/MayaEncoder.h"
 #include "encoder/TextureEncoder.h"
+#include "encoder/VertexWelding.h"
 
 #include "prtx/Attributable.h"
 #include "prtx/DataBackend.h"
@@ -44,8 +45,12 @@
 #include <limits>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <set>
 #include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 // PRT version < 2.1
@@ -84,6 +89,10 @@ const prtx::EncodePreparator::PreparationFlags PREP_FLAGS =
                 .processVertexNormals(prtx::VertexNormalProcessor::SET_MISSING_TO_FACE_NORMALS)
                 .indexSharing(prtx::EncodePreparator::PreparationFlags::INDICES_SEPARATE_FOR_ALL_VERTEX_ATTRIBUTES);
 
+// holes are passed as separate faces and referenced by their parent face, see EO_PASS_HOLES
+const prtx::EncodePreparator::PreparationFlags PREP_FLAGS_PASS_HOLES =
+        prtx::EncodePreparator::PreparationFlags(PREP_FLAGS).processHoles(prtx::HoleProcessor::PASS);
+
 std::vector<const wchar_t*> toPtrVec(const prtx::WStringVector& wsv) {
 	std::vector<const wchar_t*> pw(wsv.size());
 	for (size_t i = 0; i < wsv.size(); i++)
@@ -91,17 +100,6 @@ std::vector<const wchar_t*> toPtrVec(const prtx::WStringVector& wsv) {
 	return pw;
 }
 
-template <typename T>
-std::pair<std::vector<const T*>, std::vector<size_t>> toPtrVec(const std::vector<std::vector<T>>& v) {
-	std::vector<const T*> pv(v.size());
-	std::vector<size_t> ps(v.size());
-	for (size_t i = 0; i < v.size(); i++) {
-		pv[i] = v[i].data();
-		ps[i] = v[i].size();
-	}
-	return std::make_pair(pv, ps);
-}
-
 template <typename C, typename FUNC, typename OBJ, typename... ARGS>
 std::basic_string<C> callAPI(FUNC f, OBJ& obj, ARGS&&... args) {
 	std::vector<C> buffer(1024, 0x0);
@@ -116,7 +114,119 @@ std::basic_string<C> callAPI(FUNC f, OBJ& obj, ARGS&&... args) {
 	return {buffer.data()};
 }
 
-std::wstring getTexturePath(const prtx::TexturePtr& texture, IMayaCallbacks* callbacks, prt::Cache* cache) {
+// textures which are neither local files nor RPK entries (i.e. builtin or in-memory) need to be (re-)encoded,
+// as well as textures exceeding the limits of the texture profile
+bool needsEncoding(const prtx::TexturePtr& texture, TextureEncoder::Profile profile) {
+	if (!texture || !texture->isValid())
+		return false;
+	if (TextureEncoder::exceedsProfile(*texture, profile))
+		return true;
+
+	const prtx::URIPtr& uri = texture->getURI();
+	const std::wstring& scheme = uri->getScheme();
+	const bool isLocalFile =
+	        !uri->isComposite() && (scheme == prtx::URI::SCHEME_FILE || scheme == prtx::URI::SCHEME_UNC);
+	const bool isRPKEntry = uri->isComposite() && (scheme == prtx::URI::SCHEME_RPK);
+	return !isLocalFile && !isRPKEntry;
+}
+
+struct EncodedTexture {
+	std::wstring fileName;
+	prtx::PRTUtils::MemoryOutputCallbacksUPtr data; // only set if the texture has been encoded into memory
+	prt::SimpleOutputCallbacks* staging = nullptr;  // only set if the texture has been written to staging callbacks
+};
+
+/**
+ * Encodes the texture directly into the staging callbacks (owned by the IMayaCallbacks), or into memory if there are
+ * none. Thread-safe, the encoded texture is passed to the IMayaCallbacks by writeEncodedTexture.
+ */
+std::optional<EncodedTexture> encodeTexture(const prtx::TexturePtr& texture, TextureEncoder::Profile profile,
+                                            prt::SimpleOutputCallbacks* stagingCallbacks) {
+	const std::wstring& uriStr = texture->getURI()->wstring();
+	try {
+		EncodedTexture encoded;
+
+		prtx::AsciiFileNamePreparator namePrep;
+		const prtx::NamePreparator::NamespacePtr& namePrepNamespace = namePrep.newNamespace();
+
+		if (stagingCallbacks != nullptr) {
+			encoded.fileName = TextureEncoder::encode(texture, stagingCallbacks, namePrep, namePrepNamespace, {},
+			                                          TextureEncoder::Format::AUTO, profile);
+			encoded.staging = stagingCallbacks;
+			return encoded;
+		}
+
+		encoded.data.reset(prt::MemoryOutputCallbacks::create());
+		encoded.fileName = TextureEncoder::encode(texture, encoded.data.get(), namePrep, namePrepNamespace, {},
+		                                          TextureEncoder::Format::AUTO, profile);
+
+		if (encoded.data->getNumBlocks() == 1)
+			return encoded;
+		else
+			srl_log_warn("Failed to get texture at %1%, texture will be missing") % uriStr;
+	}
+	catch (std::exception& e) {
+		srl_log_warn("Failed to encode texture at %1%: %2%") % uriStr % e.what();
+	}
+	return {};
+}
+
+std::wstring writeEncodedTexture(const std::wstring& uriStr, const EncodedTexture& encoded, IMayaCallbacks* callbacks) {
+	try {
+		std::wstring assetPath;
+		if (encoded.staging != nullptr) {
+			assetPath = callAPI<wchar_t>(&IMayaCallbacks::addStagedAsset, *callbacks, uriStr.c_str(),
+			                             encoded.fileName.c_str(), encoded.staging);
+		}
+		else {
+			size_t bufferSize = 0;
+			const uint8_t* buffer = encoded.data->getBlock(0, &bufferSize);
+			assetPath = callAPI<wchar_t>(&IMayaCallbacks::addAsset, *callbacks, uriStr.c_str(),
+			                             encoded.fileName.c_str(), buffer, bufferSize);
+		}
+
+		if (!assetPath.empty())
+			return assetPath;
+		else
+			srl_log_warn("Received invalid asset path while trying to write asset with URI: %1%") % uriStr;
+	}
+	catch (std::exception& e) {
+		srl_log_warn("Failed to write texture at %1% to the local filesystem: %2%") % uriStr % e.what();
+	}
+	return {};
+}
+
+// asset paths of the (re-)encoded textures by texture URI
+using EncodedTexturePaths = std::unordered_map<std::wstring, std::wstring>;
+
+/**
+ * Encodes the textures concurrently and writes them serially to the callbacks afterwards.
+ *
+ * @param threadCount maximum number of encoding threads, 0 means one per hardware thread
+ */
+EncodedTexturePaths encodeTextures(const std::vector<prtx::TexturePtr>& textures, IMayaCallbacks* callbacks,
+                                   TextureEncoder::Profile profile, JobPool& pool, size_t threadCount) {
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	// createAssetStagingCallbacks is thread-safe, addStagedAsset and addAsset are called serially below
+	std::vector<std::optional<EncodedTexture>> encoded(textures.size());
+	pool.run(textures.size(), threadCount, [&](size_t i) {
+		encoded[i] = encodeTexture(textures[i], profile, callbacks->createAssetStagingCallbacks());
+	});
+
+	EncodedTexturePaths paths;
+	for (size_t i = 0; i < textures.size(); i++) {
+		if (encoded[i]) {
+			const std::wstring& uriStr = textures[i]->getURI()->wstring();
+			paths.emplace(uriStr, writeEncodedTexture(uriStr, *encoded[i], callbacks));
+		}
+	}
+	return paths;
+}
+
+std::wstring getTexturePath(const prtx::TexturePtr& texture, IMayaCallbacks* callbacks, prt::Cache* cache,
+                            TextureEncoder::Profile profile, const EncodedTexturePaths& encodedTexturePaths) {
 	if (!texture || !texture->isValid())
 		return {};
 
@@ -124,7 +234,19 @@ std::wstring getTexturePath(const prtx::TexturePtr& texture, IMayaCallbacks* cal
 	const std::wstring& uriStr = uri->wstring();
 	const std::wstring& scheme = uri->getScheme();
 
-	if (!uri->isComposite() && (scheme == prtx::URI::SCHEME_FILE || scheme == prtx::URI::SCHEME_UNC)) {
+	if (needsEncoding(texture, profile)) {
+		// builtin or in-memory textures (and textures too large for the profile) need to be extracted and
+		// re-encoded, usually this already happened in encodeTextures
+		const auto it = encodedTexturePaths.find(uriStr);
+		if (it != encodedTexturePaths.end())
+			return it->second;
+
+		const std::optional<EncodedTexture> encoded =
+		        encodeTexture(texture, profile, callbacks->createAssetStagingCallbacks());
+		if (encoded)
+			return writeEncodedTexture(uriStr, *encoded, callbacks);
+	}
+	else if (!uri->isComposite() && (scheme == prtx::URI::SCHEME_FILE || scheme == prtx::URI::SCHEME_UNC)) {
 		// textures from the local file system or a mounted share on Windows can be directly passed to Serlio
 		return uri->getNativeFormat();
 	}
@@ -138,35 +260,6 @@ std::wstring getTexturePath(const prtx::TexturePtr& texture, IMayaCallbacks* cal
 		                                                fileName.c_str(), data->data(), data->size());
 		return assetPath;
 	}
-	else {
-		// all other textures (builtin or from memory) need to be extracted and potentially re-encoded
-		try {
-			prtx::PRTUtils::MemoryOutputCallbacksUPtr moc(prt::MemoryOutputCallbacks::create());
-
-			prtx::AsciiFileNamePreparator namePrep;
-			const prtx::NamePreparator::NamespacePtr& namePrepNamespace = namePrep.newNamespace();
-			const std::wstring validatedFilename =
-			        TextureEncoder::encode(texture, moc.get(), namePrep, namePrepNamespace, {});
-
-			if (moc->getNumBlocks() == 1) {
-				size_t bufferSize = 0;
-				const uint8_t* buffer = moc->getBlock(0, &bufferSize);
-
-				const std::wstring assetPath = callAPI<wchar_t>(&IMayaCallbacks::addAsset, *callbacks, uriStr.c_str(),
-				                                                validatedFilename.c_str(), buffer, bufferSize);
-				if (!assetPath.empty())
-					return assetPath;
-				else
-					srl_log_warn("Received invalid asset path while trying to write asset with URI: %1%") % uriStr;
-			}
-			else {
-				srl_log_warn("Failed to get texture at %1%, texture will be missing") % uriStr;
-			}
-		}
-		catch (std::exception& e) {
-			srl_log_warn("Failed to encode or write texture at %1% to the local filesystem: %2%") % uriStr % e.what();
-		}
-	}
 
 	return {};
 }
@@ -255,8 +348,39 @@ const std::set<std::wstring> MATERIAL_ATTRIBUTE_BLACKLIST = {
 #endif
 };
 
+// collects the distinct textures of the materials which need to be encoded (in order of their first use)
+std::vector<prtx::TexturePtr> collectTexturesToEncode(const std::vector<prtx::MaterialPtrVector>& materials,
+                                                     TextureEncoder::Profile profile) {
+	std::vector<prtx::TexturePtr> textures;
+	std::set<std::wstring> uris;
+	auto addTexture = [&textures, &uris, profile](const prtx::TexturePtr& t) {
+		if (needsEncoding(t, profile) && uris.insert(t->getURI()->wstring()).second)
+			textures.push_back(t);
+	};
+
+	for (const prtx::MaterialPtrVector& mats : materials) {
+		for (const prtx::MaterialPtr& mat : mats) {
+			for (const auto& key : mat->getKeys()) {
+				if (MATERIAL_ATTRIBUTE_BLACKLIST.count(key) > 0)
+					continue;
+
+				if (mat->getType(key) == prtx::Material::PT_TEXTURE) {
+					addTexture(mat->getTexture(key));
+				}
+				else if (mat->getType(key) == prtx::Material::PT_TEXTURE_ARRAY) {
+					for (const auto& t : mat->getTextureArray(key))
+						addTexture(t);
+				}
+			}
+		}
+	}
+
+	return textures;
+}
+
 void convertMaterialToAttributeMap(prtx::PRTUtils::AttributeMapBuilderPtr& aBuilder, const prtx::Material& prtxAttr,
-                                   const prtx::WStringVector& keys, IMayaCallbacks* cb, prt::Cache* cache) {
+                                   const prtx::WStringVector& keys, IMayaCallbacks* cb, prt::Cache* cache,
+                                   TextureEncoder::Profile profile, const EncodedTexturePaths& encodedTexturePaths) {
 	if constexpr (DBG)
 		srl_log_debug(L"-- converting material: %1%") % prtxAttr.name();
 	for (const auto& key : keys) {
@@ -315,7 +439,7 @@ void convertMaterialToAttributeMap(prtx::PRTUtils::AttributeMapBuilderPtr& aBuil
 
 			case prtx::Material::PT_TEXTURE: {
 				const auto& t = prtxAttr.getTexture(key);
-				const std::wstring p = getTexturePath(t, cb, cache);
+				const std::wstring p = getTexturePath(t, cb, cache, profile, encodedTexturePaths);
 				aBuilder->setString(key.c_str(), p.c_str());
 				break;
 			}
@@ -327,7 +451,7 @@ void convertMaterialToAttributeMap(prtx::PRTUtils::AttributeMapBuilderPtr& aBuil
 				texPaths.reserve(ta.size());
 
 				for (const auto& tex : ta) {
-					const std::wstring texPath = getTexturePath(tex, cb, cache);
+					const std::wstring texPath = getTexturePath(tex, cb, cache, profile, encodedTexturePaths);
 					if (!texPath.empty())
 						texPaths.push_back(texPath);
 				}
@@ -398,30 +522,32 @@ void forwardGenericAttributes(IMayaCallbacks* hc, size_t initialShapeIndex, cons
 	           });
 }
 
-using AttributeMapNOPtrVector = std::vector<const prt::AttributeMap*>;
-
-struct AttributeMapNOPtrVectorOwner {
-	AttributeMapNOPtrVector v;
-	~AttributeMapNOPtrVectorOwner() {
-		for (const auto& m : v) {
-			if (m != nullptr)
-				m->destroy();
-		}
-	}
-};
-
 class SerializedGeometry {
 public:
 	SerializedGeometry(const prtx::GeometryPtrVector& geometries,
-	                   const std::vector<prtx::MaterialPtrVector>& materials) {
+	                   const std::vector<prtx::MaterialPtrVector>& materials, bool passHoles) {
 		reserveMemory(geometries, materials);
 		serialize(geometries, materials);
+		if (passHoles)
+			serializeHoles(geometries);
 	}
 
 	bool isEmpty() const {
 		return mCoords.empty() || mCounts.empty() || mVertexIndices.empty();
 	}
 
+	// merges vertices closer than tolerance, also across meshes (i.e. materials)
+	void weldVertices(double tolerance) {
+		const size_t vertexCount = mCoords.size() / 3;
+		if (!VertexWelding::weldVertices(mCoords, mCounts, mVertexIndices, tolerance)) {
+			srl_log_warn("Ignoring invalid weld tolerance %1%, it must be positive") % tolerance;
+			return;
+		}
+
+		if constexpr (DBG)
+			srl_log_debug("weldVertices: %1% -> %2% vertices") % vertexCount % (mCoords.size() / 3);
+	}
+
 private:
 	void reserveMemory(const prtx::GeometryPtrVector& geometries,
 	                   const std::vector<prtx::MaterialPtrVector>& materials) {
@@ -568,6 +694,31 @@ private:
 		}     // for all geometries
 	}
 
+	void serializeHoles(const prtx::GeometryPtrVector& geometries) {
+		mHoleCounts.reserve(mCounts.size());
+
+		uint32_t faceIndexBase = 0u;
+		bool hasHoles = false;
+		for (const auto& geo : geometries) {
+			const prtx::MeshPtrVector& meshes = geo->getMeshes();
+			for (const auto& mesh : meshes) {
+				for (uint32_t fi = 0, faceCount = mesh->getFaceCount(); fi < faceCount; ++fi) {
+					const uint32_t holeCnt = mesh->getFaceHolesCount(fi);
+					mHoleCounts.push_back(holeCnt);
+					const uint32_t* holeIdx = mesh->getFaceHolesIndices(fi);
+					for (uint32_t hi = 0; hi < holeCnt; hi++)
+						mHoleIndices.push_back(faceIndexBase + holeIdx[hi]);
+					hasHoles = hasHoles || (holeCnt > 0);
+				}
+				faceIndexBase += mesh->getFaceCount();
+			}
+		}
+
+		// do not bother the consumer with all-zero hole counts
+		if (!hasHoles)
+			mHoleCounts.clear();
+	}
+
 	struct TextureUVMapping {
 		std::wstring key;
 		uint8_t index;
@@ -618,6 +769,9 @@ public:
 	std::vector<uint32_t> mVertexIndices;
 	std::vector<uint32_t> mNormalIndices;
 
+	std::vector<uint32_t> mHoleCounts;
+	std::vector<uint32_t> mHoleIndices;
+
 	std::vector<prtx::DoubleVector> mUvs;
 	std::vector<prtx::IndexVector> mUvCounts;
 	std::vector<prtx::IndexVector> mUvIndices;
@@ -625,8 +779,9 @@ public:
 
 } // namespace
 
-MayaEncoder::MayaEncoder(const std::wstring& id, const prt::AttributeMap* options, prt::Callbacks* callbacks)
-    : prtx::GeometryEncoder(id, options, callbacks) {}
+MayaEncoder::MayaEncoder(const std::wstring& id, const prt::AttributeMap* options, prt::Callbacks* callbacks,
+                         JobPool& textureEncodingPool)
+    : prtx::GeometryEncoder(id, options, callbacks), mTextureEncodingPool(textureEncodingPool) {}
 
 void MayaEncoder::init(prtx::GenerateContext&) {
 	prt::Callbacks* cb = getCallbacks();
@@ -664,12 +819,14 @@ void MayaEncoder::encode(prtx::GenerateContext& context, size_t initialShapeInde
 			forwardGenericAttributes(cb, initialShapeIndex, initialShape, shape);
 	}
 
+	const bool passHoles = getOptions()->getBool(EO_PASS_HOLES);
+
 	prtx::EncodePreparator::InstanceVector instances;
-	encPrep->fetchFinalizedInstances(instances, PREP_FLAGS);
-	convertGeometry(initialShape, instances, cb, context.getCache());
+	encPrep->fetchFinalizedInstances(instances, passHoles ? PREP_FLAGS_PASS_HOLES : PREP_FLAGS);
+	convertGeometry(initialShapeIndex, initialShape, instances, cb, context.getCache());
 }
 
-void MayaEncoder::convertGeometry(const prtx::InitialShape& initialShape,
+void MayaEncoder::convertGeometry(size_t initialShapeIndex, const prtx::InitialShape& initialShape,
                                   const prtx::EncodePreparator::InstanceVector& instances, IMayaCallbacks* cb,
                                   prt::Cache* cache) {
 	if (instances.empty())
@@ -695,20 +852,36 @@ void MayaEncoder::convertGeometry(const prtx::InitialShape& initialShape,
 		shapeIDs.push_back(inst.getShapeId());
 	}
 
-	const SerializedGeometry sg(geometries, materials);
+	const bool passHoles = getOptions()->getBool(EO_PASS_HOLES);
+	SerializedGeometry sg(geometries, materials, passHoles);
 
 	if (sg.isEmpty())
 		return;
 
+	if (getOptions()->getBool(EO_WELD_VERTICES))
+		sg.weldVertices(getOptions()->getFloat(EO_WELD_TOLERANCE));
+
 	if constexpr (DBG) {
 		srl_log_debug("resolvemap: %s") % prtx::PRTUtils::objectToXML(initialShape.getResolveMap());
 		srl_log_debug("encoder #materials = %s") % materials.size();
 	}
 
+	const wchar_t* textureProfileName = getOptions()->getString(EO_TEXTURE_PROFILE);
+	const bool isInteractive =
+	        (textureProfileName != nullptr) && (std::wstring_view(textureProfileName) == TEXTURE_PROFILE_INTERACTIVE);
+	const TextureEncoder::Profile textureProfile =
+	        isInteractive ? TextureEncoder::Profile::INTERACTIVE : TextureEncoder::Profile::FINAL;
+
+	EncodedTexturePaths encodedTexturePaths;
+	if (emitMaterials) {
+		const std::vector<prtx::TexturePtr> textures = collectTexturesToEncode(materials, textureProfile);
+		const int32_t threadCount = getOptions()->getInt(EO_TEXTURE_ENCODING_THREADS);
+		encodedTexturePaths = encodeTextures(textures, cb, textureProfile, mTextureEncodingPool,
+		                                     static_cast<size_t>(std::max(threadCount, 0)));
+	}
+
+	auto mesh = std::make_unique<IMayaCallbacks::MeshBuffer>();
 	uint32_t faceCount = 0;
-	std::vector<uint32_t> faceRanges;
-	AttributeMapNOPtrVectorOwner matAttrMaps;
-	AttributeMapNOPtrVectorOwner reportAttrMaps;
 
 	assert(geometries.size() == reports.size());
 	assert(materials.size() == reports.size());
@@ -722,18 +895,19 @@ void MayaEncoder::convertGeometry(const prtx::InitialShape& initialShape,
 			const prtx::MeshPtr& m = meshes.at(mi);
 			const prtx::MaterialPtr& mat = matIt->at(mi);
 
-			faceRanges.push_back(faceCount);
+			mesh->mFaceRanges.push_back(faceCount);
 
 			if (emitMaterials) {
-				convertMaterialToAttributeMap(amb, *(mat.get()), mat->getKeys(), cb, cache);
-				matAttrMaps.v.push_back(amb->createAttributeMapAndReset());
+				convertMaterialToAttributeMap(amb, *(mat.get()), mat->getKeys(), cb, cache, textureProfile,
+				                              encodedTexturePaths);
+				mesh->mMaterials.emplace_back(amb->createAttributeMapAndReset());
 			}
 
 			if (emitReports) {
 				convertReportsToAttributeMap(amb, *repIt);
-				reportAttrMaps.v.push_back(amb->createAttributeMapAndReset());
+				mesh->mReports.emplace_back(amb->createAttributeMapAndReset());
 				if constexpr (DBG)
-					srl_log_debug("report attr map: %1%") % prtx::PRTUtils::objectToXML(reportAttrMaps.v.back());
+					srl_log_debug("report attr map: %1%") % prtx::PRTUtils::objectToXML(mesh->mReports.back().get());
 			}
 
 			faceCount += m->getFaceCount();
@@ -742,25 +916,27 @@ void MayaEncoder::convertGeometry(const prtx::InitialShape& initialShape,
 		++matIt;
 		++repIt;
 	}
-	faceRanges.push_back(faceCount); // close last range
-
-	assert(matAttrMaps.v.empty() || matAttrMaps.v.size() == faceRanges.size() - 1);
-	assert(reportAttrMaps.v.empty() || reportAttrMaps.v.size() == faceRanges.size() - 1);
-	assert(shapeIDs.size() == faceRanges.size() - 1);
-
-	auto puvs = toPtrVec(sg.mUvs);
-	auto puvCounts = toPtrVec(sg.mUvCounts);
-	auto puvIndices = toPtrVec(sg.mUvIndices);
-
-	cb->addMesh(initialShape.getName(), sg.mCoords.data(), sg.mCoords.size(), sg.mNormals.data(), sg.mNormals.size(),
-	            sg.mCounts.data(), sg.mCounts.size(), sg.mVertexIndices.data(), sg.mVertexIndices.size(),
-	            sg.mNormalIndices.data(), sg.mNormalIndices.size(),
-
-	            puvs.first.data(), puvs.second.data(), puvCounts.first.data(), puvCounts.second.data(),
-	            puvIndices.first.data(), puvIndices.second.data(), sg.mUvs.size(),
-
-	            faceRanges.data(), faceRanges.size(), matAttrMaps.v.empty() ? nullptr : matAttrMaps.v.data(),
-	            reportAttrMaps.v.empty() ? nullptr : reportAttrMaps.v.data(), shapeIDs.data());
+	mesh->mFaceRanges.push_back(faceCount); // close last range
+
+	assert(mesh->mMaterials.empty() || mesh->mMaterials.size() == mesh->mFaceRanges.size() - 1);
+	assert(mesh->mReports.empty() || mesh->mReports.size() == mesh->mFaceRanges.size() - 1);
+	assert(shapeIDs.size() == mesh->mFaceRanges.size() - 1);
+
+	// hand over the serialized buffers without copying them
+	mesh->mName = initialShape.getName();
+	mesh->mCoords = std::move(sg.mCoords);
+	mesh->mNormals = std::move(sg.mNormals);
+	mesh->mFaceCounts = std::move(sg.mCounts);
+	mesh->mVertexIndices = std::move(sg.mVertexIndices);
+	mesh->mNormalIndices = std::move(sg.mNormalIndices);
+	mesh->mHoleCounts = std::move(sg.mHoleCounts);
+	mesh->mHoleIndices = std::move(sg.mHoleIndices);
+	mesh->mUvs = std::move(sg.mUvs);
+	mesh->mUvCounts = std::move(sg.mUvCounts);
+	mesh->mUvIndices = std::move(sg.mUvIndices);
+	mesh->mShapeIDs = std::move(shapeIDs);
+
+	cb->addMeshBuffer(initialShapeIndex, std::move(mesh));
 
 	if constexpr (DBG)
 		srl_log_debug(L"MayaEncoder::convertGeometry: end");
@@ -780,7 +956,21 @@ MayaEncoderFactory* MayaEncoderFactory::createInstance() {
 	amb->setBool(EO_EMIT_ATTRIBUTES, prtx::PRTX_TRUE);
 	amb->setBool(EO_EMIT_MATERIALS, prtx::PRTX_TRUE);
 	amb->setBool(EO_EMIT_REPORTS, prtx::PRTX_FALSE);
+	amb->setBool(EO_PASS_HOLES, prtx::PRTX_FALSE);
+	amb->setBool(EO_WELD_VERTICES, prtx::PRTX_FALSE);
+	amb->setFloat(EO_WELD_TOLERANCE, 1e-4);
+	amb->setInt(EO_TEXTURE_ENCODING_THREADS, 0);
+	amb->setString(EO_TEXTURE_PROFILE, TEXTURE_PROFILE_FINAL);
 	encoderInfoBuilder.setDefaultOptions(amb->createAttributeMap());
 
 	return new MayaEncoderFactory(encoderInfoBuilder.create());
 }
+
+MayaEncoderFactory::MayaEncoderFactory(const prt::EncoderInfo* info)
+    : prtx::EncoderFactory(info),
+      mTextureEncodingPool(std::make_unique<JobPool>(std::max(std::thread::hardware_concurrency(), 1u))) {}
+
+// the texture encoder infos must not outlive PRT, the factories are destroyed when PRT shuts down
+MayaEncoderFactory::~MayaEncoderFactory() {
+	TextureEncoder::releaseEncoderIndex();
+}
@@ -21,6 +21,8 @@
 
 #include "CodecMain.h"
 
+#include "encoder/JobPool.h"
+
 #include "prtx/EncodePreparator.h"
 #include "prtx/Encoder.h"
 #include "prtx/EncoderFactory.h"
@@ -33,6 +35,7 @@
 #include "prt/InitialShape.h"
 
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
@@ -40,7 +43,8 @@ class IMayaCallbacks;
 
 class MayaEncoder : public prtx::GeometryEncoder {
 public:
-	MayaEncoder(const std::wstring& id, const prt::AttributeMap* options, prt::Callbacks* callbacks);
+	MayaEncoder(const std::wstring& id, const prt::AttributeMap* options, prt::Callbacks* callbacks,
+	            JobPool& textureEncodingPool);
 	~MayaEncoder() override = default;
 
 public:
@@ -49,19 +53,25 @@ public:
 	void finish(prtx::GenerateContext& context) override;
 
 private:
-	void convertGeometry(const prtx::InitialShape& initialShape,
+	void convertGeometry(size_t initialShapeIndex, const prtx::InitialShape& initialShape,
 	                     const prtx::EncodePreparator::InstanceVector& instances, IMayaCallbacks* callbacks,
 	                     prt::Cache* cache);
+
+	JobPool& mTextureEncodingPool; // owned by the factory
 };
 
 class MayaEncoderFactory : public prtx::EncoderFactory, public prtx::Singleton<MayaEncoderFactory> {
 public:
 	static MayaEncoderFactory* createInstance();
 
-	explicit MayaEncoderFactory(const prt::EncoderInfo* info) : prtx::EncoderFactory(info) {}
-	~MayaEncoderFactory() override = default;
+	explicit MayaEncoderFactory(const prt::EncoderInfo* info);
+	~MayaEncoderFactory() override;
 
 	MayaEncoder* create(const prt::AttributeMap* options, prt::Callbacks* callbacks) const override {
-		return new MayaEncoder(getID(), options, callbacks);
+		return new MayaEncoder(getID(), options, callbacks, *mTextureEncodingPool);
 	}
+
+private:
+	// shared by all encoders, its threads are stopped when PRT shuts down and destroys the factory
+	const std::unique_ptr<JobPool> mTextureEncodingPool;
 };
@@ -27,9 +27,14 @@
 
 #include "prt/EncoderInfo.h"
 
+#include <algorithm>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace TextureEncoder {
@@ -64,6 +69,16 @@ constexpr const wchar_t* EXISTING_FILES_SKIP = L"SKIP";
 
 } // namespace OptionNames
 
+// the speedup comes from clamping the dimensions (the encoders only downscale textures larger than MAX_DIMENSION), the
+// compression settings merely keep encoding the clamped textures fast and their files small
+namespace InteractiveProfile {
+
+constexpr uint32_t MAX_DIMENSION = 1024;
+constexpr double JPG_QUALITY = 0.75; // as fraction of the maximum quality
+constexpr int32_t PNG_COMPRESSION = 1;
+
+} // namespace InteractiveProfile
+
 std::wstring const& selectEncoderID(Format format) {
 	switch (format) {
 		case Format::JPG:
@@ -77,28 +92,104 @@ std::wstring const& selectEncoderID(Format format) {
 	}
 }
 
-std::wstring const getBestMatchingEncoder(const prtx::Texture& tex) {
-	const prtx::URIPtr& uri = tex.getURI();
+/**
+ * Immutable index of the registered texture encoders, built on first use (see getEncoderIndex). The registry does not
+ * change after PRT has been initialized, so encoder selection per texture does not need to scan it again.
+ */
+class EncoderIndex {
+public:
+	struct Entry {
+		prtx::PRTUtils::EncoderInfoPtr mInfo;
+		std::vector<std::wstring> mExtensions; // in order of preference
+		prtx::PRTUtils::AttributeMapPtr mDefaultOptions; // validated, without any per-texture options
+	};
+
+	static std::shared_ptr<const EncoderIndex> create() {
+		return std::shared_ptr<const EncoderIndex>(new EncoderIndex());
+	}
 
-	std::wstring const extension = uri->getExtension();
-	if (!extension.empty()) {
-		std::vector<std::wstring> availableEncoders;
-		prtx::ExtensionManager::instance().listEncoderIds(availableEncoders);
-
-		std::wstring bestId;
-		double bestMerit = std::numeric_limits<double>::lowest();
-		for (const auto& encId : availableEncoders) {
-			prtx::PRTUtils::EncoderInfoUPtr encInfo(prtx::ExtensionManager::instance().createEncoderInfo(encId));
-			if (encInfo->getType() == prt::CT_TEXTURE) {
-				const std::wstring_view extensions(encInfo->getExtensions());
-				const bool hasCompatibleFileExtension = (extensions.find(extension + L';') != std::wstring_view::npos);
-				if (hasCompatibleFileExtension && (encInfo->getMerit() > bestMerit)) {
-					bestId = encId;
-					bestMerit = encInfo->getMerit();
-				}
+	// empty if no texture encoder supports the extension
+	std::wstring getBestEncoder(const std::wstring& extension) const {
+		const auto it = mBestEncoderByExtension.find(extension);
+		return (it != mBestEncoderByExtension.end()) ? it->second.first : std::wstring();
+	}
+
+	const Entry& getEntry(const std::wstring& encoderId) const {
+		const auto it = mEntries.find(encoderId);
+		if (it == mEntries.end())
+			throw prtx::StatusException(prt::STATUS_ENCODER_NOT_FOUND);
+		return it->second;
+	}
+
+private:
+	EncoderIndex() {
+		std::vector<std::wstring> encoderIds;
+		prtx::ExtensionManager::instance().listEncoderIds(encoderIds);
+
+		for (const std::wstring& encId : encoderIds) {
+			prtx::PRTUtils::EncoderInfoPtr encInfo(prtx::ExtensionManager::instance().createEncoderInfo(encId));
+			if (!encInfo || encInfo->getType() != prt::CT_TEXTURE)
+				continue;
+
+			Entry entry;
+			entry.mInfo = encInfo;
+			entry.mExtensions = splitExtensions(encInfo->getExtensions());
+
+			const prtx::PRTUtils::AttributeMapBuilderPtr amb(prt::AttributeMapBuilder::create());
+			const prtx::PRTUtils::AttributeMapPtr emptyOpts{amb->createAttributeMap()};
+			const prt::AttributeMap* validOpts = nullptr;
+			encInfo->createValidatedOptionsAndStates(emptyOpts.get(), &validOpts);
+			entry.mDefaultOptions = prtx::PRTUtils::AttributeMapPtr{validOpts};
+
+			const double merit = encInfo->getMerit();
+			for (const std::wstring& ext : entry.mExtensions) {
+				auto it = mBestEncoderByExtension.find(ext);
+				if (it == mBestEncoderByExtension.end() || merit > it->second.second)
+					mBestEncoderByExtension[ext] = std::make_pair(encId, merit);
 			}
+
+			mEntries.emplace(encId, std::move(entry));
+		}
+	}
+
+	static std::vector<std::wstring> splitExtensions(const wchar_t* extensions) {
+		std::vector<std::wstring> result;
+		if (extensions == nullptr)
+			return result;
+
+		const std::wstring_view sv(extensions);
+		size_t start = 0;
+		while (start < sv.size()) {
+			const size_t end = std::min(sv.find(L';', start), sv.size());
+			if (end > start)
+				result.emplace_back(sv.substr(start, end - start));
+			start = end + 1;
 		}
+		return result;
+	}
+
+	std::unordered_map<std::wstring, Entry> mEntries;
+	std::unordered_map<std::wstring, std::pair<std::wstring, double>> mBestEncoderByExtension; // ext -> (id, merit)
+};
+
+// holds PRT objects, must be released before PRT shuts down (see releaseEncoderIndex)
+std::mutex encoderIndexMutex;
+std::shared_ptr<const EncoderIndex> cachedEncoderIndex;
 
+// textures being encoded keep the index alive while it is released
+std::shared_ptr<const EncoderIndex> getEncoderIndex() {
+	std::lock_guard<std::mutex> lock(encoderIndexMutex);
+	if (!cachedEncoderIndex)
+		cachedEncoderIndex = EncoderIndex::create();
+	return cachedEncoderIndex;
+}
+
+std::wstring const getBestMatchingEncoder(const EncoderIndex& encoderIndex, const prtx::Texture& tex) {
+	const prtx::URIPtr& uri = tex.getURI();
+
+	std::wstring const extension = uri->getExtension();
+	if (!extension.empty()) {
+		const std::wstring bestId = encoderIndex.getBestEncoder(extension);
 		if (!bestId.empty())
 			return bestId;
 	}
@@ -112,12 +203,14 @@ std::wstring const getBestMatchingEncoder(const prtx::Texture& tex) {
 		return IDs::PNG;
 }
 
-std::wstring getExtensionForEncoder(std::wstring const& textureEncoderID, std::wstring const& currentExt) {
-	const prtx::PRTUtils::EncoderInfoUPtr encoderInfo(
-	        prtx::ExtensionManager::instance().createEncoderInfo(textureEncoderID));
-	const std::wstring_view extensions(encoderInfo->getExtensions());
-	const bool hasCompatibleFileExtension = (extensions.find(currentExt + L';') != std::wstring_view::npos);
-	return hasCompatibleFileExtension ? currentExt : std::wstring(extensions.substr(0, extensions.find_first_of(L';')));
+std::wstring getExtensionForEncoder(const EncoderIndex& encoderIndex, std::wstring const& textureEncoderID,
+                                    std::wstring const& currentExt) {
+	const std::vector<std::wstring>& extensions = encoderIndex.getEntry(textureEncoderID).mExtensions;
+	const bool hasCompatibleFileExtension =
+	        (std::find(extensions.begin(), extensions.end(), currentExt) != extensions.end());
+	if (hasCompatibleFileExtension)
+		return currentExt;
+	return extensions.empty() ? std::wstring() : extensions.front();
 }
 
 std::wstring replaceExtension(std::wstring const& texName, std::wstring const& extension) {
@@ -146,43 +239,81 @@ std::wstring constructNameForTexture(const prtx::TexturePtr& texture, const std:
 	return baseName + extension;
 }
 
-prtx::PRTUtils::AttributeMapUPtr getEncOpts(const std::wstring& encoderId, const std::wstring& filename,
-                                            prt::SimpleOutputCallbacks::OpenMode openMode) {
-	prtx::PRTUtils::AttributeMapBuilderPtr builder(prt::AttributeMapBuilder::create());
+// sets a numeric option in the type the encoder expects, options unknown to the encoder are skipped
+void setNumericOption(prtx::PRTUtils::AttributeMapBuilderPtr& builder, const prt::AttributeMap* defaultOptions,
+                      const wchar_t* key, double floatValue, int32_t intValue) {
+	if (defaultOptions == nullptr || !defaultOptions->hasKey(key))
+		return;
+
+	switch (defaultOptions->getType(key)) {
+		case prt::AttributeMap::PT_FLOAT:
+			builder->setFloat(key, floatValue);
+			break;
+		case prt::AttributeMap::PT_INT:
+			builder->setInt(key, intValue);
+			break;
+		default:
+			break;
+	}
+}
+
+void setProfileOptions(prtx::PRTUtils::AttributeMapBuilderPtr& builder, const prt::AttributeMap* defaultOptions,
+                       const Profile& profile) {
+	if (profile != Profile::INTERACTIVE)
+		return; // the encoder defaults are full quality
+
+	using namespace InteractiveProfile;
+	setNumericOption(builder, defaultOptions, OptionNames::MAXDIM, MAX_DIMENSION, MAX_DIMENSION);
+	setNumericOption(builder, defaultOptions, OptionNames::JPG_QUALITY, JPG_QUALITY,
+	                 static_cast<int32_t>(JPG_QUALITY * 100.0));
+	setNumericOption(builder, defaultOptions, OptionNames::PNG_COMPRESSION, PNG_COMPRESSION, PNG_COMPRESSION);
+}
+
+prtx::PRTUtils::AttributeMapUPtr getEncOpts(const EncoderIndex& encoderIndex, const std::wstring& encoderId,
+                                            const std::wstring& filename,
+                                            prt::SimpleOutputCallbacks::OpenMode openMode, const Profile& profile) {
+	const EncoderIndex::Entry& encoder = encoderIndex.getEntry(encoderId);
+
+	prtx::PRTUtils::AttributeMapBuilderPtr builder(
+	        prt::AttributeMapBuilder::createFromAttributeMap(encoder.mDefaultOptions.get()));
 	builder->setString(OptionNames::NAME, filename.c_str());
 	builder->setBool(OptionNames::FLIPH, true);
 	auto const evExistingFiles = openMode == prt::SimpleOutputCallbacks::OPENMODE_ALWAYS
 	                                     ? OptionNames::EXISTING_FILES_OVERWRITE
 	                                     : OptionNames::EXISTING_FILES_SKIP;
 	builder->setString(OptionNames::EXISTING_FILES, evExistingFiles);
+	setProfileOptions(builder, encoder.mDefaultOptions.get(), profile);
 
-	const prtx::PRTUtils::EncoderInfoPtr encInfo(prtx::ExtensionManager::instance().createEncoderInfo(encoderId));
 	prtx::PRTUtils::AttributeMapPtr rawEncOpts{builder->createAttributeMap()};
 	const prt::AttributeMap* validOpts = nullptr;
-	encInfo->createValidatedOptionsAndStates(rawEncOpts.get(), &validOpts);
+	encoder.mInfo->createValidatedOptionsAndStates(rawEncOpts.get(), &validOpts);
 	return prtx::PRTUtils::AttributeMapUPtr(validOpts);
 }
 
 std::wstring encode(const prtx::TexturePtr& texture, prt::SimpleOutputCallbacks* soh,
                     prtx::NamePreparator& namePreparator, const prtx::NamePreparator::NamespacePtr& namespaceFilenames,
-                    const std::wstring& memTexFileNamePrefix, const Format& targetFormat) {
+                    const std::wstring& memTexFileNamePrefix, const Format& targetFormat, const Profile& profile) {
 	if (!texture || !texture->isValid())
 		throw prtx::StatusException(prt::STATUS_ILLEGAL_VALUE);
 
+	const std::shared_ptr<const EncoderIndex> encoderIndex = getEncoderIndex();
+
 	std::wstring textureEncoderID;
 	if (targetFormat == Format::AUTO)
-		textureEncoderID = getBestMatchingEncoder(*texture);
+		textureEncoderID = getBestMatchingEncoder(*encoderIndex, *texture);
 	else
 		textureEncoderID = selectEncoderID(targetFormat);
 
 	const std::wstring texName = constructNameForTexture(texture, memTexFileNamePrefix);
-	const std::wstring extension = getExtensionForEncoder(textureEncoderID, texture->getURI()->getExtension());
+	const std::wstring extension =
+	        getExtensionForEncoder(*encoderIndex, textureEncoderID, texture->getURI()->getExtension());
 	const std::wstring texNameWithExtension = replaceExtension(texName, extension);
 	const std::wstring uniqueName = namePreparator.legalizedAndUniquified(
 	        texNameWithExtension.substr(1), prtx::NamePreparator::ENTITY_FILE, namespaceFilenames);
 
 	prtx::PRTUtils::AttributeMapUPtr encOpts =
-	        getEncOpts(textureEncoderID, uniqueName, prt::SimpleOutputCallbacks::OpenMode::OPENMODE_ALWAYS);
+	        getEncOpts(*encoderIndex, textureEncoderID, uniqueName,
+	                   prt::SimpleOutputCallbacks::OpenMode::OPENMODE_ALWAYS, profile);
 	prtx::EncoderPtr texEnc = prtx::ExtensionManager::instance().createEncoder(textureEncoderID, encOpts.get(), soh);
 	texEnc->encode({texture});
 
@@ -196,4 +327,15 @@ std::wstring encode(const prtx::TexturePtr& texture, prt::SimpleOutputCallbacks*
 	return std::wstring(validatedName);
 }
 
+void releaseEncoderIndex() {
+	std::lock_guard<std::mutex> lock(encoderIndexMutex);
+	cachedEncoderIndex.reset();
+}
+
+bool exceedsProfile(const prtx::Texture& tex, const Profile& profile) {
+	if (profile != Profile::INTERACTIVE)
+		return false;
+	return std::max(tex.getWidth(), tex.getHeight()) > InteractiveProfile::MAX_DIMENSION;
+}
+
 } // namespace TextureEncoder
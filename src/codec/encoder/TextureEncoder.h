@@ -30,8 +30,18 @@ namespace TextureEncoder {
 
 enum class Format : uint8_t { AUTO, JPG, PNG, TIF };
 
+// FINAL: full quality, INTERACTIVE: clamped to a maximum dimension with fastest compression
+enum class Profile : uint8_t { FINAL, INTERACTIVE };
+
 std::wstring encode(const prtx::TexturePtr& tex, prt::SimpleOutputCallbacks* soh, prtx::NamePreparator& namePreparator,
                     const prtx::NamePreparator::NamespacePtr& namespaceFilenames,
-                    const std::wstring& memTexFileNamePrefix, const Format& targetFormat = Format::AUTO);
+                    const std::wstring& memTexFileNamePrefix, const Format& targetFormat = Format::AUTO,
+                    const Profile& profile = Profile::FINAL);
+
+// releases the cached texture encoder infos, call before PRT shuts down (e.g. when the encoder factory is destroyed)
+void releaseEncoderIndex();
+
+// true if the texture is larger than allowed by the profile, i.e. it needs to be re-encoded
+bool exceedsProfile(const prtx::Texture& tex, const Profile& profile);
 
 } // namespace TextureEncoder
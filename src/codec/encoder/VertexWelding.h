@@ -0,0 +1,148 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace VertexWelding {
+
+inline bool isValidTolerance(double tolerance) {
+	return std::isfinite(tolerance) && tolerance > 0.0;
+}
+
+/**
+ * Merges vertices closer than tolerance and removes unused vertices. Faces which would reference a welded vertex more
+ * than once keep their original vertices. Non-finite vertices are never welded. Leaves the geometry unchanged and
+ * returns false if the tolerance is not positive.
+ */
+inline bool weldVertices(std::vector<double>& coords, const std::vector<uint32_t>& counts,
+                         std::vector<uint32_t>& vertexIndices, double tolerance) {
+	if (!isValidTolerance(tolerance))
+		return false;
+
+	const uint32_t vertexCount = static_cast<uint32_t>(coords.size() / 3);
+	if (vertexCount == 0)
+		return true;
+
+	using Cell = std::array<int64_t, 3>;
+	struct CellHash {
+		size_t operator()(const Cell& c) const {
+			size_t seed = 0;
+			for (const int64_t v : c)
+				seed ^= std::hash<int64_t>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			return seed;
+		}
+	};
+
+	// larger cells for a tiny tolerance, the cell coordinates (and their neighbors) must fit into int64_t
+	constexpr double MAX_CELL_COORD = 4503599627370496.0; // 2^52
+	double maxAbsCoord = 0.0;
+	for (const double c : coords) {
+		if (std::isfinite(c))
+			maxAbsCoord = std::max(maxAbsCoord, std::abs(c));
+	}
+
+	// spatial hash with cells of at least tolerance size, coincident vertices are in the same or a neighboring cell
+	const double cellSize = std::max(tolerance, maxAbsCoord / MAX_CELL_COORD);
+	const double toleranceSq = tolerance * tolerance;
+	std::unordered_map<Cell, std::vector<uint32_t>, CellHash> grid;
+	grid.reserve(vertexCount);
+
+	auto findWeldTarget = [&](const double* p, const Cell& cell) -> std::optional<uint32_t> {
+		for (int64_t dx = -1; dx <= 1; dx++) {
+			for (int64_t dy = -1; dy <= 1; dy++) {
+				for (int64_t dz = -1; dz <= 1; dz++) {
+					const auto it = grid.find({cell[0] + dx, cell[1] + dy, cell[2] + dz});
+					if (it == grid.end())
+						continue;
+					for (const uint32_t ti : it->second) {
+						const double* q = &coords[3 * ti];
+						const double distSq = (p[0] - q[0]) * (p[0] - q[0]) + (p[1] - q[1]) * (p[1] - q[1]) +
+						                      (p[2] - q[2]) * (p[2] - q[2]);
+						if (distSq <= toleranceSq)
+							return ti;
+					}
+				}
+			}
+		}
+		return {};
+	};
+
+	std::vector<uint32_t> weldTargets(vertexCount);
+	for (uint32_t vi = 0; vi < vertexCount; vi++) {
+		weldTargets[vi] = vi;
+		const double* p = &coords[3 * vi];
+		if (!std::isfinite(p[0]) || !std::isfinite(p[1]) || !std::isfinite(p[2]))
+			continue;
+
+		const Cell cell = {static_cast<int64_t>(std::floor(p[0] / cellSize)),
+		                   static_cast<int64_t>(std::floor(p[1] / cellSize)),
+		                   static_cast<int64_t>(std::floor(p[2] / cellSize))};
+		const std::optional<uint32_t> target = findWeldTarget(p, cell);
+		if (target)
+			weldTargets[vi] = *target;
+		else
+			grid[cell].push_back(vi);
+	}
+
+	std::vector<uint32_t> faceIndices;
+	std::vector<uint32_t> sortedFaceIndices;
+	auto faceBegin = vertexIndices.begin();
+	for (const uint32_t vtxCnt : counts) {
+		faceIndices.resize(vtxCnt);
+		std::transform(faceBegin, faceBegin + vtxCnt, faceIndices.begin(),
+		               [&weldTargets](uint32_t vi) { return weldTargets[vi]; });
+
+		sortedFaceIndices = faceIndices;
+		std::sort(sortedFaceIndices.begin(), sortedFaceIndices.end());
+		const bool collapses =
+		        std::adjacent_find(sortedFaceIndices.begin(), sortedFaceIndices.end()) != sortedFaceIndices.end();
+		if (!collapses)
+			std::copy(faceIndices.begin(), faceIndices.end(), faceBegin);
+
+		faceBegin += vtxCnt;
+	}
+
+	// keep the referenced vertices only (in order of their first use)
+	constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> newIndices(vertexCount, NO_INDEX);
+	std::vector<double> weldedCoords;
+	weldedCoords.reserve(coords.size());
+	for (uint32_t& vi : vertexIndices) {
+		if (newIndices[vi] == NO_INDEX) {
+			newIndices[vi] = static_cast<uint32_t>(weldedCoords.size() / 3);
+			weldedCoords.insert(weldedCoords.end(), coords.begin() + 3 * vi, coords.begin() + 3 * vi + 3);
+		}
+		vi = newIndices[vi];
+	}
+
+	coords = std::move(weldedCoords);
+	return true;
+}
+
+} // namespace VertexWelding
@@ -19,7 +19,12 @@
 
 #include "PRTContext.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <future>
 #include <mutex>
+#include <sstream>
 
 namespace {
 
@@ -30,18 +35,133 @@ constexpr prt::LogLevel PRT_LOG_LEVEL = prt::LOG_INFO;
 constexpr bool ENABLE_LOG_CONSOLE = true;
 constexpr bool ENABLE_LOG_FILE = false;
 
+// optional directory to extract the rule packages to, e.g. if they are located on slow network storage
+constexpr const char* RPK_MIRROR_ENV_VAR = "SERLIO_RPK_MIRROR";
+
+std::filesystem::path getRPKMirrorDir() {
+	const char* mirrorDir = std::getenv(RPK_MIRROR_ENV_VAR);
+	if (mirrorDir == nullptr)
+		return {};
+	return std::filesystem::path(prtu::toUTF16FromOSNarrow(mirrorDir));
+}
+
+// optional comma separated list of the libraries to load from the ext directory instead of all of them, e.g. to reduce
+// the startup time and memory footprint of batch renders
+constexpr const char* PRT_EXTENSIONS_ENV_VAR = "SERLIO_PRT_EXTENSIONS";
+constexpr const wchar_t* PRT_EXTENSIONS_MINIMAL = L"minimal";
+constexpr wchar_t PRT_EXTENSIONS_SEPARATOR = L',';
+
+// the Maya encoder, the rule package adaptors and the geometry/texture codecs (i.e. no DWG/DXF and USD support)
+// attribute evaluation and the error/print encoders are built into PRT itself
+const std::vector<std::wstring> MINIMAL_PRT_EXTENSIONS = {L"serlio_codec", L"com.esri.prt.adaptors",
+                                                          L"com.esri.prt.codecs"};
+
+// optional PRT cache type: "default" or "nonredundant" (loads every resource only once, also for concurrent generate
+// calls, at the cost of more locking)
+constexpr const char* PRT_CACHE_ENV_VAR = "SERLIO_PRT_CACHE";
+constexpr const char* PRT_CACHE_DEFAULT = "default";
+constexpr const char* PRT_CACHE_NONREDUNDANT = "nonredundant";
+
+std::vector<std::wstring> getSelectedExtensions() {
+	const char* selection = std::getenv(PRT_EXTENSIONS_ENV_VAR);
+	if (selection == nullptr || *selection == '\0')
+		return {};
+
+	const std::wstring extensions = prtu::toUTF16FromOSNarrow(selection);
+	if (extensions == PRT_EXTENSIONS_MINIMAL)
+		return MINIMAL_PRT_EXTENSIONS;
+
+	std::vector<std::wstring> selectedExtensions;
+	std::wistringstream stream(extensions);
+	std::wstring extension;
+	while (std::getline(stream, extension, PRT_EXTENSIONS_SEPARATOR)) {
+		extension.erase(0, extension.find_first_not_of(L' '));
+		extension.erase(extension.find_last_not_of(L' ') + 1);
+		if (!extension.empty())
+			selectedExtensions.push_back(extension);
+	}
+	return selectedExtensions;
+}
+
+// the extension libraries are named e.g. "com.esri.prt.codecs.dll" on windows and "libcom.esri.prt.codecs.so" else
+std::vector<std::wstring> findExtensionLibraries(const std::filesystem::path& extDir,
+                                                 const std::vector<std::wstring>& extensions) {
+	std::vector<std::wstring> libraries;
+	std::vector<std::wstring> missingExtensions = extensions;
+
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(extDir, ec)) {
+		if (!entry.is_regular_file(ec))
+			continue;
+		const std::wstring stem = entry.path().stem().wstring();
+		const auto isExtensionLibrary = [&stem](const std::wstring& e) { return stem == e || stem == L"lib" + e; };
+		const auto it = std::find_if(extensions.begin(), extensions.end(), isExtensionLibrary);
+		if (it == extensions.end())
+			continue;
+		libraries.push_back(entry.path().wstring());
+		missingExtensions.erase(std::remove(missingExtensions.begin(), missingExtensions.end(), *it),
+		                        missingExtensions.end());
+	}
+
+	for (const std::wstring& extension : missingExtensions)
+		LOG_WRN << "PRT extension '" << extension << "' not found in " << extDir.wstring();
+
+	return libraries;
+}
+
+prt::CacheObject::CacheType getCacheType() {
+	const char* cacheType = std::getenv(PRT_CACHE_ENV_VAR);
+	if (cacheType == nullptr || std::strcmp(cacheType, PRT_CACHE_DEFAULT) == 0)
+		return prt::CacheObject::CACHE_TYPE_DEFAULT;
+	if (std::strcmp(cacheType, PRT_CACHE_NONREDUNDANT) == 0)
+		return prt::CacheObject::CACHE_TYPE_NONREDUNDANT;
+
+	LOG_WRN << "Unknown PRT cache type '" << std::string(cacheType) << "' in " << std::string(PRT_CACHE_ENV_VAR)
+	        << ", using the " << std::string(PRT_CACHE_DEFAULT) << " cache";
+	return prt::CacheObject::CACHE_TYPE_DEFAULT;
+}
+
 bool verifyMayaEncoder() {
 	constexpr const wchar_t* ENC_ID_MAYA = L"MayaEncoder";
 	const auto mayaEncOpts = prtu::createValidatedOptions(ENC_ID_MAYA);
 	return static_cast<bool>(mayaEncOpts);
 }
+PRTContext& getInstance() {
+	static PRTContext prtCtx;
+	return prtCtx;
+}
+
+std::mutex initializationMutex;
+std::shared_future<PRTContext*> initialization; // guarded by initializationMutex
+
 } // namespace
 
 PRTContext& PRTContext::get() {
-	static PRTContext prtCtx;
+	// only the first call needs to wait for the initialization
+	static PRTContext& prtCtx = *initializeAsync().get();
 	return prtCtx;
 }
 
+std::shared_future<PRTContext*> PRTContext::initializeAsync(const InitializedCallback& onInitialized) {
+	std::unique_lock<std::mutex> lock(initializationMutex);
+	if (!initialization.valid()) {
+		auto initialize = [onInitialized]() {
+			PRTContext& prtCtx = getInstance();
+			if (onInitialized)
+				onInitialized(prtCtx);
+			return &prtCtx;
+		};
+		initialization = std::async(std::launch::async, initialize).share();
+		return initialization;
+	}
+
+	const std::shared_future<PRTContext*> pending = initialization;
+	lock.unlock();
+	if (onInitialized)
+		onInitialized(*pending.get());
+	return pending;
+}
+
 PRTContext::PRTContext(const std::vector<std::wstring>& addExtDirs) : mPluginRootPath(prtu::getPluginRoot()) {
 	if (ENABLE_LOG_CONSOLE) {
 		mLogHandler = std::make_unique<logging::LogHandler>();
@@ -61,10 +181,15 @@ PRTContext::PRTContext(const std::vector<std::wstring>& addExtDirs) : mPluginRoo
 	if (DBG)
 		LOG_DBG << "initialized prt logger, plugin root path is " << mPluginRootPath.wstring();
 
-	std::vector<std::wstring> extensionPaths = {(mPluginRootPath / PRT_EXT_SUBDIR).wstring()};
+	const std::filesystem::path extDir = mPluginRootPath / PRT_EXT_SUBDIR;
+	const std::vector<std::wstring> selectedExtensions = getSelectedExtensions();
+	std::vector<std::wstring> extensionPaths;
+	if (selectedExtensions.empty())
+		extensionPaths.push_back(extDir.wstring());
+	else
+		extensionPaths = findExtensionLibraries(extDir, selectedExtensions);
 	extensionPaths.insert(extensionPaths.end(), addExtDirs.begin(), addExtDirs.end());
-	if (DBG)
-		LOG_DBG << "looking for prt extensions at\n" << extensionPaths;
+	LOG_INF << "Loading PRT extensions from " << extensionPaths;
 
 	prt::Status status = prt::STATUS_UNSPECIFIED_ERROR;
 	const auto extensionPathPtrs = prtu::toPtrVec(extensionPaths);
@@ -81,8 +206,16 @@ PRTContext::PRTContext(const std::vector<std::wstring>& addExtDirs) : mPluginRoo
 		mPRTHandle.reset();
 	}
 	else {
-		mPRTCache.reset(prt::CacheObject::create(prt::CacheObject::CACHE_TYPE_DEFAULT));
-		mResolveMapCache = std::make_unique<ResolveMapCache>();
+		const prt::CacheObject::CacheType cacheType = getCacheType();
+		LOG_INF << "Using the "
+		        << std::string(cacheType == prt::CacheObject::CACHE_TYPE_NONREDUNDANT ? PRT_CACHE_NONREDUNDANT
+		                                                                              : PRT_CACHE_DEFAULT)
+		        << " PRT cache";
+		mPRTCache.reset(prt::CacheObject::create(cacheType));
+		const std::filesystem::path rpkMirrorDir = getRPKMirrorDir();
+		if (!rpkMirrorDir.empty())
+			LOG_INF << "Extracting rule packages to " << rpkMirrorDir.wstring();
+		mResolveMapCache = std::make_unique<ResolveMapCache>(mPRTCache.get(), rpkMirrorDir);
 	}
 }
 
@@ -90,9 +223,17 @@ bool PRTContext::isAlive() const {
 	return static_cast<bool>(mPRTHandle);
 }
 
+void PRTContext::stopBackgroundThreads() {
+	if (mResolveMapCache)
+		mResolveMapCache->stop();
+	mAssetCache.stop();
+}
+
 PRTContext::~PRTContext() {
 
-	// the cache needs to be destructed before PRT, so reset them explicitely in the right order here
+	// the caches need to be destructed before PRT, so reset them explicitely in the right order here
+	// (the resolve map cache first, its running prefetches use the PRT cache)
+	mResolveMapCache.reset();
 	mPRTCache.reset();
 	mPRTHandle.reset();
 
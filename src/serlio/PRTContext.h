@@ -26,6 +26,8 @@
 #include "utils/ResolveMapCache.h"
 #include "utils/Utilities.h"
 
+#include <functional>
+#include <future>
 #include <memory>
 #include <vector>
 
@@ -34,8 +36,18 @@ using PRTContextUPtr = std::unique_ptr<PRTContext>;
 
 class SRL_TEST_EXPORTS_API PRTContext final {
 public:
+	// waits for the initialization started by initializeAsync(), or initializes PRT on the calling thread
 	static PRTContext& get();
 
+	using InitializedCallback = std::function<void(PRTContext&)>;
+
+	/**
+	 * Starts the initialization of PRT on a background thread, loading the extensions takes a while. The callback is
+	 * invoked on that thread before get() returns, it must not call get() itself. If the initialization was started
+	 * before (e.g. serlio has been unloaded and loaded again), the callback is invoked on the calling thread instead.
+	 */
+	static std::shared_future<PRTContext*> initializeAsync(const InitializedCallback& onInitialized = {});
+
 	explicit PRTContext(const std::vector<std::wstring>& addExtDirs = {});
 	PRTContext(const PRTContext&) = delete;
 	PRTContext(PRTContext&&) = delete;
@@ -45,6 +57,12 @@ public:
 
 	bool isAlive() const;
 
+	/**
+	 * Stops the threads of the caches, they are started again on demand. Must be called before serlio is unloaded:
+	 * joining them in the static destructors would deadlock on Windows (the loader lock is held while unloading).
+	 */
+	void stopBackgroundThreads();
+
 	const std::filesystem::path mPluginRootPath; // the path where serlio dso resides
 	AssetCache mAssetCache;
 	ObjectUPtr mPRTHandle;
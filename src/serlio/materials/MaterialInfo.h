@@ -32,6 +32,13 @@ const std::string PRT_MATERIAL_STREAM = "prtMaterialStream";
 const std::string PRT_MATERIAL_FACE_INDEX_START = "faceIndexStart";
 const std::string PRT_MATERIAL_FACE_INDEX_END = "faceIndexEnd";
 
+// compact layout: each distinct material is stored once in the table stream (using PRT_MATERIAL_STRUCTURE),
+// the face range stream references it by its element index
+const std::string PRT_MATERIAL_TABLE_STREAM = "prtMaterialTableStream";
+const std::string PRT_MATERIAL_FACE_RANGE_STRUCTURE = "prtMaterialFaceRangeStructure";
+const std::string PRT_MATERIAL_FACE_RANGE_STREAM = "prtMaterialFaceRangeStream";
+const std::string PRT_MATERIAL_INDEX = "materialIndex";
+
 const std::string PRT_MATERIALINFO_MAP_STRUCTURE = "prtMaterialInfoMapStructure";
 const std::string PRT_MATERIALINFO_MAP_CHANNEL = "prtMaterialInfoMapChannel";
 const std::string PRT_MATERIALINFO_MAP_STREAM = "prtMaterialInfoMapStream";
@@ -22,9 +22,12 @@
 
 #include "utils/MELScriptBuilder.h"
 
+#include "PRTContext.h"
+
 #include "maya/MFnTypedAttribute.h"
 #include "maya/MUuid.h"
 
+#include <map>
 #include <mutex>
 
 namespace {
@@ -81,8 +84,15 @@ MStatus MaterialNode::compute(const MPlug& plug, MDataBlock& data) {
 	if (meshNameStatus != MStatus::kSuccess || meshName.length() == 0)
 		return meshNameStatus;
 
-	adsk::Data::Stream* inMatStream = MaterialUtils::getMaterialStream(inMesh, data);
-	if (inMatStream == nullptr) {
+	adsk::Data::Stream* inMatTableStream = MaterialUtils::getMaterialStream(inMesh, data, PRT_MATERIAL_TABLE_STREAM);
+	adsk::Data::Stream* inFaceRangeStream =
+	        MaterialUtils::getMaterialStream(inMesh, data, PRT_MATERIAL_FACE_RANGE_STREAM);
+	const bool hasMaterialTable = (inMatTableStream != nullptr) && (inFaceRangeStream != nullptr);
+
+	// legacy layout with one material per face range, e.g. from scenes saved with an older serlio version
+	adsk::Data::Stream* inMatStream = hasMaterialTable ? nullptr : MaterialUtils::getMaterialStream(inMesh, data);
+
+	if (!hasMaterialTable && (inMatStream == nullptr)) {
 		MaterialUtils::resetMaterial(meshName.asWChar());
 		return MStatus::kSuccess;
 	}
@@ -92,6 +102,9 @@ MStatus MaterialNode::compute(const MPlug& plug, MDataBlock& data) {
 	if (materialStructure == nullptr)
 		return MStatus::kFailure;
 
+	// the file nodes reference the textures written by the asset cache
+	PRTContext::get().mAssetCache.flush();
+
 	MaterialUtils::MaterialCache matCache = MaterialUtils::getMaterialCache();
 
 	MELScriptBuilder scriptBuilder;
@@ -101,36 +114,26 @@ MStatus MaterialNode::compute(const MPlug& plug, MDataBlock& data) {
 
 	declareMaterialStrings(scriptBuilder);
 
-	for (adsk::Data::Handle& inMatStreamHandle : *inMatStream) {
-		if (!inMatStreamHandle.hasData())
-			continue;
-
-		if (!inMatStreamHandle.usesStructure(*materialStructure))
-			continue;
+	auto createShadingEngine = [this, baseName, &scriptBuilder](const MaterialInfo& matInfo) {
+		const std::wstring shadingEngineBaseName = baseName + L"Sg";
+		const std::wstring shaderBaseName = baseName + L"Sh";
 
-		std::pair<int, int> faceRange;
-		if (!MaterialUtils::getFaceRange(inMatStreamHandle, faceRange))
-			continue;
+		MStatus status;
+		const std::wstring shadingEngineName = MaterialUtils::synchronouslyCreateShadingEngine(
+		        shadingEngineBaseName, MEL_VARIABLE_SHADING_ENGINE, status);
+		MCHECK(status);
 
-		auto createShadingEngine = [this, baseName, &materialStructure, &scriptBuilder,
-		                            &inMatStreamHandle](const MaterialInfo& matInfo) {
-			const std::wstring shadingEngineBaseName = baseName + L"Sg";
-			const std::wstring shaderBaseName = baseName + L"Sh";
+		MUuid shadingEngineNameUuid = mu::getNodeUuid(MString(shadingEngineName.c_str()));
+		MCHECK(MaterialUtils::addMaterialInfoMapMetadata(matInfo.getHash(), shadingEngineNameUuid));
+		appendToMaterialScriptBuilder(scriptBuilder, matInfo, shaderBaseName, shadingEngineName);
+		LOG_DBG << "new shading engine: " << shadingEngineName;
 
-			MStatus status;
-			const std::wstring shadingEngineName = MaterialUtils::synchronouslyCreateShadingEngine(
-			        shadingEngineBaseName, MEL_VARIABLE_SHADING_ENGINE, status);
-			MCHECK(status);
+		return shadingEngineNameUuid;
+	};
 
-			MUuid shadingEngineNameUuid = mu::getNodeUuid(MString(shadingEngineName.c_str()));
-			MCHECK(MaterialUtils::addMaterialInfoMapMetadata(matInfo.getHash(), shadingEngineNameUuid));
-			appendToMaterialScriptBuilder(scriptBuilder, matInfo, shaderBaseName, shadingEngineName);
-			LOG_DBG << "new shading engine: " << shadingEngineName;
-
-			return shadingEngineNameUuid;
-		};
-
-		MaterialInfo matInfo(inMatStreamHandle);
+	auto getShadingEngineName = [&matCache, &createShadingEngine,
+	                             &status](adsk::Data::Handle& matHandle) -> std::wstring {
+		MaterialInfo matInfo(matHandle);
 		const MUuid shadingEngineUuid = getCachedValue(matCache, matInfo.getHash(), createShadingEngine, matInfo);
 
 		MObject shadingEngineNodeObj = mu::getNodeObjFromUuid(shadingEngineUuid, status);
@@ -141,11 +144,58 @@ MStatus MaterialNode::compute(const MPlug& plug, MDataBlock& data) {
 		}
 
 		MFnDependencyNode shadingEngineNode(shadingEngineNodeObj);
-		const std::wstring shadingEngineName = shadingEngineNode.name().asWChar();
+		return shadingEngineNode.name().asWChar();
+	};
 
+	auto assignShadingEngine = [&scriptBuilder, &meshName](const std::wstring& shadingEngineName,
+	                                                       const std::pair<int, int>& faceRange) {
 		scriptBuilder.setsAddFaceRange(shadingEngineName, meshName.asWChar(), faceRange.first, faceRange.second);
 		LOG_DBG << "assigned shading engine (" << faceRange.first << ":" << faceRange.second
 		        << "): " << shadingEngineName;
+	};
+
+	if (hasMaterialTable) {
+		// every distinct material is only resolved once, the face ranges reference it by index
+		std::map<adsk::Data::IndexCount, std::wstring> shadingEngineNames;
+		for (adsk::Data::Stream::iterator iterator = inMatTableStream->begin(); iterator != inMatTableStream->end();
+		     ++iterator) {
+			if (!iterator->hasData() || !iterator->usesStructure(*materialStructure))
+				continue;
+
+			shadingEngineNames.emplace(iterator.index(), getShadingEngineName(*iterator));
+		}
+
+		for (adsk::Data::Handle& faceRangeHandle : *inFaceRangeStream) {
+			if (!faceRangeHandle.hasData())
+				continue;
+
+			std::pair<int, int> faceRange;
+			int materialIndex = 0;
+			if (!MaterialUtils::getFaceRange(faceRangeHandle, faceRange) ||
+			    !MaterialUtils::getMaterialIndex(faceRangeHandle, materialIndex))
+				continue;
+
+			const auto shadingEngineName = shadingEngineNames.find(static_cast<adsk::Data::IndexCount>(materialIndex));
+			if (shadingEngineName == shadingEngineNames.end())
+				continue;
+
+			assignShadingEngine(shadingEngineName->second, faceRange);
+		}
+	}
+	else {
+		for (adsk::Data::Handle& inMatStreamHandle : *inMatStream) {
+			if (!inMatStreamHandle.hasData())
+				continue;
+
+			if (!inMatStreamHandle.usesStructure(*materialStructure))
+				continue;
+
+			std::pair<int, int> faceRange;
+			if (!MaterialUtils::getFaceRange(inMatStreamHandle, faceRange))
+				continue;
+
+			assignShadingEngine(getShadingEngineName(inMatStreamHandle), faceRange);
+		}
 	}
 	scriptBuilder.setUndoState(MEL_UNDO_STATE);
 	return scriptBuilder.execute();
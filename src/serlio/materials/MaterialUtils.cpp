@@ -21,6 +21,7 @@
 
 #include "utils/MArrayWrapper.h"
 #include "utils/MELScriptBuilder.h"
+#include "utils/MItDependencyNodesWrapper.h"
 #include "utils/MayaUtilities.h"
 #include "utils/Utilities.h"
 
@@ -30,6 +31,7 @@
 #include "maya/MDataHandle.h"
 #include "maya/MFileIO.h"
 #include "maya/MFnMesh.h"
+#include "maya/MItDependencyNodes.h"
 #include "maya/MPlugArray.h"
 #include "maya/MUuid.h"
 #include "maya/adskDataAssociations.h"
@@ -124,7 +126,7 @@ void forwardGeometry(const MObject& aInMesh, const MObject& aOutMesh, MDataBlock
 	outMeshHandle.setClean();
 }
 
-adsk::Data::Stream* getMaterialStream(const MObject& aInMesh, MDataBlock& data) {
+adsk::Data::Stream* getMaterialStream(const MObject& aInMesh, MDataBlock& data, const std::string& streamName) {
 	MStatus status;
 
 	const MDataHandle inMeshHandle = data.inputValue(aInMesh, &status);
@@ -143,7 +145,7 @@ adsk::Data::Stream* getMaterialStream(const MObject& aInMesh, MDataBlock& data)
 	if (inMatChannel == nullptr)
 		return nullptr;
 
-	return inMatChannel->findDataStream(PRT_MATERIAL_STREAM);
+	return inMatChannel->findDataStream(streamName);
 }
 
 MStatus getMeshName(MString& meshName, const MPlug& plug) {
@@ -254,6 +256,14 @@ bool getFaceRange(adsk::Data::Handle& handle, std::pair<int, int>& faceRange) {
 	return true;
 }
 
+bool getMaterialIndex(adsk::Data::Handle& handle, int& materialIndex) {
+	if (!handle.setPositionByMemberName(PRT_MATERIAL_INDEX.c_str()))
+		return false;
+	materialIndex = *handle.asInt32();
+
+	return true;
+}
+
 std::wstring synchronouslyCreateShadingEngine(const std::wstring& desiredShadingEngineName,
                                               const MELVariable& shadingEngineVariable, MStatus& status) {
 	MELScriptBuilder scriptBuilder;
@@ -286,6 +296,67 @@ bool textureHasAlphaChannel(const std::wstring& path) {
 	return false;
 }
 
+std::vector<std::filesystem::path> getSceneTexturePaths() {
+	std::vector<std::filesystem::path> texturePaths;
+	MStatus status;
+
+	MItDependencyNodes fileNodeIt(MFn::kFileTexture, &status);
+	MCHECK(status);
+	for (const auto& fileNodeObj : MItDependencyNodesWrapper(fileNodeIt)) {
+		const MFnDependencyNode fileNode(fileNodeObj);
+		const MPlug fileTextureNamePlug = fileNode.findPlug("fileTextureName", true, &status);
+		if (status != MS::kSuccess)
+			continue;
+		const MString fileTextureName = fileTextureNamePlug.asString();
+		if (fileTextureName.length() > 0)
+			texturePaths.emplace_back(fileTextureName.asWChar());
+	}
+
+	// the material nodes might not have created the file nodes yet
+	const adsk::Data::Structure* materialStructure =
+	        adsk::Data::Structure::structureByName(PRT_MATERIAL_STRUCTURE.c_str());
+	if (materialStructure == nullptr)
+		return texturePaths;
+
+	MItDependencyNodes meshIt(MFn::kMesh, &status);
+	MCHECK(status);
+	for (const auto& meshObj : MItDependencyNodesWrapper(meshIt)) {
+		const MFnMesh mesh(meshObj, &status);
+		if (status != MS::kSuccess)
+			continue;
+		const adsk::Data::Associations* metadata = mesh.metadata(&status);
+		if (metadata == nullptr)
+			continue;
+
+		adsk::Data::Associations associations(metadata);
+		adsk::Data::Channel* matChannel = associations.findChannel(PRT_MATERIAL_CHANNEL);
+		if (matChannel == nullptr)
+			continue;
+
+		for (const std::string& streamName : {PRT_MATERIAL_TABLE_STREAM, PRT_MATERIAL_STREAM}) {
+			adsk::Data::Stream* matStream = matChannel->findDataStream(streamName);
+			if (matStream == nullptr)
+				continue;
+
+			for (adsk::Data::Handle& matHandle : *matStream) {
+				if (!matHandle.hasData() || !matHandle.usesStructure(*materialStructure))
+					continue;
+
+				const MaterialInfo matInfo(matHandle);
+				for (const std::string* texture :
+				     {&matInfo.bumpMap, &matInfo.colormap, &matInfo.dirtmap, &matInfo.emissiveMap,
+				      &matInfo.metallicMap, &matInfo.normalMap, &matInfo.occlusionMap, &matInfo.opacityMap,
+				      &matInfo.roughnessMap, &matInfo.specularMap}) {
+					if (!texture->empty())
+						texturePaths.emplace_back(prtu::toUTF16FromOSNarrow(*texture));
+				}
+			}
+		}
+	}
+
+	return texturePaths;
+}
+
 void resetMaterial(const std::wstring& meshName) {
 	MELScriptBuilder scriptBuilder;
 	scriptBuilder.declInt(MEL_UNDO_STATE);
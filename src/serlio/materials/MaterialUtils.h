@@ -28,12 +28,15 @@
 #include "maya/MString.h"
 #include "maya/adskDataStream.h"
 
+#include <filesystem>
 #include <map>
+#include <vector>
 
 namespace MaterialUtils {
 
 void forwardGeometry(const MObject& aInMesh, const MObject& aOutMesh, MDataBlock& data);
-adsk::Data::Stream* getMaterialStream(const MObject& aInMesh, MDataBlock& data);
+adsk::Data::Stream* getMaterialStream(const MObject& aInMesh, MDataBlock& data,
+                                      const std::string& streamName = PRT_MATERIAL_STREAM);
 
 MStatus getMeshName(MString& meshName, const MPlug& plug);
 
@@ -42,6 +45,7 @@ using MaterialCache = std::map<size_t, MUuid>;
 MaterialCache getMaterialCache();
 
 bool getFaceRange(adsk::Data::Handle& handle, std::pair<int, int>& faceRange);
+bool getMaterialIndex(adsk::Data::Handle& handle, int& materialIndex);
 
 MStatus addMaterialInfoMapMetadata(size_t materialInfoHash, const MUuid& shadingEngineUuid);
 
@@ -52,5 +56,8 @@ std::filesystem::path getStingrayShaderPath();
 
 bool textureHasAlphaChannel(const std::wstring& path);
 
+// textures referenced by the file nodes and the material metadata of the meshes in the open scene
+std::vector<std::filesystem::path> getSceneTexturePaths();
+
 void resetMaterial(const std::wstring& meshName);
 } // namespace MaterialUtils
\ No newline at end of file
@@ -18,6 +18,7 @@
  */
 
 #include "modifiers/MayaCallbacks.h"
+#include "modifiers/MeshHoles.h"
 #include "modifiers/PRTModifierNode.h"
 
 #include "materials/MaterialInfo.h"
@@ -39,14 +40,18 @@
 #include "maya/adskDataAssociations.h"
 #include "maya/adskDataStream.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cwchar>
+#include <iterator>
+#include <optional>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
 
 namespace {
 
 constexpr bool DBG = false;
-constexpr const wchar_t* MAYA_ASSET_FOLDER = L"assets";
-constexpr const wchar_t* SERLIO_ASSET_FOLDER = L"serlio_assets";
 
 void checkStringLength(const wchar_t* string, const size_t& maxStringLength) {
 	if (wcslen(string) >= maxStringLength) {
@@ -171,6 +176,24 @@ void assignVertexNormals(MFnMesh& mFnMesh, const MIntArray& mayaFaceCounts, MInt
 	MCHECK(mFnMesh.setFaceVertexNormals(expandedNormals, faceList, mayaVertexIndices));
 }
 
+// the face vertex ids of the mesh (in face order), fails if the face vertex counts differ from the expected ones
+bool getFaceVertexIndices(const MFnMesh& fnMesh, const MIntArray& expectedFaceCounts, MIntArray& faceVertexIndices) {
+	MIntArray faceCounts;
+	MIntArray vertexIndices;
+	if (fnMesh.getVertices(faceCounts, vertexIndices) != MS::kSuccess)
+		return false;
+
+	if (faceCounts.length() != expectedFaceCounts.length())
+		return false;
+	for (unsigned int i = 0; i < faceCounts.length(); i++) {
+		if (faceCounts[i] != expectedFaceCounts[i])
+			return false;
+	}
+
+	faceVertexIndices = vertexIndices;
+	return true;
+}
+
 constexpr unsigned int MATERIAL_MAX_STRING_LENGTH = 400;
 constexpr unsigned int MATERIAL_MAX_FLOAT_ARRAY_LENGTH = 5;
 constexpr unsigned int MATERIAL_MAX_STRING_ARRAY_LENGTH = 2;
@@ -230,151 +253,501 @@ adsk::Data::Structure* createNewMayaStructure(const prt::AttributeMap** material
 	return fStructure;
 }
 
-void fillMetadata(adsk::Data::Structure* fStructure, const uint32_t* faceRanges, size_t faceRangesSize,
-                  const prt::AttributeMap** materials, const prt::AttributeMap** reports,
-                  adsk::Data::Associations& newMetadata) {
-	assert(fStructure != nullptr);
-	assert(faceRangesSize > 1);
+adsk::Data::Structure* createNewFaceRangeStructure() {
+	adsk::Data::Structure* fStructure = adsk::Data::Structure::create();
+	fStructure->setName(PRT_MATERIAL_FACE_RANGE_STRUCTURE.c_str());
 
-	adsk::Data::Stream newStream(*fStructure, PRT_MATERIAL_STREAM);
-	adsk::Data::Channel newChannel = newMetadata.channel(PRT_MATERIAL_CHANNEL);
-	newChannel.setDataStream(newStream);
-	newMetadata.setChannel(newChannel);
+	fStructure->addMember(adsk::Data::Member::kInt32, 1, PRT_MATERIAL_FACE_INDEX_START.c_str());
+	fStructure->addMember(adsk::Data::Member::kInt32, 1, PRT_MATERIAL_FACE_INDEX_END.c_str());
+	fStructure->addMember(adsk::Data::Member::kInt32, 1, PRT_MATERIAL_INDEX.c_str());
 
-	for (size_t fri = 0; fri < faceRangesSize - 1; fri++) {
+	adsk::Data::Structure::registerStructure(*fStructure);
 
-		if (materials != nullptr) {
-			adsk::Data::Handle handle(*fStructure);
+	return fStructure;
+}
 
-			const prt::AttributeMap* mat = materials[fri];
+size_t getMaterialHash(const prt::AttributeMap* mat) {
+	size_t seed = 0;
 
-			size_t keyCount = 0;
-			wchar_t const* const* keys = mat->getKeys(&keyCount);
+	size_t keyCount = 0;
+	wchar_t const* const* keys = mat->getKeys(&keyCount);
+	for (size_t k = 0; k < keyCount; k++) {
+		wchar_t const* key = keys[k];
+		prtu::hash_combine(seed, std::hash<std::wstring_view>{}(key));
 
-			for (int k = 0; k < keyCount; k++) {
+		size_t arraySize = 0;
+		switch (mat->getType(key)) {
+			case prt::Attributable::PT_BOOL:
+				prtu::hash_combine(seed, std::hash<bool>{}(mat->getBool(key)));
+				break;
+			case prt::Attributable::PT_FLOAT:
+				prtu::hash_combine(seed, std::hash<double>{}(mat->getFloat(key)));
+				break;
+			case prt::Attributable::PT_INT:
+				prtu::hash_combine(seed, std::hash<int32_t>{}(mat->getInt(key)));
+				break;
+			case prt::Attributable::PT_STRING:
+				prtu::hash_combine(seed, std::hash<std::wstring_view>{}(mat->getString(key)));
+				break;
+			case prt::Attributable::PT_BOOL_ARRAY: {
+				const bool* boolArray = mat->getBoolArray(key, &arraySize);
+				for (size_t i = 0; i < arraySize; i++)
+					prtu::hash_combine(seed, std::hash<bool>{}(boolArray[i]));
+				break;
+			}
+			case prt::Attributable::PT_INT_ARRAY: {
+				const int32_t* intArray = mat->getIntArray(key, &arraySize);
+				for (size_t i = 0; i < arraySize; i++)
+					prtu::hash_combine(seed, std::hash<int32_t>{}(intArray[i]));
+				break;
+			}
+			case prt::Attributable::PT_FLOAT_ARRAY: {
+				const double* floatArray = mat->getFloatArray(key, &arraySize);
+				for (size_t i = 0; i < arraySize; i++)
+					prtu::hash_combine(seed, std::hash<double>{}(floatArray[i]));
+				break;
+			}
+			case prt::Attributable::PT_STRING_ARRAY: {
+				const wchar_t* const* stringArray = mat->getStringArray(key, &arraySize);
+				for (size_t i = 0; i < arraySize; i++)
+					prtu::hash_combine(seed, std::hash<std::wstring_view>{}(stringArray[i]));
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	return seed;
+}
+
+template <typename T>
+bool isArrayEqual(const T* a, size_t aSize, const T* b, size_t bSize) {
+	return (aSize == bSize) && std::equal(a, a + aSize, b);
+}
+
+bool isMaterialEqual(const prt::AttributeMap* a, const prt::AttributeMap* b) {
+	size_t aKeyCount = 0;
+	wchar_t const* const* aKeys = a->getKeys(&aKeyCount);
+	size_t bKeyCount = 0;
+	b->getKeys(&bKeyCount);
+	if (aKeyCount != bKeyCount)
+		return false;
+
+	for (size_t k = 0; k < aKeyCount; k++) {
+		wchar_t const* key = aKeys[k];
+		if (!b->hasKey(key) || a->getType(key) != b->getType(key))
+			return false;
+
+		size_t aSize = 0;
+		size_t bSize = 0;
+		switch (a->getType(key)) {
+			case prt::Attributable::PT_BOOL:
+				if (a->getBool(key) != b->getBool(key))
+					return false;
+				break;
+			case prt::Attributable::PT_FLOAT:
+				if (a->getFloat(key) != b->getFloat(key))
+					return false;
+				break;
+			case prt::Attributable::PT_INT:
+				if (a->getInt(key) != b->getInt(key))
+					return false;
+				break;
+			case prt::Attributable::PT_STRING:
+				if (std::wcscmp(a->getString(key), b->getString(key)) != 0)
+					return false;
+				break;
+			case prt::Attributable::PT_BOOL_ARRAY: {
+				const bool* aArray = a->getBoolArray(key, &aSize);
+				const bool* bArray = b->getBoolArray(key, &bSize);
+				if (!isArrayEqual(aArray, aSize, bArray, bSize))
+					return false;
+				break;
+			}
+			case prt::Attributable::PT_INT_ARRAY: {
+				const int32_t* aArray = a->getIntArray(key, &aSize);
+				const int32_t* bArray = b->getIntArray(key, &bSize);
+				if (!isArrayEqual(aArray, aSize, bArray, bSize))
+					return false;
+				break;
+			}
+			case prt::Attributable::PT_FLOAT_ARRAY: {
+				const double* aArray = a->getFloatArray(key, &aSize);
+				const double* bArray = b->getFloatArray(key, &bSize);
+				if (!isArrayEqual(aArray, aSize, bArray, bSize))
+					return false;
+				break;
+			}
+			case prt::Attributable::PT_STRING_ARRAY: {
+				const wchar_t* const* aArray = a->getStringArray(key, &aSize);
+				const wchar_t* const* bArray = b->getStringArray(key, &bSize);
+				if (aSize != bSize)
+					return false;
+				for (size_t i = 0; i < aSize; i++) {
+					if (std::wcscmp(aArray[i], bArray[i]) != 0)
+						return false;
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
 
-				wchar_t const* key = keys[k];
+	return true;
+}
 
-				const std::string keyNarrow = prtu::toOSNarrowFromUTF16(key);
+// Deduplicates the per face range materials, each distinct material is stored only once in the metadata
+class MaterialTable {
+public:
+	uint32_t add(const prt::AttributeMap* mat) {
+		const size_t hash = getMaterialHash(mat);
 
-				if (!handle.setPositionByMemberName(keyNarrow.c_str()))
-					continue;
+		const auto [begin, end] = mIndices.equal_range(hash);
+		for (auto it = begin; it != end; ++it) {
+			if (isMaterialEqual(mMaterials[it->second], mat))
+				return it->second;
+		}
 
-				size_t arraySize = 0;
+		const uint32_t index = static_cast<uint32_t>(mMaterials.size());
+		mMaterials.push_back(mat);
+		mIndices.emplace(hash, index);
+		return index;
+	}
 
-				switch (mat->getType(key)) {
-					case prt::Attributable::PT_BOOL:
-						handle.asBoolean()[0] = mat->getBool(key);
-						break;
-					case prt::Attributable::PT_FLOAT:
-						handle.asDouble()[0] = mat->getFloat(key);
-						break;
-					case prt::Attributable::PT_INT:
-						handle.asInt32()[0] = mat->getInt(key);
-						break;
+	const std::vector<const prt::AttributeMap*>& getMaterials() const {
+		return mMaterials;
+	}
 
-					// workaround: transporting string as uint8 array, because using asString crashes maya
-					case prt::Attributable::PT_STRING: {
-						const wchar_t* str = mat->getString(key);
-						if (wcslen(str) == 0)
-							break;
-						checkStringLength(str, MATERIAL_MAX_STRING_LENGTH);
-						size_t maxStringLengthTmp = MATERIAL_MAX_STRING_LENGTH;
-						prt::StringUtils::toOSNarrowFromUTF16(str, (char*)handle.asUInt8(), &maxStringLengthTmp);
-						break;
-					}
-					case prt::Attributable::PT_BOOL_ARRAY: {
-						const bool* boolArray;
-						boolArray = mat->getBoolArray(key, &arraySize);
-						for (unsigned int i = 0; i < arraySize && i < MATERIAL_MAX_STRING_LENGTH; i++)
-							handle.asBoolean()[i] = boolArray[i];
-						break;
-					}
-					case prt::Attributable::PT_INT_ARRAY: {
-						const int* intArray;
-						intArray = mat->getIntArray(key, &arraySize);
-						for (unsigned int i = 0; i < arraySize && i < MATERIAL_MAX_STRING_LENGTH; i++)
-							handle.asInt32()[i] = intArray[i];
-						break;
-					}
-					case prt::Attributable::PT_FLOAT_ARRAY: {
-						const double* floatArray;
-						floatArray = mat->getFloatArray(key, &arraySize);
-						for (unsigned int i = 0;
-						     i < arraySize && i < MATERIAL_MAX_STRING_LENGTH && i < MATERIAL_MAX_FLOAT_ARRAY_LENGTH;
-						     i++)
-							handle.asDouble()[i] = floatArray[i];
-						break;
-					}
-					case prt::Attributable::PT_STRING_ARRAY: {
-
-						const wchar_t* const* stringArray = mat->getStringArray(key, &arraySize);
-
-						for (unsigned int i = 0; i < arraySize && i < MATERIAL_MAX_STRING_LENGTH; i++) {
-							if (wcslen(stringArray[i]) == 0)
-								continue;
-
-							if (i > 0) {
-								std::wstring keyToUse = key + std::to_wstring(i);
-								const std::string keyToUseNarrow = prtu::toOSNarrowFromUTF16(keyToUse);
-								if (!handle.setPositionByMemberName(keyToUseNarrow.c_str()))
-									continue;
-							}
-
-							checkStringLength(stringArray[i], MATERIAL_MAX_STRING_LENGTH);
-							size_t maxStringLengthTmp = MATERIAL_MAX_STRING_LENGTH;
-							prt::StringUtils::toOSNarrowFromUTF16(stringArray[i], (char*)handle.asUInt8(),
-							                                      &maxStringLengthTmp);
-						}
-						break;
+private:
+	std::vector<const prt::AttributeMap*> mMaterials;
+	std::unordered_multimap<size_t, uint32_t> mIndices;
+};
+
+void fillMaterialHandle(adsk::Data::Handle& handle, const prt::AttributeMap* mat) {
+	size_t keyCount = 0;
+	wchar_t const* const* keys = mat->getKeys(&keyCount);
+
+	for (int k = 0; k < keyCount; k++) {
+
+		wchar_t const* key = keys[k];
+
+		const std::string keyNarrow = prtu::toOSNarrowFromUTF16(key);
+
+		if (!handle.setPositionByMemberName(keyNarrow.c_str()))
+			continue;
+
+		size_t arraySize = 0;
+
+		switch (mat->getType(key)) {
+			case prt::Attributable::PT_BOOL:
+				handle.asBoolean()[0] = mat->getBool(key);
+				break;
+			case prt::Attributable::PT_FLOAT:
+				handle.asDouble()[0] = mat->getFloat(key);
+				break;
+			case prt::Attributable::PT_INT:
+				handle.asInt32()[0] = mat->getInt(key);
+				break;
+
+			// workaround: transporting string as uint8 array, because using asString crashes maya
+			case prt::Attributable::PT_STRING: {
+				const wchar_t* str = mat->getString(key);
+				if (wcslen(str) == 0)
+					break;
+				checkStringLength(str, MATERIAL_MAX_STRING_LENGTH);
+				size_t maxStringLengthTmp = MATERIAL_MAX_STRING_LENGTH;
+				prt::StringUtils::toOSNarrowFromUTF16(str, (char*)handle.asUInt8(), &maxStringLengthTmp);
+				break;
+			}
+			case prt::Attributable::PT_BOOL_ARRAY: {
+				const bool* boolArray;
+				boolArray = mat->getBoolArray(key, &arraySize);
+				for (unsigned int i = 0; i < arraySize && i < MATERIAL_MAX_STRING_LENGTH; i++)
+					handle.asBoolean()[i] = boolArray[i];
+				break;
+			}
+			case prt::Attributable::PT_INT_ARRAY: {
+				const int* intArray;
+				intArray = mat->getIntArray(key, &arraySize);
+				for (unsigned int i = 0; i < arraySize && i < MATERIAL_MAX_STRING_LENGTH; i++)
+					handle.asInt32()[i] = intArray[i];
+				break;
+			}
+			case prt::Attributable::PT_FLOAT_ARRAY: {
+				const double* floatArray;
+				floatArray = mat->getFloatArray(key, &arraySize);
+				for (unsigned int i = 0;
+				     i < arraySize && i < MATERIAL_MAX_STRING_LENGTH && i < MATERIAL_MAX_FLOAT_ARRAY_LENGTH; i++)
+					handle.asDouble()[i] = floatArray[i];
+				break;
+			}
+			case prt::Attributable::PT_STRING_ARRAY: {
+
+				const wchar_t* const* stringArray = mat->getStringArray(key, &arraySize);
+
+				for (unsigned int i = 0; i < arraySize && i < MATERIAL_MAX_STRING_LENGTH; i++) {
+					if (wcslen(stringArray[i]) == 0)
+						continue;
+
+					if (i > 0) {
+						std::wstring keyToUse = key + std::to_wstring(i);
+						const std::string keyToUseNarrow = prtu::toOSNarrowFromUTF16(keyToUse);
+						if (!handle.setPositionByMemberName(keyToUseNarrow.c_str()))
+							continue;
 					}
 
-					case prt::Attributable::PT_UNDEFINED:
-						break;
-					case prt::Attributable::PT_BLIND_DATA:
-						break;
-					case prt::Attributable::PT_BLIND_DATA_ARRAY:
-						break;
-					case prt::Attributable::PT_COUNT:
-						break;
+					checkStringLength(stringArray[i], MATERIAL_MAX_STRING_LENGTH);
+					size_t maxStringLengthTmp = MATERIAL_MAX_STRING_LENGTH;
+					prt::StringUtils::toOSNarrowFromUTF16(stringArray[i], (char*)handle.asUInt8(),
+					                                      &maxStringLengthTmp);
 				}
+				break;
 			}
 
+			case prt::Attributable::PT_UNDEFINED:
+				break;
+			case prt::Attributable::PT_BLIND_DATA:
+				break;
+			case prt::Attributable::PT_BLIND_DATA_ARRAY:
+				break;
+			case prt::Attributable::PT_COUNT:
+				break;
+		}
+	}
+}
+
+// Writes each distinct material once into the material table stream and references it by index from the
+// (compact) face range stream. Consecutive face ranges using the same material are merged.
+void fillMetadata(adsk::Data::Structure* fStructure, adsk::Data::Structure* fFaceRangeStructure,
+                  const uint32_t* faceRanges, size_t faceRangesSize, const prt::AttributeMap** materials,
+                  const prt::AttributeMap** reports, adsk::Data::Associations& newMetadata) {
+	assert(fStructure != nullptr);
+	assert(fFaceRangeStructure != nullptr);
+	assert(faceRangesSize > 1);
+
+	adsk::Data::Channel newChannel = newMetadata.channel(PRT_MATERIAL_CHANNEL);
+
+	if (materials != nullptr) {
+		const size_t materialCount = faceRangesSize - 1;
+
+		MaterialTable materialTable;
+		std::vector<uint32_t> materialIndices(materialCount);
+		for (size_t fri = 0; fri < materialCount; fri++)
+			materialIndices[fri] = materialTable.add(materials[fri]);
+
+		adsk::Data::Stream faceRangeStream(*fFaceRangeStructure, PRT_MATERIAL_FACE_RANGE_STREAM);
+
+		adsk::Data::IndexCount faceRangeIndex = 0;
+		for (size_t fri = 0; fri < materialCount;) {
+			const uint32_t materialIndex = materialIndices[fri];
+
+			size_t friEnd = fri + 1;
+			while (friEnd < materialCount && materialIndices[friEnd] == materialIndex)
+				friEnd++;
+
+			adsk::Data::Handle handle(*fFaceRangeStructure);
+
 			handle.setPositionByMemberName(PRT_MATERIAL_FACE_INDEX_START.c_str());
 			*handle.asInt32() = faceRanges[fri];
 
 			handle.setPositionByMemberName(PRT_MATERIAL_FACE_INDEX_END.c_str());
-			*handle.asInt32() = faceRanges[fri + 1];
+			*handle.asInt32() = faceRanges[friEnd];
+
+			handle.setPositionByMemberName(PRT_MATERIAL_INDEX.c_str());
+			*handle.asInt32() = static_cast<int32_t>(materialIndex);
+
+			faceRangeStream.setElement(faceRangeIndex++, handle);
+			fri = friEnd;
+		}
+
+		adsk::Data::Stream materialTableStream(*fStructure, PRT_MATERIAL_TABLE_STREAM);
+		const std::vector<const prt::AttributeMap*>& uniqueMaterials = materialTable.getMaterials();
+		for (size_t mi = 0; mi < uniqueMaterials.size(); mi++) {
+			adsk::Data::Handle handle(*fStructure);
+			fillMaterialHandle(handle, uniqueMaterials[mi]);
+			materialTableStream.setElement(static_cast<adsk::Data::IndexCount>(mi), handle);
+		}
+
+		if (DBG) {
+			LOG_DBG << "material metadata: " << materialCount << " face ranges, " << faceRangeIndex
+			        << " merged face ranges, " << uniqueMaterials.size() << " unique materials";
+		}
+
+		newChannel.setDataStream(materialTableStream);
+		newChannel.setDataStream(faceRangeStream);
+	}
 
-			newStream.setElement(static_cast<adsk::Data::IndexCount>(fri), handle);
+	if (reports != nullptr) {
+		// todo
+	}
+
+	newMetadata.setChannel(newChannel);
+}
+
+template <typename T>
+std::pair<std::vector<const T*>, std::vector<size_t>> toPtrVec(const std::vector<std::vector<T>>& v) {
+	std::vector<const T*> pv(v.size());
+	std::vector<size_t> ps(v.size());
+	for (size_t i = 0; i < v.size(); i++) {
+		pv[i] = v[i].data();
+		ps[i] = v[i].size();
+	}
+	return std::make_pair(pv, ps);
+}
+
+IMayaCallbacks::AttributeMapOwner copyAttributeMap(const prt::AttributeMap* attributeMap) {
+	const AttributeMapBuilderUPtr amb(prt::AttributeMapBuilder::createFromAttributeMap(attributeMap));
+	return IMayaCallbacks::AttributeMapOwner(amb->createAttributeMap());
+}
+
+template <typename T>
+void appendWithOffset(std::vector<T>& target, const std::vector<T>& source, T offset) {
+	target.reserve(target.size() + source.size());
+	for (const T& v : source)
+		target.push_back(v + offset);
+}
+
+// concatenates the meshes in the given order, indices and face ranges are rebased accordingly
+MayaCallbacks::MeshBuffer mergeMeshBuffers(const std::vector<MayaCallbacks::MeshBuffer*>& meshes) {
+	MayaCallbacks::MeshBuffer merged;
+
+	size_t uvSetsCount = 0;
+	bool hasHoles = false;
+	bool hasMaterials = true;
+	bool hasReports = true;
+	for (const MayaCallbacks::MeshBuffer* m : meshes) {
+		uvSetsCount = std::max(uvSetsCount, m->mUvs.size());
+		hasHoles = hasHoles || !m->mHoleCounts.empty();
+		hasMaterials = hasMaterials && !m->mMaterials.empty();
+		hasReports = hasReports && !m->mReports.empty();
+	}
+	merged.mUvs.resize(uvSetsCount);
+	merged.mUvCounts.resize(uvSetsCount);
+	merged.mUvIndices.resize(uvSetsCount);
+
+	for (MayaCallbacks::MeshBuffer* m : meshes) {
+		const uint32_t vertexIndexBase = static_cast<uint32_t>(merged.mCoords.size() / 3);
+		const uint32_t normalIndexBase = static_cast<uint32_t>(merged.mNormals.size() / 3);
+		const uint32_t faceIndexBase = static_cast<uint32_t>(merged.mFaceCounts.size());
+
+		merged.mCoords.insert(merged.mCoords.end(), m->mCoords.begin(), m->mCoords.end());
+		merged.mNormals.insert(merged.mNormals.end(), m->mNormals.begin(), m->mNormals.end());
+		merged.mFaceCounts.insert(merged.mFaceCounts.end(), m->mFaceCounts.begin(), m->mFaceCounts.end());
+		appendWithOffset(merged.mVertexIndices, m->mVertexIndices, vertexIndexBase);
+		appendWithOffset(merged.mNormalIndices, m->mNormalIndices, normalIndexBase);
+
+		if (hasHoles) {
+			if (m->mHoleCounts.empty())
+				merged.mHoleCounts.resize(merged.mHoleCounts.size() + m->mFaceCounts.size(), 0);
+			else
+				merged.mHoleCounts.insert(merged.mHoleCounts.end(), m->mHoleCounts.begin(), m->mHoleCounts.end());
+			appendWithOffset(merged.mHoleIndices, m->mHoleIndices, faceIndexBase);
+		}
+
+		for (size_t uvSet = 0; uvSet < uvSetsCount; uvSet++) {
+			if (uvSet < m->mUvs.size() && !m->mUvCounts[uvSet].empty()) {
+				const uint32_t uvIndexBase = static_cast<uint32_t>(merged.mUvs[uvSet].size() / 2);
+				merged.mUvs[uvSet].insert(merged.mUvs[uvSet].end(), m->mUvs[uvSet].begin(), m->mUvs[uvSet].end());
+				merged.mUvCounts[uvSet].insert(merged.mUvCounts[uvSet].end(), m->mUvCounts[uvSet].begin(),
+				                               m->mUvCounts[uvSet].end());
+				appendWithOffset(merged.mUvIndices[uvSet], m->mUvIndices[uvSet], uvIndexBase);
+			}
+			else {
+				// faces without texture coordinates in this uv set
+				merged.mUvCounts[uvSet].resize(merged.mUvCounts[uvSet].size() + m->mFaceCounts.size(), 0);
+			}
 		}
 
-		if (reports != nullptr) {
-			// todo
+		// the face ranges of each mesh are closed by the face count, i.e. the last value is the start of the next mesh
+		if (!m->mFaceRanges.empty()) {
+			if (!merged.mFaceRanges.empty())
+				merged.mFaceRanges.pop_back();
+			appendWithOffset(merged.mFaceRanges, m->mFaceRanges, faceIndexBase);
 		}
+
+		if (hasMaterials)
+			std::move(m->mMaterials.begin(), m->mMaterials.end(), std::back_inserter(merged.mMaterials));
+		if (hasReports)
+			std::move(m->mReports.begin(), m->mReports.end(), std::back_inserter(merged.mReports));
+		merged.mShapeIDs.insert(merged.mShapeIDs.end(), m->mShapeIDs.begin(), m->mShapeIDs.end());
 	}
+
+	return merged;
 }
 
-void updateMayaMesh(double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
-                    size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
-                    size_t uvSetsCount, const double* nrm, size_t nrmSize, const uint32_t* normalIndices,
-                    size_t normalIndicesSize, const MFloatPointArray& mayaVertices, const MIntArray& mayaFaceCounts,
-                    MIntArray& mayaVertexIndices, const MObject& outMeshObj,
+void updateMayaMesh(const MayaCallbacks::MeshBuffer& mesh, const OuterLoops* outerLoops, const MObject& outMeshObj,
                     const adsk::Data::Associations& newMetadata) {
 	MStatus stat;
 
+	MFloatPointArray mayaVertices = toMayaFloatPointArray(mesh.mCoords.data(), mesh.mCoords.size());
+	MIntArray mayaFaceCounts = toMayaIntArray(mesh.mFaceCounts.data(), mesh.mFaceCounts.size());
+	MIntArray mayaVertexIndices = toMayaIntArray(mesh.mVertexIndices.data(), mesh.mVertexIndices.size());
+
+	if (DBG) {
+		LOG_DBG << "-- MayaCallbacks::commitMesh";
+		LOG_DBG << "   faceCountsSize = " << mesh.mFaceCounts.size();
+		LOG_DBG << "   vertexIndicesSize = " << mesh.mVertexIndices.size();
+		LOG_DBG << "   mayaVertices.length = " << mayaVertices.length();
+		LOG_DBG << "   mayaFaceCounts.length   = " << mayaFaceCounts.length();
+		LOG_DBG << "   mayaVertexIndices.length = " << mayaVertexIndices.length();
+		LOG_DBG << "   faces with holes = " << ((outerLoops != nullptr) ? outerLoops->holes.size() : 0);
+	}
+
 	MFnMeshData dataCreator;
 	MObject newOutputData = dataCreator.create(&stat);
 	MCHECK(stat);
 
+	const MIntArray createFaceCounts =
+	        (outerLoops != nullptr) ? toMayaIntArray(outerLoops->faceCounts.data(), outerLoops->faceCounts.size())
+	                                : mayaFaceCounts;
+	const MIntArray createVertexIndices =
+	        (outerLoops != nullptr)
+	                ? toMayaIntArray(outerLoops->vertexIndices.data(), outerLoops->vertexIndices.size())
+	                : mayaVertexIndices;
+
 	MFnMesh mFnMesh1;
-	MObject newMeshObj = mFnMesh1.create(mayaVertices.length(), mayaFaceCounts.length(), mayaVertices, mayaFaceCounts,
-	                                     mayaVertexIndices, newOutputData, &stat);
+	MObject newMeshObj = mFnMesh1.create(mayaVertices.length(), createFaceCounts.length(), mayaVertices,
+	                                     createFaceCounts, createVertexIndices, newOutputData, &stat);
 	MCHECK(stat);
 
 	MFnMesh newMesh(newMeshObj);
-	assignTextureCoordinates(newMesh, uvs, uvsSizes, uvCounts, uvCountsSizes, uvIndices, uvIndicesSizes, uvSetsCount);
-	assignVertexNormals(newMesh, mayaFaceCounts, mayaVertexIndices, nrm, nrmSize, normalIndices, normalIndicesSize);
+
+	bool hasFaceVertexLayout = true;
+	if (outerLoops != nullptr) {
+		// the hole vertices are merged by position
+		for (const HoleLoops& h : outerLoops->holes) {
+			MFloatPointArray holeVertices(static_cast<unsigned int>(h.vertexIndices.size()));
+			for (unsigned int i = 0; i < holeVertices.length(); i++) {
+				const double* p = &mesh.mCoords[h.vertexIndices[i] * 3];
+				holeVertices.set(MFloatPoint(static_cast<float>(p[0] * mu::PRT_TO_SERLIO_SCALE),
+				                             static_cast<float>(p[1] * mu::PRT_TO_SERLIO_SCALE),
+				                             static_cast<float>(p[2] * mu::PRT_TO_SERLIO_SCALE)),
+				                 i);
+			}
+			const MIntArray loopCounts = toMayaIntArray(h.loopCounts.data(), h.loopCounts.size());
+			MCHECK(newMesh.addHoles(static_cast<int>(h.face), holeVertices, loopCounts, true));
+		}
+
+		// merging by position can pick another vertex at the same position (PRT meshes are not welded) or append
+		// new ones, the normals need the face vertex ids Maya ended up with
+		hasFaceVertexLayout = getFaceVertexIndices(newMesh, mayaFaceCounts, mayaVertexIndices);
+		if (!hasFaceVertexLayout)
+			LOG_WRN << "Unexpected face layout after adding the holes, skipping texture coordinates and normals";
+	}
+
+	if (hasFaceVertexLayout) {
+		const auto uvs = toPtrVec(mesh.mUvs);
+		const auto uvCounts = toPtrVec(mesh.mUvCounts);
+		const auto uvIndices = toPtrVec(mesh.mUvIndices);
+
+		assignTextureCoordinates(newMesh, uvs.first.data(), uvs.second.data(), uvCounts.first.data(),
+		                         uvCounts.second.data(), uvIndices.first.data(), uvIndices.second.data(),
+		                         mesh.mUvs.size());
+		assignVertexNormals(newMesh, mayaFaceCounts, mayaVertexIndices, mesh.mNormals.data(), mesh.mNormals.size(),
+		                    mesh.mNormalIndices.data(), mesh.mNormalIndices.size());
+	}
 
 	MFnMesh outputMesh(outMeshObj);
 	outputMesh.copyInPlace(newMeshObj);
@@ -392,23 +765,21 @@ void copyStringToWCharPtr(const std::wstring input, wchar_t* result, size_t& res
 	resultSize = input.length() + 1;
 }
 
-std::filesystem::path getAssetDir() {
-	MStatus status;
-	const std::filesystem::path workspaceRoot = mu::getWorkspaceRoot(status);
+// follows the result buffer protocol of IMayaCallbacks::addAsset, i.e. asks for a larger buffer if needed
+void copyPathToWCharPtr(const std::filesystem::path& path, wchar_t* result, size_t& resultSize) {
+	if (path.empty()) {
+		resultSize = 0;
+		return;
+	}
 
-	if (status != MS::kSuccess)
-		return {};
+	const std::wstring pathStr = path.generic_wstring();
 
-	std::filesystem::path assetDir = workspaceRoot / MAYA_ASSET_FOLDER / SERLIO_ASSET_FOLDER;
-	// create dir if it does not exist
-	try {
-		std::filesystem::create_directories(assetDir);
-	}
-	catch (std::exception& e) {
-		LOG_ERR << "Error while creating the asset cache directory at " << assetDir << ": " << e.what();
-		return {};
+	if (resultSize <= pathStr.size()) {  // also check for null-terminator
+		resultSize = pathStr.size() + 1; // ask for space for null-terminator
+		return;
 	}
-	return assetDir;
+
+	copyStringToWCharPtr(pathStr, result, resultSize);
 }
 
 void detectAndAppendCGACErrors(prt::CGAErrorLevel level, const wchar_t* message, CGACErrors& cgacErrors) {
@@ -428,23 +799,43 @@ void detectAndAppendCGACErrors(prt::CGAErrorLevel level, const wchar_t* message,
 }
 } // namespace
 
-prt::Status MayaCallbacks::generateError(size_t /*isIndex*/, prt::Status /*status*/, const wchar_t* message) {
+MayaCallbacks::InitialShapeBuffer::InitialShapeBuffer()
+    : mAttributeMapBuilder(prt::AttributeMapBuilder::create()) {}
+
+MayaCallbacks::MayaCallbacks(const MObject& inMesh, const MObject& outMesh, size_t initialShapeCount,
+                             const std::wstring& textureProfile)
+    : mInitialShapeBuffers(std::max<size_t>(initialShapeCount, 1)),
+      mAssetDir((outMesh != MObject::kNullObj) ? mu::getAssetDir() : std::filesystem::path()),
+      mTextureProfile(textureProfile), outMeshObj(outMesh), inMeshObj(inMesh) {}
+
+MayaCallbacks::InitialShapeBuffer& MayaCallbacks::getInitialShapeBuffer(size_t initialShapeIndex) {
+	assert(initialShapeIndex < mInitialShapeBuffers.size());
+	return mInitialShapeBuffers[std::min(initialShapeIndex, mInitialShapeBuffers.size() - 1)];
+}
+
+prt::Status MayaCallbacks::generateError(size_t isIndex, prt::Status /*status*/, const wchar_t* message) {
 	LOG_ERR << "GENERATE ERROR: " << message;
-	detectAndAppendCGACErrors(prt::CGAErrorLevel::CGAERROR, message, cgacErrors);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	detectAndAppendCGACErrors(prt::CGAErrorLevel::CGAERROR, message, isb.mCGACErrors);
 	return prt::STATUS_OK;
 }
 
-prt::Status MayaCallbacks::assetError(size_t /*isIndex*/, prt::CGAErrorLevel level, const wchar_t* /*key*/,
+prt::Status MayaCallbacks::assetError(size_t isIndex, prt::CGAErrorLevel level, const wchar_t* /*key*/,
                                       const wchar_t* /*uri*/, const wchar_t* message) {
 	LOG_ERR << "ASSET ERROR: " << message;
-	detectAndAppendCGACErrors(level, message, cgacErrors);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	detectAndAppendCGACErrors(level, message, isb.mCGACErrors);
 	return prt::STATUS_OK;
 }
 
-prt::Status MayaCallbacks::cgaError(size_t /*isIndex*/, int32_t /*shapeID*/, prt::CGAErrorLevel level,
+prt::Status MayaCallbacks::cgaError(size_t isIndex, int32_t /*shapeID*/, prt::CGAErrorLevel level,
                                     int32_t /*methodId*/, int32_t /*pc*/, const wchar_t* message) {
 	LOG_ERR << "CGA ERROR: " << message;
-	detectAndAppendCGACErrors(level, message, cgacErrors);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	detectAndAppendCGACErrors(level, message, isb.mCGACErrors);
 	return prt::STATUS_OK;
 }
 
@@ -468,24 +859,119 @@ prt::Status MayaCallbacks::cgaReportString(size_t /*isIndex*/, int32_t /*shapeID
 	return prt::STATUS_OK;
 }
 
-const CGACErrors& MayaCallbacks::getCGACErrors() const {
-	return cgacErrors;
+CGACErrors MayaCallbacks::getCGACErrors() const {
+	CGACErrors mergedErrors;
+	for (const InitialShapeBuffer& isb : mInitialShapeBuffers) {
+		std::lock_guard<std::mutex> lock(isb.mMutex);
+		for (const auto& [error, count] : isb.mCGACErrors) {
+			const auto [it, wasInserted] = mergedErrors.try_emplace(error, count);
+			if (!wasInserted)
+				it->second += count;
+		}
+	}
+	return mergedErrors;
+}
+
+AttributeMapUPtr MayaCallbacks::createAttributeMap(size_t initialShapeIndex) const {
+	const InitialShapeBuffer& isb = mInitialShapeBuffers.at(initialShapeIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	return AttributeMapUPtr(isb.mAttributeMapBuilder->createAttributeMap());
 }
 
-void MayaCallbacks::addMesh(const wchar_t*, const double* vtx, size_t vtxSize, const double* nrm, size_t nrmSize,
-                            const uint32_t* faceCounts, size_t faceCountsSize, const uint32_t* vertexIndices,
-                            size_t vertexIndicesSize, const uint32_t* normalIndices, size_t normalIndicesSize,
-                            double const* const* uvs, size_t const* uvsSizes, uint32_t const* const* uvCounts,
-                            size_t const* uvCountsSizes, uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
-                            size_t uvSetsCount, const uint32_t* faceRanges, size_t faceRangesSize,
-                            const prt::AttributeMap** materials, const prt::AttributeMap** reports, const int32_t*) {
+void MayaCallbacks::addMesh(size_t initialShapeIndex, const wchar_t* name, const double* vtx, size_t vtxSize,
+                            const double* nrm, size_t nrmSize, const uint32_t* faceCounts, size_t faceCountsSize,
+                            const uint32_t* vertexIndices, size_t vertexIndicesSize, const uint32_t* normalIndices,
+                            size_t normalIndicesSize, const uint32_t* holeCounts, size_t holeCountsSize,
+                            const uint32_t* holeIndices, size_t holeIndicesSize, double const* const* uvs,
+                            size_t const* uvsSizes,
+                            uint32_t const* const* uvCounts, size_t const* uvCountsSizes,
+                            uint32_t const* const* uvIndices, size_t const* uvIndicesSizes, size_t uvSetsCount,
+                            const uint32_t* faceRanges, size_t faceRangesSize, const prt::AttributeMap** materials,
+                            const prt::AttributeMap** reports, const int32_t* shapeIDs) {
+	auto mesh = std::make_unique<MeshBuffer>();
+	mesh->mName = (name != nullptr) ? name : L"";
+	mesh->mCoords.assign(vtx, vtx + vtxSize);
+	mesh->mNormals.assign(nrm, nrm + nrmSize);
+	mesh->mFaceCounts.assign(faceCounts, faceCounts + faceCountsSize);
+	mesh->mVertexIndices.assign(vertexIndices, vertexIndices + vertexIndicesSize);
+	mesh->mNormalIndices.assign(normalIndices, normalIndices + normalIndicesSize);
+	mesh->mHoleCounts.assign(holeCounts, holeCounts + holeCountsSize);
+	mesh->mHoleIndices.assign(holeIndices, holeIndices + holeIndicesSize);
+
+	mesh->mUvs.resize(uvSetsCount);
+	mesh->mUvCounts.resize(uvSetsCount);
+	mesh->mUvIndices.resize(uvSetsCount);
+	for (size_t uvSet = 0; uvSet < uvSetsCount; uvSet++) {
+		mesh->mUvs[uvSet].assign(uvs[uvSet], uvs[uvSet] + uvsSizes[uvSet]);
+		mesh->mUvCounts[uvSet].assign(uvCounts[uvSet], uvCounts[uvSet] + uvCountsSizes[uvSet]);
+		mesh->mUvIndices[uvSet].assign(uvIndices[uvSet], uvIndices[uvSet] + uvIndicesSizes[uvSet]);
+	}
+
+	mesh->mFaceRanges.assign(faceRanges, faceRanges + faceRangesSize);
+	for (size_t fri = 0; fri + 1 < faceRangesSize; fri++) {
+		if (materials != nullptr)
+			mesh->mMaterials.push_back(copyAttributeMap(materials[fri]));
+		if (reports != nullptr)
+			mesh->mReports.push_back(copyAttributeMap(reports[fri]));
+	}
+
+	if (shapeIDs != nullptr && faceRangesSize > 0)
+		mesh->mShapeIDs.assign(shapeIDs, shapeIDs + faceRangesSize - 1);
+
+	addMeshBuffer(initialShapeIndex, std::move(mesh));
+}
+
+void MayaCallbacks::addMeshBuffer(size_t initialShapeIndex, MeshBufferUPtr mesh) {
+	if (mesh == nullptr)
+		return;
+	if (mesh->mVersion != MeshBuffer::VERSION) {
+		LOG_ERR << "unsupported mesh buffer version " << mesh->mVersion << " (expected " << MeshBuffer::VERSION
+		        << "), ignoring mesh";
+		return;
+	}
+
+	InitialShapeBuffer& isb = getInitialShapeBuffer(initialShapeIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mMeshes.push_back(std::move(*mesh));
+}
+
+MStatus MayaCallbacks::commitMesh() {
+	std::vector<MeshBuffer*> meshes;
+	for (InitialShapeBuffer& isb : mInitialShapeBuffers) {
+		for (MeshBuffer& m : isb.mMeshes)
+			meshes.push_back(&m);
+	}
+
+	if (meshes.empty() || outMeshObj == MObject::kNullObj)
+		return MS::kSuccess;
+
+	MeshBuffer mesh = (meshes.size() == 1) ? std::move(*meshes.front()) : mergeMeshBuffers(meshes);
+	for (InitialShapeBuffer& isb : mInitialShapeBuffers)
+		isb.mMeshes.clear();
+
+	std::optional<OuterLoops> outerLoops;
+	if (!mesh.mHoleCounts.empty())
+		outerLoops = moveHolesToParentFaces(mesh);
+
+	std::vector<const prt::AttributeMap*> materials = prtu::toPtrVec(mesh.mMaterials);
+	std::vector<const prt::AttributeMap*> reports = prtu::toPtrVec(mesh.mReports);
+	const prt::AttributeMap** materialsPtr = materials.empty() ? nullptr : materials.data();
+	const prt::AttributeMap** reportsPtr = reports.empty() ? nullptr : reports.data();
+	const size_t faceRangesSize = mesh.mFaceRanges.size();
+
 	MStatus stat;
 	adsk::Data::Structure* fStructure = adsk::Data::Structure::structureByName(PRT_MATERIAL_STRUCTURE.c_str());
 
-	if ((fStructure == nullptr) && (materials != nullptr) && (faceRangesSize > 1)) {
-		fStructure = createNewMayaStructure(materials); // Structure to use for creation
+	if ((fStructure == nullptr) && (materialsPtr != nullptr) && (faceRangesSize > 1)) {
+		fStructure = createNewMayaStructure(materialsPtr); // Structure to use for creation
 	}
 
+	adsk::Data::Structure* fFaceRangeStructure =
+	        adsk::Data::Structure::structureByName(PRT_MATERIAL_FACE_RANGE_STRUCTURE.c_str());
+
+	if (fFaceRangeStructure == nullptr)
+		fFaceRangeStructure = createNewFaceRangeStructure();
+
 	MFnMesh inputMesh(inMeshObj);
 
 	adsk::Data::Associations newMetadata(inputMesh.metadata(&stat));
@@ -493,40 +979,33 @@ void MayaCallbacks::addMesh(const wchar_t*, const double* vtx, size_t vtxSize, c
 	MCHECK(stat);
 
 	if (fStructure != nullptr && faceRangesSize > 1) {
-		fillMetadata(fStructure, faceRanges, faceRangesSize, materials, reports, newMetadata);
+		fillMetadata(fStructure, fFaceRangeStructure, mesh.mFaceRanges.data(), faceRangesSize, materialsPtr,
+		             reportsPtr, newMetadata);
 	}
 
-	MFloatPointArray mayaVertices = toMayaFloatPointArray(vtx, vtxSize);
-	MIntArray mayaFaceCounts = toMayaIntArray(faceCounts, faceCountsSize);
-	MIntArray mayaVertexIndices = toMayaIntArray(vertexIndices, vertexIndicesSize);
-
-	if (DBG) {
-		LOG_DBG << "-- MayaCallbacks::addMesh";
-		LOG_DBG << "   faceCountsSize = " << faceCountsSize;
-		LOG_DBG << "   vertexIndicesSize = " << vertexIndicesSize;
-		LOG_DBG << "   mayaVertices.length = " << mayaVertices.length();
-		LOG_DBG << "   mayaFaceCounts.length   = " << mayaFaceCounts.length();
-		LOG_DBG << "   mayaVertexIndices.length = " << mayaVertexIndices.length();
-	}
+	updateMayaMesh(mesh, outerLoops ? &outerLoops.value() : nullptr, outMeshObj, newMetadata);
 
-	updateMayaMesh(uvs, uvsSizes, uvCounts, uvCountsSizes, uvIndices, uvIndicesSizes, uvSetsCount, nrm, nrmSize,
-	               normalIndices, normalIndicesSize, mayaVertices, mayaFaceCounts, mayaVertexIndices, outMeshObj,
-	               newMetadata);
+	return MS::kSuccess;
 }
 
-prt::Status MayaCallbacks::attrBool(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key, bool value) {
-	mAttributeMapBuilder->setBool(key, value);
+prt::Status MayaCallbacks::attrBool(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key, bool value) {
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setBool(key, value);
 	return prt::STATUS_OK;
 }
 
-prt::Status MayaCallbacks::attrFloat(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key, double value) {
-	mAttributeMapBuilder->setFloat(key, value);
+prt::Status MayaCallbacks::attrFloat(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key, double value) {
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setFloat(key, value);
 	return prt::STATUS_OK;
 }
 
-prt::Status MayaCallbacks::attrString(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key,
-                                      const wchar_t* value) {
-	mAttributeMapBuilder->setString(key, value);
+prt::Status MayaCallbacks::attrString(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key, const wchar_t* value) {
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setString(key, value);
 	return prt::STATUS_OK;
 }
 
@@ -538,66 +1017,106 @@ void MayaCallbacks::addAsset(const wchar_t* uri, const wchar_t* fileName, const
 		return;
 	}
 
-	std::filesystem::path assetDir = getAssetDir();
+	std::filesystem::path assetPath;
+	if (!mAssetDir.empty())
+		assetPath = PRTContext::get().mAssetCache.put(uri, fileName, mTextureProfile, mAssetDir, buffer, size);
 
-	const std::filesystem::path& assetPath =
-	        (!assetDir.empty()) ? PRTContext::get().mAssetCache.put(uri, fileName, assetDir, buffer, size)
-	                            : std::filesystem::path();
+	copyPathToWCharPtr(assetPath, result, resultSize);
+}
+
+prt::SimpleOutputCallbacks* MayaCallbacks::createAssetStagingCallbacks() {
+	if (mAssetDir.empty())
+		return nullptr;
+	const std::filesystem::path stagingDir = PRTContext::get().mAssetCache.createStagingDir(mAssetDir);
+	if (stagingDir.empty())
+		return nullptr;
+
+	auto stagingCallbacks = std::make_unique<StagingOutputCallbacks>(stagingDir);
+	prt::SimpleOutputCallbacks* key = stagingCallbacks.get();
+	std::lock_guard<std::mutex> lock(mStagedAssetsMutex);
+	mStagedAssets.emplace(key, StagedAsset{std::move(stagingCallbacks), {}});
+	return key;
+}
 
-	if (assetPath.empty()) {
+void MayaCallbacks::addStagedAsset(const wchar_t* uri, const wchar_t* fileName,
+                                   prt::SimpleOutputCallbacks* stagingCallbacks, wchar_t* result, size_t& resultSize) {
+	if (uri == nullptr || std::wcslen(uri) == 0 || fileName == nullptr || std::wcslen(fileName) == 0) {
+		LOG_WRN << "Skipping asset caching for invalid uri '" << uri << "' or filename '" << fileName << '"';
 		resultSize = 0;
 		return;
 	}
 
-	const std::wstring pathStr = assetPath.generic_wstring();
-
-	if (resultSize <= pathStr.size()) {  // also check for null-terminator
-		resultSize = pathStr.size() + 1; // ask for space for null-terminator
+	std::unique_lock<std::mutex> lock(mStagedAssetsMutex);
+	const auto it = mStagedAssets.find(stagingCallbacks);
+	if (it == mStagedAssets.end()) {
+		LOG_WRN << "Skipping asset caching for unknown staging callbacks of uri '" << uri << "'";
+		resultSize = 0;
 		return;
 	}
+	StagedAsset& stagedAsset = it->second;
+	lock.unlock();
+
+	// the encoder asks again if the result buffer is too small, the staged file has been moved already
+	if (stagedAsset.mAssetPath.empty() && !stagedAsset.mStagingCallbacks->getStagedFile().empty()) {
+		stagedAsset.mAssetPath = PRTContext::get().mAssetCache.putFile(
+		        uri, fileName, mTextureProfile, mAssetDir, stagedAsset.mStagingCallbacks->getStagedFile(),
+		        stagedAsset.mStagingCallbacks->getContentHash());
+	}
 
-	copyStringToWCharPtr(pathStr, result, resultSize);
+	copyPathToWCharPtr(stagedAsset.mAssetPath, result, resultSize);
 }
 
 // PRT version >= 2.3
 #if PRT_VERSION_GTE(2, 3)
 
-prt::Status MayaCallbacks::attrBoolArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key,
+prt::Status MayaCallbacks::attrBoolArray(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key,
                                          const bool* values, size_t size, size_t /*nRows*/) {
-	mAttributeMapBuilder->setBoolArray(key, values, size);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setBoolArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
-prt::Status MayaCallbacks::attrFloatArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key,
+prt::Status MayaCallbacks::attrFloatArray(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key,
                                           const double* values, size_t size, size_t /*nRows*/) {
-	mAttributeMapBuilder->setFloatArray(key, values, size);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setFloatArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
-prt::Status MayaCallbacks::attrStringArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key,
+prt::Status MayaCallbacks::attrStringArray(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key,
                                            const wchar_t* const* values, size_t size, size_t /*nRows*/) {
-	mAttributeMapBuilder->setStringArray(key, values, size);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setStringArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
 // PRT version >= 2.1
 #elif PRT_VERSION_GTE(2, 1)
 
-prt::Status MayaCallbacks::attrBoolArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key,
+prt::Status MayaCallbacks::attrBoolArray(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key,
                                          const bool* values, size_t size) {
-	mAttributeMapBuilder->setBoolArray(key, values, size);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setBoolArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
-prt::Status MayaCallbacks::attrFloatArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key,
+prt::Status MayaCallbacks::attrFloatArray(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key,
                                           const double* values, size_t size) {
-	mAttributeMapBuilder->setFloatArray(key, values, size);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setFloatArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
-prt::Status MayaCallbacks::attrStringArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* key,
+prt::Status MayaCallbacks::attrStringArray(size_t isIndex, int32_t /*shapeID*/, const wchar_t* key,
                                            const wchar_t* const* values, size_t size) {
-	mAttributeMapBuilder->setStringArray(key, values, size);
+	InitialShapeBuffer& isb = getInitialShapeBuffer(isIndex);
+	std::lock_guard<std::mutex> lock(isb.mMutex);
+	isb.mAttributeMapBuilder->setStringArray(key, values, size);
 	return prt::STATUS_OK;
 }
 
@@ -22,15 +22,20 @@
 #include "encoder/IMayaCallbacks.h"
 
 #include "utils/LogHandler.h"
+#include "utils/StagingOutputCallbacks.h"
 #include "utils/Utilities.h"
 
 #include "maya/MObject.h"
+#include "maya/MStatus.h"
 
+#include <filesystem>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 struct CGACError {
@@ -51,10 +56,15 @@ struct CGACError {
 };
 using CGACErrors = std::map<CGACError, uint32_t>;
 
+/**
+ * The callbacks may be called concurrently by PRT worker threads (one thread per initial shape). All output is buffered
+ * per initial shape and only merged (in initial shape order) into the Maya output mesh by commitMesh(), which must be
+ * called on the main thread after prt::generate returned.
+ */
 class MayaCallbacks : public IMayaCallbacks {
 public:
-	MayaCallbacks(const MObject& inMesh, const MObject& outMesh, AttributeMapBuilderUPtr& amb)
-	    : inMeshObj(inMesh), outMeshObj(outMesh), mAttributeMapBuilder(amb) {}
+	MayaCallbacks(const MObject& inMesh, const MObject& outMesh, size_t initialShapeCount = 1,
+	              const std::wstring& textureProfile = TEXTURE_PROFILE_FINAL);
 
 	// prt::Callbacks interface
 	prt::Status generateError(size_t /*isIndex*/, prt::Status /*status*/, const wchar_t* message) override;
@@ -96,16 +106,27 @@ public:
 
 #endif // PRT version >= 2.1
 
-	const CGACErrors& getCGACErrors() const;
+	// merged CGAC errors of all initial shapes
+	CGACErrors getCGACErrors() const;
+
+	// final values of the generic attributes reported for the given initial shape
+	AttributeMapUPtr createAttributeMap(size_t initialShapeIndex) const;
+
+	// merges the buffered meshes of all initial shapes and writes them to the output mesh (main thread only)
+	MStatus commitMesh();
 
 	// clang-format off
-	void addMesh(const wchar_t* name,
+	void addMesh(size_t initialShapeIndex,
+	                     const wchar_t* name,
 	                     const double* vtx, size_t vtxSize,
 	                     const double* nrm, size_t nrmSize,
 	                     const uint32_t* faceCounts, size_t faceCountsSize,
 	                     const uint32_t* vertexIndices, size_t vertexIndicesSize,
 	                     const uint32_t* normalIndices, size_t normalIndicesSize,
 
+	                     const uint32_t* holeCounts, size_t holeCountsSize,
+	                     const uint32_t* holeIndices, size_t holeIndicesSize,
+
 	                     double const* const* uvs, size_t const* uvsSizes,
 	                     uint32_t const* const* uvCounts, size_t const* uvCountsSizes,
 	                     uint32_t const* const* uvIndices, size_t const* uvIndicesSizes,
@@ -117,13 +138,38 @@ public:
 	                     const int32_t* shapeIDs) override;
 	// clang-format on
 
+	// takes over the buffers of the encoder, addMesh copies its arguments and forwards them to here
+	void addMeshBuffer(size_t initialShapeIndex, MeshBufferUPtr mesh) override;
+
 	void addAsset(const wchar_t* uri, const wchar_t* fileName, const uint8_t* buffer, size_t size, wchar_t* result,
 	              size_t& resultSize) override;
+	prt::SimpleOutputCallbacks* createAssetStagingCallbacks() override;
+	void addStagedAsset(const wchar_t* uri, const wchar_t* fileName, prt::SimpleOutputCallbacks* stagingCallbacks,
+	                    wchar_t* result, size_t& resultSize) override;
 
 private:
-	CGACErrors cgacErrors;
+	struct InitialShapeBuffer {
+		InitialShapeBuffer();
+
+		mutable std::mutex mMutex;
+		AttributeMapBuilderUPtr mAttributeMapBuilder;
+		CGACErrors mCGACErrors;
+		std::vector<MeshBuffer> mMeshes;
+	};
+
+	InitialShapeBuffer& getInitialShapeBuffer(size_t initialShapeIndex);
+
+	std::vector<InitialShapeBuffer> mInitialShapeBuffers;
+	const std::filesystem::path mAssetDir; // resolved on the main thread, addAsset is called from worker threads
+	const std::wstring mTextureProfile;    // must match the EO_TEXTURE_PROFILE encoder option
+
+	struct StagedAsset {
+		std::unique_ptr<StagingOutputCallbacks> mStagingCallbacks; // removes the staging dir when destroyed
+		std::filesystem::path mAssetPath;                          // set once added to the asset cache
+	};
+	std::unordered_map<const prt::SimpleOutputCallbacks*, StagedAsset> mStagedAssets;
+	std::mutex mStagedAssetsMutex;
+
 	MObject outMeshObj;
 	MObject inMeshObj;
-
-	AttributeMapBuilderUPtr& mAttributeMapBuilder;
 };
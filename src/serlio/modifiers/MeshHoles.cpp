@@ -0,0 +1,134 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "modifiers/MeshHoles.h"
+
+#include <algorithm>
+#include <cassert>
+
+OuterLoops moveHolesToParentFaces(IMayaCallbacks::MeshBuffer& mesh) {
+	const size_t faceCount = mesh.mFaceCounts.size();
+	assert(mesh.mHoleCounts.size() == faceCount);
+
+	std::vector<bool> isHole(faceCount, false);
+	for (uint32_t hi : mesh.mHoleIndices) {
+		if (hi < faceCount)
+			isHole[hi] = true;
+	}
+
+	std::vector<uint32_t> vertexOffsets(faceCount + 1, 0);
+	for (size_t fi = 0; fi < faceCount; fi++)
+		vertexOffsets[fi + 1] = vertexOffsets[fi] + mesh.mFaceCounts[fi];
+
+	const size_t uvSetsCount = mesh.mUvs.size();
+	std::vector<std::vector<uint32_t>> uvOffsets(uvSetsCount);
+	for (size_t uvSet = 0; uvSet < uvSetsCount; uvSet++) {
+		const std::vector<uint32_t>& uvCounts = mesh.mUvCounts[uvSet];
+		uvOffsets[uvSet].assign(faceCount + 1, 0);
+		for (size_t fi = 0; fi < faceCount && fi < uvCounts.size(); fi++)
+			uvOffsets[uvSet][fi + 1] = uvOffsets[uvSet][fi] + uvCounts[fi];
+	}
+
+	// new face index for every non-hole face (and the total count at the end)
+	std::vector<uint32_t> faceIndexMap(faceCount + 1, 0);
+	for (size_t fi = 0; fi < faceCount; fi++)
+		faceIndexMap[fi + 1] = faceIndexMap[fi] + (isHole[fi] ? 0 : 1);
+
+	OuterLoops outerLoops;
+	IMayaCallbacks::MeshBuffer result;
+	result.mUvCounts.resize(uvSetsCount);
+	result.mUvIndices.resize(uvSetsCount);
+
+	uint32_t holeIndexOffset = 0;
+	for (size_t fi = 0; fi < faceCount; fi++) {
+		const uint32_t holeCount = mesh.mHoleCounts[fi];
+		const uint32_t* holes = mesh.mHoleIndices.data() + holeIndexOffset;
+		holeIndexOffset += holeCount;
+
+		if (isHole[fi])
+			continue;
+
+		std::vector<uint32_t> loops = {static_cast<uint32_t>(fi)};
+		for (uint32_t hi = 0; hi < holeCount; hi++) {
+			if (holes[hi] < faceCount)
+				loops.push_back(holes[hi]);
+		}
+
+		outerLoops.faceCounts.push_back(mesh.mFaceCounts[fi]);
+		outerLoops.vertexIndices.insert(outerLoops.vertexIndices.end(),
+		                                mesh.mVertexIndices.begin() + vertexOffsets[fi],
+		                                mesh.mVertexIndices.begin() + vertexOffsets[fi + 1]);
+
+		HoleLoops holeLoops;
+		holeLoops.face = faceIndexMap[fi];
+
+		uint32_t completeFaceCount = 0;
+		for (const uint32_t li : loops) {
+			completeFaceCount += mesh.mFaceCounts[li];
+			for (uint32_t vi = vertexOffsets[li]; vi < vertexOffsets[li + 1]; vi++) {
+				result.mVertexIndices.push_back(mesh.mVertexIndices[vi]);
+				if (vi < mesh.mNormalIndices.size())
+					result.mNormalIndices.push_back(mesh.mNormalIndices[vi]);
+			}
+
+			if (li != fi) {
+				holeLoops.loopCounts.push_back(mesh.mFaceCounts[li]);
+				holeLoops.vertexIndices.insert(holeLoops.vertexIndices.end(),
+				                               mesh.mVertexIndices.begin() + vertexOffsets[li],
+				                               mesh.mVertexIndices.begin() + vertexOffsets[li + 1]);
+			}
+		}
+		result.mFaceCounts.push_back(completeFaceCount);
+
+		// uvs are only kept if all loops of the face have them
+		for (size_t uvSet = 0; uvSet < uvSetsCount; uvSet++) {
+			const std::vector<uint32_t>& uvCounts = mesh.mUvCounts[uvSet];
+			const bool hasUVs = std::all_of(loops.begin(), loops.end(), [&](uint32_t li) {
+				return li < uvCounts.size() && uvCounts[li] == mesh.mFaceCounts[li];
+			});
+
+			if (!hasUVs) {
+				result.mUvCounts[uvSet].push_back(0);
+				continue;
+			}
+
+			result.mUvCounts[uvSet].push_back(completeFaceCount);
+			for (const uint32_t li : loops) {
+				for (uint32_t ui = uvOffsets[uvSet][li]; ui < uvOffsets[uvSet][li + 1]; ui++)
+					result.mUvIndices[uvSet].push_back(mesh.mUvIndices[uvSet][ui]);
+			}
+		}
+
+		if (!holeLoops.loopCounts.empty())
+			outerLoops.holes.push_back(std::move(holeLoops));
+	}
+
+	mesh.mFaceCounts = std::move(result.mFaceCounts);
+	mesh.mVertexIndices = std::move(result.mVertexIndices);
+	mesh.mNormalIndices = std::move(result.mNormalIndices);
+	mesh.mUvCounts = std::move(result.mUvCounts);
+	mesh.mUvIndices = std::move(result.mUvIndices);
+	mesh.mHoleCounts.clear();
+	mesh.mHoleIndices.clear();
+
+	for (uint32_t& fr : mesh.mFaceRanges)
+		fr = faceIndexMap[std::min<size_t>(fr, faceCount)];
+
+	return outerLoops;
+}
@@ -0,0 +1,47 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "serlioPlugin.h"
+
+#include "encoder/IMayaCallbacks.h"
+
+#include <cstdint>
+#include <vector>
+
+struct HoleLoops {
+	uint32_t face; // index of the parent face in the Maya mesh
+	std::vector<uint32_t> loopCounts;
+	std::vector<uint32_t> vertexIndices; // into the coordinates of the mesh
+};
+
+struct OuterLoops {
+	std::vector<uint32_t> faceCounts;
+	std::vector<uint32_t> vertexIndices;
+	std::vector<HoleLoops> holes;
+};
+
+/**
+ * Converts the PRT hole representation (holes are separate faces referenced by their parent face) into the Maya one:
+ * the hole faces are removed and their loops are appended to the loops of their parent faces. Afterwards the face
+ * vertex data of the mesh (counts, indices, uvs) describes the complete faces incl. hole loops, the returned outer
+ * loops are used to create the mesh before adding the holes. Face ranges are remapped to the remaining faces.
+ */
+SRL_TEST_EXPORTS_API OuterLoops moveHolesToParentFaces(IMayaCallbacks::MeshBuffer& mesh);
@@ -37,6 +37,8 @@
 #include "maya/MFnTypedAttribute.h"
 #include "maya/MGlobal.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 
 namespace {
@@ -57,58 +59,17 @@ constexpr const wchar_t* MAX_KEY = L"max";
 constexpr const wchar_t* ATTRIBUTE_USER_SET_SUFFIX = L"_user_set";
 constexpr const wchar_t* ATTRIBUTE_FORCE_DEFAULT_SUFFIX = L"_force_default";
 
+// read from an option var on the main thread, the nodes might be evaluated on other threads
+std::atomic<int32_t> textureEncodingThreads{0};
+
 const AttributeMapUPtr
         EMPTY_ATTRIBUTES(AttributeMapBuilderUPtr(prt::AttributeMapBuilder::create())->createAttributeMap());
 
-enum class RangeType { RANGE, ENUM, INVALID };
-RangeType GetRangeType(const prt::Annotation* an) {
-	const size_t numArgs = an->getNumArguments();
-
-	if (numArgs == 0)
-		return RangeType::INVALID;
-
-	prt::AnnotationArgumentType commonType = an->getArgument(0)->getType();
-
-	bool hasMin = false;
-	bool hasMax = false;
-	bool hasKey = false;
-	bool onlyOneTypeInUse = true;
-
-	for (int argIdx = 0; argIdx < numArgs; argIdx++) {
-		const prt::AnnotationArgument* arg = an->getArgument(argIdx);
-		if (arg->getType() != commonType)
-			onlyOneTypeInUse = false;
-
-		const wchar_t* key = arg->getKey();
-		if (std::wcscmp(key, MIN_KEY) == 0)
-			hasMin = true;
-		else if (std::wcscmp(key, MAX_KEY) == 0)
-			hasMax = true;
-		if (std::wcscmp(key, NULL_KEY) != 0)
-			hasKey = true;
-	}
-	
-	//old Range
-	if ((numArgs == 2) && (commonType == prt::AnnotationArgumentType::AAT_FLOAT))
-		return RangeType::RANGE;
-
-	//new Range
-	if ((numArgs >= 2) && (hasMin && hasMax))
-		return RangeType::RANGE;
-
-	//legacy Enum
-	if (!hasKey && onlyOneTypeInUse)
-		return RangeType::ENUM;
-
-	return RangeType::INVALID;
-}
-
 AttributeMapUPtr getDefaultAttributeValues(const std::wstring& ruleFile, const std::wstring& startRule,
                                            const prt::ResolveMap& resolveMap, prt::CacheObject& cache,
                                            const PRTMesh& prtMesh, const int32_t seed,
                                            const prt::AttributeMap& attributeMap) {
-	AttributeMapBuilderUPtr mayaCallbacksAttributeBuilder(prt::AttributeMapBuilder::create());
-	MayaCallbacks mayaCallbacks(MObject::kNullObj, MObject::kNullObj, mayaCallbacksAttributeBuilder);
+	MayaCallbacks mayaCallbacks(MObject::kNullObj, MObject::kNullObj);
 
 	InitialShapeBuilderUPtr isb(prt::InitialShapeBuilder::create());
 
@@ -128,7 +89,7 @@ AttributeMapUPtr getDefaultAttributeValues(const std::wstring& ruleFile, const s
 	prt::generate(shapes.data(), shapes.size(), nullptr, encIDs.data(), encIDs.size(), encOpts.data(), &mayaCallbacks,
 	              &cache, nullptr);
 
-	return AttributeMapUPtr(mayaCallbacksAttributeBuilder->createAttributeMap());
+	return mayaCallbacks.createAttributeMap(0);
 }
 
 bool getIsUserSet(const MFnDependencyNode& node, const MFnAttribute& attribute) {
@@ -395,12 +356,24 @@ T getPlugValueAndRemoveAttr(MFnDependencyNode& node, const MString& briefName, c
 
 	return plugValue;
 }
+
+AttributeMapUPtr createMayaEncoderOptions(const std::wstring& textureProfile, int32_t textureEncodingThreads) {
+	AttributeMapBuilderUPtr optionsBuilder(prt::AttributeMapBuilder::create());
+
+	// Maya meshes support holes natively, no need to triangulate faces with holes
+	optionsBuilder->setBool(EO_PASS_HOLES, true);
+	optionsBuilder->setString(EO_TEXTURE_PROFILE, textureProfile.c_str());
+	optionsBuilder->setInt(EO_TEXTURE_ENCODING_THREADS, textureEncodingThreads);
+	const AttributeMapUPtr mayaOptions(optionsBuilder->createAttributeMap());
+	return prtu::createValidatedOptions(ENC_ID_MAYA, mayaOptions.get());
+}
 } // namespace
 
 PRTModifierAction::PRTModifierAction() {
 	AttributeMapBuilderUPtr optionsBuilder(prt::AttributeMapBuilder::create());
 
-	mMayaEncOpts = prtu::createValidatedOptions(ENC_ID_MAYA);
+	mTextureEncodingThreads = textureEncodingThreads;
+	mMayaEncOpts = createMayaEncoderOptions(mTextureProfile, mTextureEncodingThreads);
 
 	optionsBuilder->setString(L"name", FILE_CGA_ERROR);
 	const AttributeMapUPtr errOptions(optionsBuilder->createAttributeMapAndReset());
@@ -411,6 +384,20 @@ PRTModifierAction::PRTModifierAction() {
 	mCGAPrintOptions = prtu::createValidatedOptions(ENC_ID_CGA_PRINT, printOptions.get());
 }
 
+void PRTModifierAction::setTextureProfile(const std::wstring& textureProfile) {
+	// also picks up a changed texture encoding thread count, this is called before each generate
+	const int32_t threadCount = textureEncodingThreads;
+	if (textureProfile == mTextureProfile && threadCount == mTextureEncodingThreads)
+		return;
+	mTextureProfile = textureProfile;
+	mTextureEncodingThreads = threadCount;
+	mMayaEncOpts = createMayaEncoderOptions(mTextureProfile, mTextureEncodingThreads);
+}
+
+void PRTModifierAction::setTextureEncodingThreads(int32_t threadCount) {
+	textureEncodingThreads = std::max(threadCount, 0);
+}
+
 MStatus PRTModifierAction::fillAttributesFromNode(const MObject& node) {
 	AttributeMapBuilderSPtr aBuilder(prt::AttributeMapBuilder::create(), PRTDestroyer());
 
@@ -492,7 +479,7 @@ MStatus PRTModifierAction::fillAttributesFromNode(const MObject& node) {
 		}
 	};
 
-	iterateThroughAttributesAndApply(node, mRuleAttributes, fillAttributeFromNode);
+	iterateThroughAttributesAndApply(node, getRuleAttributeMap(), fillAttributeFromNode);
 	mGenerateAttrs.reset(aBuilder->createAttributeMap());
 
 	return MStatus::kSuccess;
@@ -577,7 +564,7 @@ MStatus PRTModifierAction::updateUserSetAttributes(const MObject& node) {
 			setIsUserSet(fnNode, fnAttribute, true);
 	};
 
-	iterateThroughAttributesAndApply(node, mRuleAttributes, updateUserSetAttribute);
+	iterateThroughAttributesAndApply(node, getRuleAttributeMap(), updateUserSetAttribute);
 
 	return MStatus::kSuccess;
 }
@@ -662,7 +649,7 @@ MStatus PRTModifierAction::updateUI(const MObject& node, MObject& cgacProblemObj
 
 				short newEnumVal = enumVal;
 				if (currEnum.isDynamic())
-					newEnumVal = currEnum.updateOptions(node, mRuleAttributes, *defaultAttributeValues, enumVal);
+					newEnumVal = currEnum.updateOptions(node, getRuleAttributeMap(), *defaultAttributeValues, enumVal);
 
 				const short defEnumVal = currEnum.getDefaultEnumValue(*defaultAttributeValues, ruleAttribute);
 
@@ -684,7 +671,7 @@ MStatus PRTModifierAction::updateUI(const MObject& node, MObject& cgacProblemObj
 
 	MPlug cgacProblemPlug(node, cgacProblemObject);
 	updateCgacProblemData(cgacProblemPlug, mCGACProblems);
-	iterateThroughAttributesAndApply(node, mRuleAttributes, updateUIFromAttributes);
+	iterateThroughAttributesAndApply(node, getRuleAttributeMap(), updateUIFromAttributes);
 
 	return MStatus::kSuccess;
 }
@@ -704,6 +691,11 @@ ResolveMapSPtr PRTModifierAction::getResolveMap() {
 	return resolveMap;
 }
 
+const RuleAttributeMap& PRTModifierAction::getRuleAttributeMap() const {
+	static const RuleAttributeMap EMPTY_RULE_ATTRIBUTES;
+	return mRuleData ? mRuleData->mRuleAttributeMap : EMPTY_RULE_ATTRIBUTES;
+}
+
 MStatus PRTModifierAction::updateRuleFiles(const MObject& node, const MString& rulePkg, MObject& cgacProblemObject) {
 	MPlug cgacProblemPlug(node, cgacProblemObject);
 
@@ -712,8 +704,8 @@ MStatus PRTModifierAction::updateRuleFiles(const MObject& node, const MString& r
 	mEnums.clear();
 	mRuleFile.clear();
 	mStartRule.clear();
-	mRuleAttributes.clear();
-	PRTContext::get().mPRTCache.get()->flushAll();
+	mRuleData.reset();
+	mRulePackageUsage.reset();
 
 	std::filesystem::path rulePkgPath(mRulePkg.asWChar());
 	if (!std::filesystem::exists(rulePkgPath)) {
@@ -723,55 +715,57 @@ MStatus PRTModifierAction::updateRuleFiles(const MObject& node, const MString& r
 		return MS::kFailure;
 	}
 
-	ResolveMapSPtr resolveMap = getResolveMap();
-	if (!resolveMap) {
+	// the rule file info, start rule and rule attributes are shared by all nodes using this rule package
+	ResolveMapCache& resolveMapCache = *PRTContext::get().mResolveMapCache;
+	const std::wstring rulePkgKey(mRulePkg.asWChar());
+	// the file watcher might have missed a modification (e.g. on a network share), the rule files are only updated
+	// for a new rule package or on an explicit reload, so this does not stat the rpk on every evaluation
+	resolveMapCache.revalidate(rulePkgKey);
+	mRulePackageUsage = resolveMapCache.acquire(rulePkgKey); // not evicted while this node uses it
+	ResolveMapCache::RuleDataSPtr ruleData = resolveMapCache.getRuleData(rulePkgKey).first;
+	if (!ruleData) {
 		CGACErrors cgacProblems =
 		        createCGACErrorFromString(MString("failed to get resolve map from rule package ") + mRulePkg.asWChar());
 		updateCgacProblemData(cgacProblemPlug, cgacProblems);
 		return MS::kFailure;
 	}
 
-	mRuleFile = prtu::getRuleFileEntry(resolveMap);
-	if (mRuleFile.empty()) {
-		CGACErrors cgacProblems =
-		        createCGACErrorFromString(MString("could not find rule file in rule package ") + mRulePkg.asWChar());
-		updateCgacProblemData(cgacProblemPlug, cgacProblems);
-		return MS::kFailure;
-	}
-
-	prt::Status infoStatus = prt::STATUS_UNSPECIFIED_ERROR;
-	const wchar_t* ruleFileURI = resolveMap->getString(mRuleFile.c_str());
-	if (ruleFileURI == nullptr) {
-		CGACErrors cgacProblems = createCGACErrorFromString(
-		        MString("could not find rule file URI in resolve map of rule package ") + mRulePkg.asWChar());
-		updateCgacProblemData(cgacProblemPlug, cgacProblems);
-		return MS::kFailure;
-	}
-
-	RuleFileInfoUPtr info(prt::createRuleFileInfo(ruleFileURI, PRTContext::get().mPRTCache.get(), &infoStatus));
-	if (!info || infoStatus != prt::STATUS_OK) {
-		CGACErrors cgacProblems =
-		        createCGACErrorFromString(MString("could not get rule file info from rule file ") + mRulePkg.asWChar());
-		updateCgacProblemData(cgacProblemPlug, cgacProblems);
-		return MS::kFailure;
+	mRuleFile = ruleData->mRuleFile;
+	switch (ruleData->mStatus) {
+		case ResolveMapCache::RuleData::Status::OK:
+			break;
+		case ResolveMapCache::RuleData::Status::NO_RULE_FILE: {
+			CGACErrors cgacProblems = createCGACErrorFromString(
+			        MString("could not find rule file in rule package ") + mRulePkg.asWChar());
+			updateCgacProblemData(cgacProblemPlug, cgacProblems);
+			return MS::kFailure;
+		}
+		case ResolveMapCache::RuleData::Status::NO_RULE_FILE_URI: {
+			CGACErrors cgacProblems = createCGACErrorFromString(
+			        MString("could not find rule file URI in resolve map of rule package ") + mRulePkg.asWChar());
+			updateCgacProblemData(cgacProblemPlug, cgacProblems);
+			return MS::kFailure;
+		}
+		case ResolveMapCache::RuleData::Status::NO_RULE_FILE_INFO: {
+			CGACErrors cgacProblems = createCGACErrorFromString(
+			        MString("could not get rule file info from rule file ") + mRulePkg.asWChar());
+			updateCgacProblemData(cgacProblemPlug, cgacProblems);
+			return MS::kFailure;
+		}
 	}
 
-	mStartRule = prtu::detectStartRule(info);
+	mRuleData = ruleData;
+	mStartRule = mRuleData->mStartRule;
 	mGenerateAttrs = getDefaultAttributeValues(mRuleFile, mStartRule, *getResolveMap(), *PRTContext::get().mPRTCache,
 	                                           *inPrtMesh, mRandomSeed, *EMPTY_ATTRIBUTES);
 	if (DBG)
 		LOG_DBG << "default attrs: " << prtu::objectToXML(mGenerateAttrs);
 
 	if (node != MObject::kNullObj) {
-		// derive necessary data from PRT rule info to populate node with dynamic rule attributes
-		RuleAttributeSet ruleAttributes = getRuleAttributes(mRuleFile, info.get());
-		for (const RuleAttribute& ruleAttr : ruleAttributes) {
-			mRuleAttributes[ruleAttr.mayaFullName] = ruleAttr;
-		}
-
-		createNodeAttributes(ruleAttributes, node, info.get());
+		// populate node with dynamic rule attributes
+		createNodeAttributes(*mRuleData, node);
 		for (auto& enumPair : mEnums) {
-			enumPair.second.updateOptions(node, mRuleAttributes, *mGenerateAttrs);
+			enumPair.second.updateOptions(node, getRuleAttributeMap(), *mGenerateAttrs);
 		}
 	}
 
@@ -781,8 +775,7 @@ MStatus PRTModifierAction::updateRuleFiles(const MObject& node, const MString& r
 MStatus PRTModifierAction::doIt() {
 	MStatus status;
 
-	AttributeMapBuilderUPtr amb(prt::AttributeMapBuilder::create());
-	std::unique_ptr<MayaCallbacks> outputHandler(new MayaCallbacks(inMesh, outMesh, amb));
+	std::unique_ptr<MayaCallbacks> outputHandler(new MayaCallbacks(inMesh, outMesh, 1, mTextureProfile));
 
 	InitialShapeBuilderUPtr isb(prt::InitialShapeBuilder::create());
 	const prt::Status setGeoStatus =
@@ -805,6 +798,7 @@ MStatus PRTModifierAction::doIt() {
 	        prt::generate(shapes.data(), shapes.size(), nullptr, encIDs.data(), encIDs.size(), encOpts.data(),
 	                      outputHandler.get(), PRTContext::get().mPRTCache.get(), nullptr);
 
+	MCHECK(outputHandler->commitMesh());
 	mCGACProblems = outputHandler->getCGACErrors();
 
 	if (generateStatus != prt::STATUS_OK) {
@@ -818,13 +812,12 @@ MStatus PRTModifierAction::doIt() {
 	return status;
 }
 
-MStatus PRTModifierAction::createNodeAttributes(const RuleAttributeSet& ruleAttributes, const MObject& nodeObj,
-                                                const prt::RuleFileInfo* info) {
+MStatus PRTModifierAction::createNodeAttributes(const ResolveMapCache::RuleData& ruleData, const MObject& nodeObj) {
 	MStatus stat;
 	MFnDependencyNode node(nodeObj, &stat);
 	MCHECK(stat);
 
-	for (const RuleAttribute& p : ruleAttributes) {
+	for (const RuleAttribute& p : ruleData.mRuleAttributes) {
 		const std::wstring fqName = p.fqName;
 
 		// only use attributes of current style
@@ -834,60 +827,10 @@ MStatus PRTModifierAction::createNodeAttributes(const RuleAttributeSet& ruleAttr
 
 		const prt::Attributable::PrimitiveType attrType = mGenerateAttrs->getType(fqName.c_str());
 
-		// TMP: detect attribute traits based on rule info / annotations
-		enum class AttributeTrait { ENUM, RANGE, FILE, DIR, COLOR, PLAIN };
-		struct AttributeTraitPayload { // intermediate representation of annotation data, poor man's std::variant
-			std::wstring mString;
-			const prt::Annotation* mAnnot = nullptr; // TODO: just while refactoring...
-		};
-
-		auto detectAttributeTrait =
-		        [&info](const std::wstring& key) -> std::pair<AttributeTrait, AttributeTraitPayload> {
-			for (size_t ai = 0, numAttrs = info->getNumAttributes(); ai < numAttrs; ai++) {
-				const auto* attr = info->getAttribute(ai);
-				if (std::wcscmp(key.c_str(), attr->getName()) != 0)
-					continue;
-
-				for (size_t a = 0; a < attr->getNumAnnotations(); a++) {
-					const prt::Annotation* an = attr->getAnnotation(a);
-					const wchar_t* anName = an->getName();
-					if (std::wcscmp(anName, ANNOT_ENUM) == 0)
-						return {AttributeTrait::ENUM, {{}, an}};
-					else if (std::wcscmp(anName, ANNOT_RANGE) == 0) {
-						const RangeType annotationRangeType = GetRangeType(an);
-						switch (annotationRangeType) {
-							case RangeType::ENUM:
-								return {AttributeTrait::ENUM, {{}, an}};
-							case RangeType::RANGE:
-								return {AttributeTrait::RANGE, {{}, an}};
-							case RangeType::INVALID:
-								return {AttributeTrait::PLAIN, {}};
-						}
-					}
-					else if (std::wcscmp(anName, ANNOT_COLOR) == 0)
-						return {AttributeTrait::COLOR, {}};
-					else if (std::wcscmp(anName, ANNOT_DIR) == 0) {
-						return {AttributeTrait::DIR, {}};
-					}
-					else if (std::wcscmp(anName, ANNOT_FILE) == 0) {
-						std::wstring exts;
-						for (size_t arg = 0; arg < an->getNumArguments(); arg++) {
-							if (an->getArgument(arg)->getType() == prt::AAT_STR) {
-								exts += an->getArgument(arg)->getStr();
-								exts += L" (*.";
-								exts += an->getArgument(arg)->getStr();
-								exts += L");";
-							}
-						}
-						exts += L"All Files (*.*)";
-						return {AttributeTrait::FILE, {exts, nullptr}};
-					}
-				}
-			}
-			return {AttributeTrait::PLAIN, {}};
-		};
-
-		auto attrTrait = detectAttributeTrait(fqName);
+		const auto attrTraitIt = ruleData.mAttributeTraits.find(fqName);
+		AttributeTraitInfo attrTrait = (attrTraitIt != ruleData.mAttributeTraits.end())
+		                                       ? attrTraitIt->second
+		                                       : AttributeTraitInfo{AttributeTrait::PLAIN, {}};
 
 		MObject attr;
 
@@ -1008,8 +951,8 @@ MStatus PRTModifierAction::createNodeAttributes(const RuleAttributeSet& ruleAttr
 void PRTModifierAction::removeUnusedAttribs(MFnDependencyNode& node) {
 	auto isInUse = [this](const MString& attrName) {
 		const std::wstring attrNameWithoutSuffix = removeSuffix(attrName.asWChar());
-		auto it = mRuleAttributes.find(attrNameWithoutSuffix);
-		return (it != mRuleAttributes.end());
+		auto it = getRuleAttributeMap().find(attrNameWithoutSuffix);
+		return (it != getRuleAttributeMap().end());
 	};
 
 	std::list<MObject> attrToRemove;
@@ -38,6 +38,7 @@
 #include "maya/MString.h"
 #include "maya/MStringArray.h"
 
+#include <cstdint>
 #include <list>
 #include <map>
 #include <variant>
@@ -60,6 +61,10 @@ public:
 	void setRandomSeed(int32_t randomSeed) {
 		mRandomSeed = randomSeed;
 	};
+	void setTextureProfile(const std::wstring& textureProfile);
+
+	// applies to the next generate of all nodes (0: one thread per hardware thread), set on the main thread
+	static void setTextureEncodingThreads(int32_t threadCount);
 
 	// polyModifierFty inherited methods
 	MStatus doIt() override;
@@ -70,6 +75,9 @@ private:
 	AttributeMapUPtr mCGAPrintOptions;
 	AttributeMapUPtr mCGAErrorOptions;
 
+	std::wstring mTextureProfile = TEXTURE_PROFILE_FINAL;
+	int32_t mTextureEncodingThreads = 0; // the value mMayaEncOpts has been created with
+
 	// Mesh Nodes: only used during doIt
 	MObject inMesh;
 	MObject outMesh;
@@ -84,17 +92,18 @@ private:
 	std::wstring mStartRule;
 	const std::wstring mRuleStyle = L"Default"; // Serlio atm only supports the "Default" style
 	int32_t mRandomSeed = 0;
-	RuleAttributeMap mRuleAttributes; // TODO: could be cached together with ResolveMap
+	ResolveMapCache::RuleDataSPtr mRuleData; // shared with all nodes using the same rule package
+	ResolveMapCache::UsageToken mRulePackageUsage;
 
 	ResolveMapSPtr getResolveMap();
+	const RuleAttributeMap& getRuleAttributeMap() const;
 
 	// init in fillAttributesFromNode()
 	AttributeMapUPtr mGenerateAttrs;
 
 	std::map<std::wstring, PRTModifierEnum> mEnums;
 
-	MStatus createNodeAttributes(const RuleAttributeSet& ruleAttributes, const MObject& node,
-	                             const prt::RuleFileInfo* info);
+	MStatus createNodeAttributes(const ResolveMapCache::RuleData& ruleData, const MObject& node);
 	void removeUnusedAttribs(MFnDependencyNode& node);
 
 	static MStatus addParameter(MFnDependencyNode& node, MObject& attr, MFnAttribute& tAttr);
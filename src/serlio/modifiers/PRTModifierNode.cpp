@@ -19,6 +19,7 @@
 
 #include "modifiers/PRTModifierNode.h"
 
+#include "utils/MItDependencyNodesWrapper.h"
 #include "utils/MayaUtilities.h"
 
 #include "serlioPlugin.h"
@@ -29,6 +30,15 @@
 #include "maya/MFnStringArrayData.h"
 #include "maya/MFnStringData.h"
 #include "maya/MFnTypedAttribute.h"
+#include "maya/MGlobal.h"
+#include "maya/MItDependencyNodes.h"
+#include "maya/MPlug.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <set>
+#include <vector>
 
 #define MCheckStatus(status, message)                                                                                  \
 	if (MStatus::kSuccess != (status)) {                                                                               \
@@ -39,6 +49,10 @@
 namespace {
 const MString NAME_RULE_PKG = "Rule_Package";
 const MString NAME_RANDOM_SEED = "Random_Seed";
+const MString NAME_TEXTURE_PROFILE = "Texture_Profile";
+
+// order must match the enum field indices of the texture profile attribute
+const std::array<const wchar_t*, 2> TEXTURE_PROFILES = {TEXTURE_PROFILE_FINAL, TEXTURE_PROFILE_INTERACTIVE};
 const MString CGAC_PROBLEMS = "CGAC_Problems";
 } // namespace
 
@@ -48,6 +62,7 @@ MObject PRTModifierNode::rulePkg;
 MObject PRTModifierNode::cgacProblems;
 MObject PRTModifierNode::currentRulePkg;
 MObject PRTModifierNode::mRandomSeed;
+MObject PRTModifierNode::mTextureProfile;
 
 // make sure the dynamically added plugs affect the outMesh
 MStatus PRTModifierNode::setDependentsDirty(const MPlug& /*plugBeingDirtied*/, MPlugArray& affectedPlugs) {
@@ -85,6 +100,10 @@ MStatus PRTModifierNode::compute(const MPlug& plug, MDataBlock& data) {
 		// compute. If this node doesn't know how to compute it,
 		// we must return MS::kUnknownParameter
 		if (plug == outMesh) {
+			// waits for the PRT initialization started when serlio was loaded
+			if (!PRTContext::get().isAlive())
+				return MS::kFailure;
+
 			MDataHandle inputData = data.inputValue(inMesh, &status);
 			MCheckStatus(status, "ERROR getting inMesh");
 
@@ -116,6 +135,11 @@ MStatus PRTModifierNode::compute(const MPlug& plug, MDataBlock& data) {
 			MDataHandle randomSeed = data.inputValue(mRandomSeed, &status);
 			fPRTModifierAction.setRandomSeed(randomSeed.asInt());
 
+			MDataHandle textureProfile = data.inputValue(mTextureProfile, &status);
+			const size_t textureProfileIndex =
+			        std::min<size_t>(std::max<short>(textureProfile.asShort(), 0), TEXTURE_PROFILES.size() - 1);
+			fPRTModifierAction.setTextureProfile(TEXTURE_PROFILES[textureProfileIndex]);
+
 			if (ruleFileWasChanged) {
 				status = fPRTModifierAction.updateRuleFiles(thisMObject(), rulePkgData.asString(), cgacProblems);
 
@@ -144,6 +168,57 @@ MStatus PRTModifierNode::compute(const MPlug& plug, MDataBlock& data) {
 	return status;
 }
 
+void PRTModifierNode::reloadRulePackages(const std::vector<std::wstring>& rulePackages) {
+	std::set<std::filesystem::path> rulePackagePaths;
+	for (const std::wstring& rulePackage : rulePackages)
+		rulePackagePaths.insert(std::filesystem::path(rulePackage).lexically_normal());
+
+	MStatus status;
+	MItDependencyNodes nodeIt(MFn::kPluginDependNode, &status);
+	MCHECK(status);
+
+	bool reloaded = false;
+	for (const auto& nodeObj : MItDependencyNodesWrapper(nodeIt)) {
+		const MFnDependencyNode node(nodeObj);
+		if (node.typeId() != id)
+			continue;
+
+		const MPlug rulePkgPlug(nodeObj, rulePkg);
+		if (rulePackagePaths.count(std::filesystem::path(rulePkgPlug.asString().asWChar()).lexically_normal()) == 0)
+			continue;
+
+		// same as prtReloadRPK in AEserlioTemplate.mel
+		MPlug currentRulePkgPlug(nodeObj, currentRulePkg);
+		MCHECK(currentRulePkgPlug.setString(""));
+		MCHECK(MGlobal::executeCommand("dgdirty " + node.name()));
+		reloaded = true;
+	}
+
+	if (reloaded)
+		MCHECK(MGlobal::executeCommandOnIdle("refreshEditorTemplates()"));
+}
+
+std::vector<std::wstring> PRTModifierNode::getRulePackages() {
+	std::vector<std::wstring> rulePackages;
+
+	MStatus status;
+	MItDependencyNodes nodeIt(MFn::kPluginDependNode, &status);
+	MCHECK(status);
+
+	for (const auto& nodeObj : MItDependencyNodesWrapper(nodeIt)) {
+		const MFnDependencyNode node(nodeObj);
+		if (node.typeId() != id)
+			continue;
+
+		const MPlug rulePkgPlug(nodeObj, rulePkg);
+		const MString rulePackage = rulePkgPlug.asString();
+		if (rulePackage.length() > 0)
+			rulePackages.emplace_back(rulePackage.asWChar());
+	}
+
+	return rulePackages;
+}
+
 MStatus PRTModifierNode::initialize()
 // Description:
 //  This method is called to create and initialize all of the attributes
@@ -206,6 +281,16 @@ MStatus PRTModifierNode::initialize()
 	MCHECK(addAttribute(mRandomSeed));
 	MCHECK(attributeAffects(mRandomSeed, outMesh));
 
+	mTextureProfile = enumFn.create(NAME_TEXTURE_PROFILE, "textureProfile", 0, &stat);
+	MCHECK(stat);
+	MCHECK(enumFn.addField("Final", 0));
+	MCHECK(enumFn.addField("Interactive", 1));
+	MCHECK(enumFn.setCached(true));
+	MCHECK(enumFn.setStorable(true));
+	MCHECK(enumFn.setNiceNameOverride(MString("Texture Profile")));
+	MCHECK(addAttribute(mTextureProfile));
+	MCHECK(attributeAffects(mTextureProfile, outMesh));
+
 	currentRulePkg = fAttr.create("current" + NAME_RULE_PKG, "currentRulePkg", MFnData::kString,
 	                              stringData.create(&stat2), &stat);
 	MCHECK(stat2);
@@ -35,6 +35,12 @@ public:
 
 	static MStatus initialize();
 
+	// forces the serlio nodes using one of the rule packages to reload it at their next compute (main thread only)
+	static void reloadRulePackages(const std::vector<std::wstring>& rulePackages);
+
+	// the rule packages of all serlio nodes in the scene
+	static std::vector<std::wstring> getRulePackages();
+
 public:
 	// non-dynamic node attributes
 	static MObject rulePkg;
@@ -42,6 +48,7 @@ public:
 	static MObject currentRulePkg;
 	static MTypeId id;
 	static MObject mRandomSeed;
+	static MObject mTextureProfile;
 
 	PRTModifierAction fPRTModifierAction;
 };
@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <cassert>
 #include <filesystem>
+#include <optional>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -37,6 +38,10 @@ constexpr bool DBG = false;
 
 constexpr const wchar_t* PRT_ATTR_FULL_NAME_PREFIX = L"PRT_";
 
+constexpr const wchar_t* NULL_KEY = L"#NULL#";
+constexpr const wchar_t* MIN_KEY = L"min";
+constexpr const wchar_t* MAX_KEY = L"max";
+
 std::wstring getFullName(const std::wstring& fqAttrName, std::map<std::wstring, int>& mayaNameDuplicateCountMap) {
 	const std::wstring fullName = PRT_ATTR_FULL_NAME_PREFIX + prtu::cleanNameForMaya(fqAttrName);
 	// make sure maya names are unique
@@ -57,6 +62,89 @@ std::wstring getNiceName(const std::wstring& fqAttrName) {
 	return prtu::cleanNameForMaya(getAttrBaseName(fqAttrName));
 }
 
+enum class RangeType { RANGE, ENUM, INVALID };
+RangeType GetRangeType(const prt::Annotation* an) {
+	const size_t numArgs = an->getNumArguments();
+
+	if (numArgs == 0)
+		return RangeType::INVALID;
+
+	prt::AnnotationArgumentType commonType = an->getArgument(0)->getType();
+
+	bool hasMin = false;
+	bool hasMax = false;
+	bool hasKey = false;
+	bool onlyOneTypeInUse = true;
+
+	for (int argIdx = 0; argIdx < numArgs; argIdx++) {
+		const prt::AnnotationArgument* arg = an->getArgument(argIdx);
+		if (arg->getType() != commonType)
+			onlyOneTypeInUse = false;
+
+		const wchar_t* key = arg->getKey();
+		if (std::wcscmp(key, MIN_KEY) == 0)
+			hasMin = true;
+		else if (std::wcscmp(key, MAX_KEY) == 0)
+			hasMax = true;
+		if (std::wcscmp(key, NULL_KEY) != 0)
+			hasKey = true;
+	}
+
+	//old Range
+	if ((numArgs == 2) && (commonType == prt::AnnotationArgumentType::AAT_FLOAT))
+		return RangeType::RANGE;
+
+	//new Range
+	if ((numArgs >= 2) && (hasMin && hasMax))
+		return RangeType::RANGE;
+
+	//legacy Enum
+	if (!hasKey && onlyOneTypeInUse)
+		return RangeType::ENUM;
+
+	return RangeType::INVALID;
+}
+
+// the first trait annotation of the attribute wins
+std::optional<AttributeTraitInfo> detectAttributeTrait(const prt::RuleFileInfo::Entry* attr) {
+	for (size_t a = 0; a < attr->getNumAnnotations(); a++) {
+		const prt::Annotation* an = attr->getAnnotation(a);
+		const wchar_t* anName = an->getName();
+		if (std::wcscmp(anName, ANNOT_ENUM) == 0)
+			return AttributeTraitInfo{AttributeTrait::ENUM, {{}, an}};
+		else if (std::wcscmp(anName, ANNOT_RANGE) == 0) {
+			const RangeType annotationRangeType = GetRangeType(an);
+			switch (annotationRangeType) {
+				case RangeType::ENUM:
+					return AttributeTraitInfo{AttributeTrait::ENUM, {{}, an}};
+				case RangeType::RANGE:
+					return AttributeTraitInfo{AttributeTrait::RANGE, {{}, an}};
+				case RangeType::INVALID:
+					return AttributeTraitInfo{AttributeTrait::PLAIN, {}};
+			}
+		}
+		else if (std::wcscmp(anName, ANNOT_COLOR) == 0)
+			return AttributeTraitInfo{AttributeTrait::COLOR, {}};
+		else if (std::wcscmp(anName, ANNOT_DIR) == 0) {
+			return AttributeTraitInfo{AttributeTrait::DIR, {}};
+		}
+		else if (std::wcscmp(anName, ANNOT_FILE) == 0) {
+			std::wstring exts;
+			for (size_t arg = 0; arg < an->getNumArguments(); arg++) {
+				if (an->getArgument(arg)->getType() == prt::AAT_STR) {
+					exts += an->getArgument(arg)->getStr();
+					exts += L" (*.";
+					exts += an->getArgument(arg)->getStr();
+					exts += L");";
+				}
+			}
+			exts += L"All Files (*.*)";
+			return AttributeTraitInfo{AttributeTrait::FILE, {exts, nullptr}};
+		}
+	}
+	return {};
+}
+
 } // namespace
 
 std::map<std::wstring, int> getImportOrderMap(const prt::RuleFileInfo* ruleFileInfo) {
@@ -181,6 +269,22 @@ RuleAttributeSet getRuleAttributes(const std::wstring& ruleFile, const prt::Rule
 	return sortedRuleAttributes;
 }
 
+AttributeTraitMap getAttributeTraits(const prt::RuleFileInfo* ruleFileInfo) {
+	AttributeTraitMap attributeTraits;
+	for (size_t i = 0; i < ruleFileInfo->getNumAttributes(); i++) {
+		const prt::RuleFileInfo::Entry* attr = ruleFileInfo->getAttribute(i);
+
+		// attributes can appear several times (e.g. with parameters), the first one with a trait annotation wins
+		if (attributeTraits.find(attr->getName()) != attributeTraits.end())
+			continue;
+
+		std::optional<AttributeTraitInfo> attrTrait = detectAttributeTrait(attr);
+		if (attrTrait)
+			attributeTraits.emplace(attr->getName(), std::move(*attrTrait));
+	}
+	return attributeTraits;
+}
+
 bool RuleAttributeCmp::operator()(const RuleAttribute& lhs, const RuleAttribute& rhs) const {
 	auto compareRuleFile = [](const RuleAttribute& a, const RuleAttribute& b) {
 		// sort main rule attributes before the rest
@@ -27,6 +27,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace prt {
@@ -75,6 +76,18 @@ using RuleAttributeVec = std::vector<RuleAttribute>;
 using RuleAttributeSet = std::set<RuleAttribute, RuleAttributeCmp>;
 using RuleAttributeMap = std::map<std::wstring, RuleAttribute>;
 
+// attribute traits detected from the annotations of the rule attributes
+enum class AttributeTrait { ENUM, RANGE, FILE, DIR, COLOR, PLAIN };
+struct AttributeTraitPayload { // intermediate representation of annotation data, poor man's std::variant
+	std::wstring mString;
+	const prt::Annotation* mAnnot = nullptr; // owned by the rule file info the traits were detected from
+};
+using AttributeTraitInfo = std::pair<AttributeTrait, AttributeTraitPayload>;
+using AttributeTraitMap = std::map<std::wstring, AttributeTraitInfo>; // key is the fully qualified attribute name
+
+// attributes without trait annotations are not contained (i.e. they are PLAIN)
+AttributeTraitMap getAttributeTraits(const prt::RuleFileInfo* ruleFileInfo);
+
 SRL_TEST_EXPORTS_API RuleAttributeSet getRuleAttributes(const std::wstring& ruleFile,
                                                         const prt::RuleFileInfo* ruleFileInfo);
 void setGlobalGroupOrder(RuleAttributeVec& ruleAttributes);
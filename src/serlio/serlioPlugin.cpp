@@ -20,6 +20,7 @@
 #include "PRTContext.h"
 #include "serlioPlugin.h"
 
+#include "modifiers/PRTModifierAction.h"
 #include "modifiers/PRTModifierCommand.h"
 #include "modifiers/PRTModifierNode.h"
 
@@ -27,36 +28,135 @@
 #include "materials/MaterialCommand.h"
 #include "materials/StingrayMaterialNode.h"
 
+#include "utils/AssetCacheCommand.h"
 #include "utils/MayaUtilities.h"
 
+#include "maya/MCallbackIdArray.h"
 #include "maya/MFnPlugin.h"
 #include "maya/MGlobal.h"
+#include "maya/MMessage.h"
 #include "maya/MSceneMessage.h"
 #include "maya/MStatus.h"
 #include "maya/MString.h"
 
+#include <cstdint>
 #include <mutex>
+#include <string>
+#include <vector>
 
 namespace {
 constexpr bool DBG = false;
 
+constexpr const char* PLUGIN_NAME = "serlio";
 constexpr const char* NODE_MODIFIER = "serlio";
 constexpr const char* NODE_MATERIAL = "serlioMaterial";
 constexpr const char* NODE_ARNOLD_MATERIAL = "serlioArnoldMaterial";
 constexpr const char* CMD_CREATE_MATERIAL = "serlioCreateMaterial";
 constexpr const char* CMD_ASSIGN = "serlioAssign";
+constexpr const char* CMD_CACHE = "serlioCache";
 constexpr const char* MEL_PROC_CREATE_UI = "serlioCreateUI";
 constexpr const char* MEL_PROC_DELETE_UI = "serlioDeleteUI";
 constexpr const char* SERLIO_VENDOR = "Esri R&D Center Zurich";
 
 std::once_flag callbackRegisterFlag;
 
+MCallbackIdArray sceneCallbackIds;
+
+void registerSceneCallbacks() {
+	// the cached asset directory depends on the current workspace
+	auto invalidateAssetDirCallback = [](void*) { mu::invalidateAssetDir(); };
+
+	for (const MSceneMessage::Message msg :
+	     {MSceneMessage::kWorkspaceChanged, MSceneMessage::kAfterNew, MSceneMessage::kAfterOpen}) {
+		MStatus status;
+		const MCallbackId id = MSceneMessage::addCallback(msg, invalidateAssetDirCallback, nullptr, &status);
+		MCHECK(status);
+		if (status == MS::kSuccess)
+			sceneCallbackIds.append(id);
+	}
+
+	// resolve the rule packages of the loaded nodes on worker threads before the nodes are evaluated
+	auto prefetchRulePackagesCallback = [](void*) {
+		const PRTContext& prtCtx = PRTContext::get();
+		if (prtCtx.mResolveMapCache)
+			prtCtx.mResolveMapCache->prefetch(PRTModifierNode::getRulePackages());
+	};
+
+	for (const MSceneMessage::Message msg :
+	     {MSceneMessage::kAfterOpen, MSceneMessage::kAfterImport, MSceneMessage::kAfterLoadReference}) {
+		MStatus status;
+		const MCallbackId id = MSceneMessage::addCallback(msg, prefetchRulePackagesCallback, nullptr, &status);
+		MCHECK(status);
+		if (status == MS::kSuccess)
+			sceneCallbackIds.append(id);
+	}
+
+	// keep the asset cache of the (new) workspace within its budget
+	auto pruneAssetCacheCallback = [](void*) { AssetCacheCommand::pruneToBudget(); };
+
+	for (const MSceneMessage::Message msg : {MSceneMessage::kAfterNew, MSceneMessage::kAfterOpen}) {
+		MStatus status;
+		const MCallbackId id = MSceneMessage::addCallback(msg, pruneAssetCacheCallback, nullptr, &status);
+		MCHECK(status);
+		if (status == MS::kSuccess)
+			sceneCallbackIds.append(id);
+	}
+}
+
+void deregisterSceneCallbacks() {
+	MCHECK(MMessage::removeCallbacks(sceneCallbackIds));
+	sceneCallbackIds.clear();
+}
+
+// the rule packages modified since the last reload task, which reloads all of them at once
+std::mutex changedRulePackagesMutex;
+std::vector<std::wstring> changedRulePackages;
+
+// called on the file watcher thread of the resolve map cache, the nodes may only be touched on the main thread
+void rulePackageChangedCallback(const std::vector<std::wstring>& rulePkgs) {
+	auto reloadRulePackagesTask = [](void*) {
+		std::vector<std::wstring> rulePkgs;
+		{
+			std::lock_guard<std::mutex> lock(changedRulePackagesMutex);
+			rulePkgs.swap(changedRulePackages);
+		}
+		PRTModifierNode::reloadRulePackages(rulePkgs);
+	};
+
+	std::lock_guard<std::mutex> lock(changedRulePackagesMutex);
+	const bool isTaskPending = !changedRulePackages.empty();
+	changedRulePackages.insert(changedRulePackages.end(), rulePkgs.begin(), rulePkgs.end());
+	if (!isTaskPending && !changedRulePackages.empty())
+		MGlobal::executeTaskOnIdle(reloadRulePackagesTask, nullptr);
+}
+
+// called on the PRT initialization thread, serlio cannot be used without PRT (see the log for the cause)
+void prtInitializationFailedCallback() {
+	auto unloadPluginTask = [](void*) {
+		MGlobal::displayError("Serlio: could not initialize PRT, the plugin is unloaded");
+		// not executeCommand: the plugin must not be unloaded while this task is running
+		MCHECK(MGlobal::executeCommandOnIdle(MString("unloadPlugin ") + PLUGIN_NAME));
+	};
+	MGlobal::executeTaskOnIdle(unloadPluginTask, nullptr);
+}
+
 } // namespace
 
 // called when the plug-in is loaded into Maya.
 MStatus initializePlugin(MObject obj) {
-	if (!PRTContext::get().isAlive()) // this will implicitly load PRT
-		return MS::kFailure;
+	// loading the PRT extensions takes a while, therefore PRT is initialized in the background while Maya continues
+	// loading serlio, the first use of PRTContext::get() (e.g. in a node compute) waits for it
+	// (the option vars may only be read on the main thread)
+	const uintmax_t rulePackageBudget = AssetCacheCommand::getRulePackageBudget();
+	PRTModifierAction::setTextureEncodingThreads(AssetCacheCommand::getTextureEncodingThreads());
+	PRTContext::initializeAsync([rulePackageBudget](PRTContext& prtCtx) {
+		if (!prtCtx.isAlive()) {
+			prtInitializationFailedCallback();
+			return;
+		}
+		prtCtx.mResolveMapCache->setInvalidationListener(rulePackageChangedCallback);
+		prtCtx.mResolveMapCache->setBudget(rulePackageBudget);
+	});
 
 	// maya exit does not call uninitializePlugin automatically, therefore use addCallback
 	// we only do this once in case the serlio plugin is unload and loaded again
@@ -68,6 +168,8 @@ MStatus initializePlugin(MObject obj) {
 		MCHECK(mayaStatus);
 	});
 
+	registerSceneCallbacks();
+
 	MFnPlugin plugin(obj, SERLIO_VENDOR, SRL_VERSION);
 
 	auto createModifierCommand = []() { return (void*)new PRTModifierCommand(); };
@@ -76,6 +178,9 @@ MStatus initializePlugin(MObject obj) {
 	auto createMaterialCommand = []() { return (void*)new MaterialCommand(); };
 	MCHECK(plugin.registerCommand(CMD_CREATE_MATERIAL, createMaterialCommand));
 
+	auto createCacheCommand = []() { return (void*)new AssetCacheCommand(); };
+	MCHECK(plugin.registerCommand(CMD_CACHE, createCacheCommand, AssetCacheCommand::newSyntax));
+
 	auto createModifierNode = []() { return (void*)new PRTModifierNode(); };
 	MCHECK(plugin.registerNode(NODE_MODIFIER, PRTModifierNode::id, createModifierNode, PRTModifierNode::initialize));
 
@@ -101,9 +206,16 @@ MStatus uninitializePlugin(MObject obj) {
 	// * PRT only supports initializing once per process life time
 
 	MStatus status;
+	deregisterSceneCallbacks();
+	PRTContext& prtCtx = PRTContext::get();
+	if (prtCtx.mResolveMapCache)
+		prtCtx.mResolveMapCache->setInvalidationListener({});
+	prtCtx.stopBackgroundThreads();
+
 	if (obj != MObject::kNullObj) { // TODO
 		MFnPlugin plugin(obj);
 		MCHECK(plugin.deregisterCommand(CMD_ASSIGN));
+		MCHECK(plugin.deregisterCommand(CMD_CACHE));
 		MCHECK(plugin.deregisterNode(PRTModifierNode::id));
 		MCHECK(plugin.deregisterNode(StingrayMaterialNode::id));
 		MCHECK(plugin.deregisterNode(ArnoldMaterialNode::id));
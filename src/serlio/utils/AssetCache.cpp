@@ -19,74 +19,822 @@
 
 #include "AssetCache.h"
 
+#include "utils/ContentHash.h"
 #include "utils/LogHandler.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <ctime>
 #include <fstream>
 #include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
 #include <ostream>
+#include <shared_mutex>
+#include <sstream>
 #include <string_view>
+#include <unordered_set>
+#include <vector>
 
 namespace {
 
-bool writeCacheEntry(const std::filesystem::path& assetPath, const uint8_t* buffer, size_t size) noexcept {
-	if (std::filesystem::exists(assetPath))
-		return true;
-	std::ofstream stream(assetPath, std::ofstream::binary | std::ofstream::trunc);
-	if (!stream)
+constexpr bool DBG = false;
+
+const std::wstring STAGING_DIR = L".staging";
+constexpr auto STAGING_DIR_MAX_AGE = std::chrono::hours(24); // older ones have been left behind by crashed sessions
+
+const std::wstring MANIFEST_EXTENSION = L".manifest";
+const std::string MANIFEST_HEADER = "serlio_asset_manifest\t1";
+constexpr size_t MANIFEST_COMPACTION_MIN_RECORDS = 1024;
+const std::string MANIFEST_ACCESS_RECORD_TAG = "@";
+constexpr time_t ACCESS_RECORD_INTERVAL = 60 * 60; // seconds, the resolution of the LRU eviction
+
+// one tab separated line (UTF-8) per cache entry, later records supersede earlier ones
+struct ManifestRecord {
+	std::wstring uri;
+	std::wstring textureProfile;
+	uint64_t hash = 0;
+	time_t rpkModificationTime = -1; // -1 if the asset does not originate from an rpk
+	std::filesystem::path assetFile; // relative to the cache root dir
+	uintmax_t assetSize = 0;
+	time_t assetModificationTime = -1;
+};
+
+std::optional<ManifestRecord> parseManifestRecord(const std::string& line) {
+	std::vector<std::string> fields;
+	std::istringstream lineStream(line);
+	for (std::string field; std::getline(lineStream, field, '\t');)
+		fields.push_back(field);
+	if (fields.size() != 7)
+		return {};
+
+	try {
+		ManifestRecord record;
+		record.uri = prtu::toUTF16FromUTF8(fields[0]);
+		record.textureProfile = prtu::toUTF16FromUTF8(fields[1]);
+		record.hash = std::stoull(fields[2]);
+		record.rpkModificationTime = static_cast<time_t>(std::stoll(fields[3]));
+		record.assetFile = prtu::toUTF16FromUTF8(fields[4]);
+		record.assetSize = std::stoull(fields[5]);
+		record.assetModificationTime = static_cast<time_t>(std::stoll(fields[6]));
+		return record;
+	}
+	catch (const std::exception&) {
+		return {};
+	}
+}
+
+// "@", asset file, time: the asset has been used at the given time
+struct ManifestAccessRecord {
+	std::filesystem::path assetFile;
+	time_t accessTime = 0;
+};
+
+struct Manifest {
+	std::vector<ManifestRecord> records;
+	std::vector<ManifestAccessRecord> accessRecords;
+	size_t lineCount = 0; // including unparsable lines
+};
+
+std::optional<ManifestAccessRecord> parseManifestAccessRecord(const std::string& line) {
+	const size_t timeSeparator = line.rfind('\t');
+	const size_t tagSeparator = MANIFEST_ACCESS_RECORD_TAG.size();
+	if (timeSeparator == std::string::npos || timeSeparator <= tagSeparator)
+		return {};
+
+	try {
+		ManifestAccessRecord record;
+		record.assetFile = prtu::toUTF16FromUTF8(line.substr(tagSeparator + 1, timeSeparator - tagSeparator - 1));
+		record.accessTime = static_cast<time_t>(std::stoll(line.substr(timeSeparator + 1)));
+		return record;
+	}
+	catch (const std::exception&) {
+		return {};
+	}
+}
+
+std::string formatManifestAccessRecord(const ManifestAccessRecord& record) {
+	std::ostringstream line;
+	line << MANIFEST_ACCESS_RECORD_TAG << '\t' << prtu::toUTF8FromUTF16(record.assetFile.generic_wstring()) << '\t'
+	     << record.accessTime;
+	return line.str();
+}
+
+std::string formatManifestRecord(const ManifestRecord& record) {
+	std::ostringstream line;
+	line << prtu::toUTF8FromUTF16(record.uri) << '\t' << prtu::toUTF8FromUTF16(record.textureProfile) << '\t'
+	     << record.hash << '\t' << record.rpkModificationTime << '\t'
+	     << prtu::toUTF8FromUTF16(record.assetFile.generic_wstring()) << '\t' << record.assetSize << '\t'
+	     << record.assetModificationTime;
+	return line.str();
+}
+
+bool isPersistable(const std::wstring& s) {
+	return s.find_first_of(L"\t\r\n") == std::wstring::npos;
+}
+
+// the cached asset must not have been modified or replaced since the record has been written
+bool isValidManifestRecord(const ManifestRecord& record, const std::filesystem::path& cacheRootDir) {
+	const std::filesystem::path assetPath = cacheRootDir / record.assetFile;
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(assetPath, ec);
+	if (ec || size != record.assetSize)
 		return false;
-	stream.write(reinterpret_cast<const char*>(buffer), size);
+	return prtu::getFileModificationTime(assetPath.wstring()) == record.assetModificationTime;
+}
+
+bool isManifestAccessRecord(const std::string& line) {
+	return line.compare(0, MANIFEST_ACCESS_RECORD_TAG.size() + 1, MANIFEST_ACCESS_RECORD_TAG + '\t') == 0;
+}
+
+// returns nothing if there is no (readable) manifest
+std::optional<Manifest> readManifest(const std::filesystem::path& manifestPath) {
+	std::ifstream stream(manifestPath, std::ifstream::binary);
 	if (!stream)
-		return false;
-	stream.close();
-	return true;
+		return {};
+
+	std::string line;
+	if (!std::getline(stream, line) || line != MANIFEST_HEADER) {
+		LOG_WRN << "Ignoring asset cache manifest with unknown format: " << manifestPath;
+		return {};
+	}
+
+	Manifest manifest;
+	while (std::getline(stream, line)) {
+		if (line.empty())
+			continue;
+		manifest.lineCount++;
+		if (isManifestAccessRecord(line)) {
+			if (std::optional<ManifestAccessRecord> accessRecord = parseManifestAccessRecord(line))
+				manifest.accessRecords.emplace_back(std::move(*accessRecord));
+		}
+		else if (std::optional<ManifestRecord> record = parseManifestRecord(line)) {
+			manifest.records.emplace_back(std::move(*record));
+		}
+	}
+	return manifest;
+}
+
+// replaces the manifest atomically, an interrupted write leaves the previous manifest intact
+bool writeManifest(const std::filesystem::path& manifestPath, const Manifest& manifest) {
+	std::filesystem::path tmpPath = manifestPath;
+	tmpPath += L".tmp";
+	{
+		std::ofstream stream(tmpPath, std::ofstream::binary | std::ofstream::trunc);
+		if (!stream)
+			return false;
+		stream << MANIFEST_HEADER << '\n';
+		for (const ManifestRecord& record : manifest.records)
+			stream << formatManifestRecord(record) << '\n';
+		for (const ManifestAccessRecord& accessRecord : manifest.accessRecords)
+			stream << formatManifestAccessRecord(accessRecord) << '\n';
+		if (!stream)
+			return false;
+	}
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, manifestPath, ec);
+	return !ec;
+}
+
+// e.g. rpk:file:/path/to/rules.rpk!/assets/texture.jpg, not available for nested rpks or in-memory assets
+std::optional<time_t> getRPKModificationTime(const std::wstring& uri) {
+	constexpr std::wstring_view RPK_SCHEME = L"rpk:";
+	if (uri.compare(0, RPK_SCHEME.size(), RPK_SCHEME) != 0)
+		return {};
+
+	const size_t entrySeparator = uri.find(L'!');
+	if (entrySeparator == std::wstring::npos)
+		return {};
+
+	const std::wstring rpkURI = uri.substr(RPK_SCHEME.size(), entrySeparator - RPK_SCHEME.size());
+	const std::filesystem::path rpkPath = prtu::fromFileURI(rpkURI);
+	if (rpkPath.empty())
+		return {};
+
+	const time_t modificationTime = prtu::getFileModificationTime(rpkPath.wstring());
+	if (modificationTime < 0)
+		return {};
+	return modificationTime;
+}
+
+std::wstring getAssetKey(const std::filesystem::path& assetPath) {
+	return assetPath.lexically_normal().make_preferred().wstring();
+}
+
+void removeStagingDir(const std::filesystem::path& stagedFile, const std::filesystem::path& cacheRootDir) {
+	const std::filesystem::path stagingDir = stagedFile.parent_path();
+	if (stagingDir.parent_path() != cacheRootDir / STAGING_DIR)
+		return; // not created by us, only remove the file
+	std::error_code ec;
+	std::filesystem::remove_all(stagingDir, ec);
+}
+
+// the staging dirs of running sessions (e.g. another Maya using the same workspace) are younger
+void removeStaleStagingDirs(const std::filesystem::path& cacheRootDir) {
+	const auto now = std::filesystem::file_time_type::clock::now();
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(cacheRootDir / STAGING_DIR, ec)) {
+		const std::filesystem::file_time_type modificationTime = entry.last_write_time(ec);
+		if (ec || now - modificationTime < STAGING_DIR_MAX_AGE)
+			continue;
+		if constexpr (DBG)
+			LOG_DBG << "removing stale staging dir " << entry.path();
+		std::filesystem::remove_all(entry.path(), ec);
+	}
+}
+
+// runs func only once for concurrent calls with the same key, the other callers wait for its result
+template <typename InFlightMap, typename Func>
+std::filesystem::path runOnce(std::mutex& mutex, InFlightMap& inFlight, const typename InFlightMap::key_type& key,
+                              Func&& func) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (const auto it = inFlight.find(key); it != inFlight.end()) {
+		const std::shared_future<std::filesystem::path> result = it->second;
+		lock.unlock();
+		return result.get();
+	}
+	std::promise<std::filesystem::path> promise;
+	inFlight.emplace(key, promise.get_future().share());
+	lock.unlock();
+
+	// the result has been added to the cache by func, later callers find it there
+	auto finish = [&]() {
+		lock.lock();
+		inFlight.erase(key);
+		lock.unlock();
+	};
+	try {
+		const std::filesystem::path result = func();
+		finish();
+		promise.set_value(result);
+		return result;
+	}
+	catch (...) {
+		finish();
+		promise.set_exception(std::current_exception());
+		throw;
+	}
 }
 
 } // namespace
 
-std::filesystem::path AssetCache::put(const wchar_t* uri, const wchar_t* fileName,
+std::filesystem::path AssetCache::put(const wchar_t* uri, const wchar_t* fileName, const std::wstring& textureProfile,
                                       const std::filesystem::path cacheRootDir, const uint8_t* buffer, size_t size) {
 	assert(uri != nullptr);
-	std::wstring stringUri(uri);
+	const std::wstring stringUri(uri);
+
+	std::shared_lock<std::shared_mutex> pruneLock(mPruneMutex);
+	loadManifest(cacheRootDir);
+	Shard& shard = getShard(stringUri);
+
+	const std::optional<FastPathKey> fastPathKey = getFastPathKey(uri, textureProfile, cacheRootDir, size);
+
+	auto putContent = [&]() {
+		const Key key{stringUri, textureProfile, ContentHash::hash(buffer, size)};
+
+		// the writer might block if it is busy, no locks are held meanwhile
+		auto writeAsset = [this, buffer, size](const std::filesystem::path& assetPath, AssetWriter::Callback onStored) {
+			// another uri with the same content is being written already, its file is shared
+			if (!markPending(assetPath)) {
+				whenWritten(assetPath, std::move(onStored));
+				return true;
+			}
+			auto onWritten = [this, assetPath, onStored = std::move(onStored)](bool success) {
+				onStored(success);
+				unmarkPending(assetPath, success);
+			};
+			mWriter.write(assetPath, buffer, size, std::move(onWritten));
+			return true;
+		};
+		return putEntry(shard, cacheRootDir, key, fastPathKey, fileName, size, writeAsset);
+	};
+
+	if (fastPathKey)
+		return putFastPath(shard, cacheRootDir, *fastPathKey, putContent);
+	return putContent();
+}
+
+std::filesystem::path AssetCache::putFile(const wchar_t* uri, const wchar_t* fileName,
+                                          const std::wstring& textureProfile, const std::filesystem::path cacheRootDir,
+                                          const std::filesystem::path& stagedFile,
+                                          std::optional<uint64_t> contentHash) {
+	assert(uri != nullptr);
+	const std::wstring stringUri(uri);
 
-	const std::string_view bufferView(reinterpret_cast<const char*>(buffer), size);
-	const size_t hash = std::hash<std::string_view>{}(bufferView);
-	const auto key = std::make_pair(stringUri, hash);
+	struct StagingDirRemover {
+		const std::filesystem::path& stagedFile;
+		const std::filesystem::path& cacheRootDir;
+		~StagingDirRemover() {
+			std::error_code ec;
+			std::filesystem::remove(stagedFile, ec);
+			removeStagingDir(stagedFile, cacheRootDir);
+		}
+	} stagingDirRemover{stagedFile, cacheRootDir};
 
-	const auto it = mCache.find(key);
+	std::shared_lock<std::shared_mutex> pruneLock(mPruneMutex);
+	loadManifest(cacheRootDir);
+	Shard& shard = getShard(stringUri);
 
-	// reuse cached asset if uri and hash match
-	if (it != mCache.end()) {
-		const std::filesystem::path& assetPath = it->second;
-		if (std::filesystem::exists(assetPath)) {
-			return assetPath;
+	std::error_code sizeError;
+	const uintmax_t size = std::filesystem::file_size(stagedFile, sizeError);
+	if (sizeError) {
+		LOG_ERR << "Failed to read staged asset, skipping asset: " << stagedFile << ": " << sizeError.message();
+		return {};
+	}
+	const std::optional<FastPathKey> fastPathKey =
+	        getFastPathKey(uri, textureProfile, cacheRootDir, static_cast<size_t>(size));
+
+	auto putContent = [&]() -> std::filesystem::path {
+		const std::optional<uint64_t> hash = contentHash ? contentHash : ContentHash::hashFile(stagedFile);
+		if (!hash) {
+			LOG_ERR << "Failed to read staged asset, skipping asset: " << stagedFile;
+			return {};
 		}
+		const Key key{stringUri, textureProfile, *hash};
+
+		// the staged file is already on disk, moving it is cheap and does not need the writer
+		auto moveAsset = [&stagedFile](const std::filesystem::path& assetPath, AssetWriter::Callback onStored) {
+			std::error_code ec;
+			std::filesystem::rename(stagedFile, assetPath, ec);
+			if (ec) {
+				LOG_ERR << "Failed to put asset into cache, skipping asset: " << assetPath << ": " << ec.message();
+				return false;
+			}
+			onStored(true);
+			return true;
+		};
+		return putEntry(shard, cacheRootDir, key, fastPathKey, fileName, size, moveAsset);
+	};
+
+	if (fastPathKey)
+		return putFastPath(shard, cacheRootDir, *fastPathKey, putContent);
+	return putContent();
+}
+
+AssetCache::Shard& AssetCache::getShard(const std::wstring& key) {
+	return mShards[std::hash<std::wstring>{}(key) % SHARD_COUNT];
+}
+
+std::filesystem::path AssetCache::putFastPath(Shard& shard, const std::filesystem::path& cacheRootDir,
+                                              const FastPathKey& fastPathKey,
+                                              const std::function<std::filesystem::path()>& putContent) {
+	if (const std::optional<std::filesystem::path> assetPath = lookupFastPath(shard, fastPathKey)) {
+		recordAccess(cacheRootDir, *assetPath);
+		return *assetPath;
 	}
 
-	const std::filesystem::path newAssetPath = getCachedPath(fileName, cacheRootDir, hash);
+	// concurrent puts of the same rpk asset only hash it once
+	return runOnce(shard.mMutex, shard.mInFlightFastPath, fastPathKey, [&]() {
+		// it might have been added after the lookup above
+		if (const std::optional<std::filesystem::path> assetPath = lookupFastPath(shard, fastPathKey)) {
+			recordAccess(cacheRootDir, *assetPath);
+			return *assetPath;
+		}
+		return putContent();
+	});
+}
+
+std::filesystem::path AssetCache::putEntry(Shard& shard, const std::filesystem::path& cacheRootDir, const Key& key,
+                                           const std::optional<FastPathKey>& fastPathKey, const wchar_t* fileName,
+                                           uintmax_t size, const StoreAssetFunc& storeAsset) {
+	// concurrent puts of the same asset only store it once
+	return runOnce(shard.mMutex, shard.mInFlight, key, [&]() -> std::filesystem::path {
+		std::optional<std::filesystem::path> cachedAssetPath;
+		{
+			std::lock_guard<std::mutex> lock(shard.mMutex);
+			const auto it = shard.mCache.find(key);
+			if (it != shard.mCache.end())
+				cachedAssetPath = it->second;
+		}
+
+		// reuse cached asset if uri and hash match
+		if (cachedAssetPath && isAvailable(*cachedAssetPath)) {
+			if (fastPathKey) {
+				addEntry(shard, key, fastPathKey, *cachedAssetPath);
+				persistEntryWhenWritten(cacheRootDir, key, fastPathKey, *cachedAssetPath);
+			}
+			recordAccess(cacheRootDir, *cachedAssetPath);
+			return *cachedAssetPath;
+		}
+
+		const std::filesystem::path cachedPath = getCachedPath(fileName, cacheRootDir, key.mHash);
+		if (cachedPath.empty()) {
+			LOG_ERR << "Invalid URI, cannot cache the asset: " << key.mUri;
+			return {};
+		}
+
+		// the same content reached through another uri or name shares its file, maya loads it only once
+		const ContentKey contentKey{cacheRootDir, key.mHash, size, cachedPath.extension().wstring()};
+		Shard& contentShard = mShards[key.mHash % SHARD_COUNT];
+		bool isStored = false;
+		auto storeContent = [&]() -> std::filesystem::path {
+			const std::filesystem::path contentPath = claimContentPath(contentKey, cachedPath);
+			if (isAvailable(contentPath))
+				return contentPath;
+
+			addEntry(shard, key, fastPathKey, contentPath);
+			recordAccess(cacheRootDir, contentPath);
+
+			auto onStored = [this, cacheRootDir, key, fastPathKey, contentPath](bool success) {
+				if (success)
+					persistEntry(cacheRootDir, key, fastPathKey, contentPath);
+				else
+					removeEntries({getAssetKey(contentPath)});
+			};
+			if (!storeAsset(contentPath, std::move(onStored))) {
+				removeEntries({getAssetKey(contentPath)});
+				return {};
+			}
+			isStored = true;
+			return contentPath;
+		};
+		const std::filesystem::path newAssetPath =
+		        runOnce(contentShard.mMutex, contentShard.mInFlightContent, contentKey, storeContent);
+		if (newAssetPath.empty() || isStored)
+			return newAssetPath;
+
+		// the content is stored already (or is being written)
+		addEntry(shard, key, fastPathKey, newAssetPath);
+		persistEntryWhenWritten(cacheRootDir, key, fastPathKey, newAssetPath);
+		recordAccess(cacheRootDir, newAssetPath);
+		return newAssetPath;
+	});
+}
+
+// returns the path of the first asset with the given content, or assetPath if there is none
+std::filesystem::path AssetCache::claimContentPath(const ContentKey& contentKey,
+                                                   const std::filesystem::path& assetPath) {
+	Shard& shard = mShards[contentKey.mHash % SHARD_COUNT];
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	const auto [it, inserted] = shard.mContentPaths.try_emplace(contentKey, assetPath);
+	if (!inserted && !isAvailable(it->second))
+		it->second = assetPath; // e.g. removed by the user
+	return it->second;
+}
+
+std::optional<AssetCache::FastPathKey>
+AssetCache::getFastPathKey(const wchar_t* uri, const std::wstring& textureProfile,
+                           const std::filesystem::path& cacheRootDir, size_t size) const {
+	const std::optional<time_t> rpkModificationTime = getRPKModificationTime(uri);
+	if (!rpkModificationTime)
+		return {};
+	return FastPathKey{uri, textureProfile, cacheRootDir, size, *rpkModificationTime};
+}
 
-	if (newAssetPath.empty()) {
-		LOG_ERR << "Invalid URI, cannot cache the asset: " << uri;
+std::optional<std::filesystem::path> AssetCache::lookupFastPath(Shard& shard, const FastPathKey& fastPathKey) {
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	const auto it = shard.mFastPathCache.find(fastPathKey);
+	if (it == shard.mFastPathCache.end())
 		return {};
+	return it->second;
+}
+
+void AssetCache::addEntry(Shard& shard, const Key& key, const std::optional<FastPathKey>& fastPathKey,
+                          const std::filesystem::path& assetPath) {
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	shard.mCache[key] = assetPath;
+	if (fastPathKey)
+		shard.mFastPathCache[*fastPathKey] = assetPath;
+}
+
+// the asset file must exist, the manifest record includes its size and modification time
+void AssetCache::persistEntry(const std::filesystem::path& cacheRootDir, const Key& key,
+                              const std::optional<FastPathKey>& fastPathKey, const std::filesystem::path& assetPath) {
+	if (!isPersistable(key.mUri) || !isPersistable(key.mTextureProfile))
+		return;
+
+	std::error_code ec;
+	const std::filesystem::path assetFile = assetPath.lexically_relative(cacheRootDir);
+	const uintmax_t assetSize = std::filesystem::file_size(assetPath, ec);
+	const time_t assetModificationTime = prtu::getFileModificationTime(assetPath.wstring());
+	if (assetFile.empty() || ec || assetModificationTime < 0)
+		return;
+
+	const ManifestRecord record{key.mUri,
+	                           key.mTextureProfile,
+	                           key.mHash,
+	                           fastPathKey ? fastPathKey->mRPKModificationTime : -1,
+	                           assetFile,
+	                           assetSize,
+	                           assetModificationTime};
+	appendToManifest(cacheRootDir, formatManifestRecord(record));
+}
+
+// the record of an asset which is still being written is persisted once the file is in place
+void AssetCache::persistEntryWhenWritten(const std::filesystem::path& cacheRootDir, const Key& key,
+                                         const std::optional<FastPathKey>& fastPathKey,
+                                         const std::filesystem::path& assetPath) {
+	whenWritten(assetPath, [this, cacheRootDir, key, fastPathKey, assetPath](bool success) {
+		if (success)
+			persistEntry(cacheRootDir, key, fastPathKey, assetPath);
+	});
+}
+
+void AssetCache::loadManifest(const std::filesystem::path& cacheRootDir) {
+	{
+		std::shared_lock<std::shared_mutex> lock(mManifestMutex);
+		if (mManifests.find(cacheRootDir.wstring()) != mManifests.end())
+			return;
 	}
 
-	if (!writeCacheEntry(newAssetPath, buffer, size)) {
-		LOG_ERR << "Failed to put asset into cache, skipping asset: " << newAssetPath;
+	std::lock_guard<std::shared_mutex> lock(mManifestMutex);
+	if (mManifests.find(cacheRootDir.wstring()) != mManifests.end())
+		return; // loaded by another thread meanwhile
+
+	removeStaleStagingDirs(cacheRootDir);
+
+	const std::filesystem::path manifestPath = getManifestPath(cacheRootDir);
+	std::optional<Manifest> manifestContent = readManifest(manifestPath);
+
+	Manifest validContent;
+	if (manifestContent) {
+		validContent.records.reserve(manifestContent->records.size());
+		std::unordered_map<std::wstring, time_t> lastAccess;
+		std::unordered_map<std::wstring, std::filesystem::path> validAssetFiles;
+		for (ManifestRecord& record : manifestContent->records) {
+			if (!isValidManifestRecord(record, cacheRootDir))
+				continue;
+
+			const std::filesystem::path assetPath = cacheRootDir / record.assetFile;
+			Shard& shard = getShard(record.uri);
+			{
+				std::lock_guard<std::mutex> shardLock(shard.mMutex);
+				shard.mCache[Key{record.uri, record.textureProfile, record.hash}] = assetPath;
+				if (record.rpkModificationTime >= 0) {
+					const FastPathKey fastPathKey{record.uri, record.textureProfile, cacheRootDir,
+					                              static_cast<size_t>(record.assetSize), record.rpkModificationTime};
+					shard.mFastPathCache[fastPathKey] = assetPath;
+				}
+			}
+			{
+				const ContentKey contentKey{cacheRootDir, record.hash, record.assetSize,
+				                            record.assetFile.extension().wstring()};
+				Shard& contentShard = mShards[record.hash % SHARD_COUNT];
+				std::lock_guard<std::mutex> shardLock(contentShard.mMutex);
+				contentShard.mContentPaths.try_emplace(contentKey, assetPath);
+			}
+
+			const std::wstring assetKey = getAssetKey(assetPath);
+			lastAccess[assetKey] = std::max(lastAccess[assetKey], record.assetModificationTime);
+			validAssetFiles.emplace(assetKey, record.assetFile);
+			validContent.records.emplace_back(std::move(record));
+		}
+
+		for (const ManifestAccessRecord& accessRecord : manifestContent->accessRecords) {
+			const auto it = lastAccess.find(getAssetKey(cacheRootDir / accessRecord.assetFile));
+			if (it != lastAccess.end())
+				it->second = std::max(it->second, accessRecord.accessTime);
+		}
+		for (const auto& [assetKey, assetFile] : validAssetFiles)
+			validContent.accessRecords.push_back({assetFile, lastAccess[assetKey]});
+
+		for (const auto& [assetKey, accessTime] : lastAccess) {
+			Shard& shard = getShard(assetKey);
+			std::lock_guard<std::mutex> shardLock(shard.mMutex);
+			time_t& shardLastAccess = shard.mLastAccess[assetKey];
+			shardLastAccess = std::max(shardLastAccess, accessTime);
+		}
+	}
+
+	if constexpr (DBG)
+		LOG_DBG << "Loaded " << validContent.records.size() << " asset cache manifest records from " << manifestPath;
+
+	// start a new manifest if there is none yet or if it mostly consists of outdated records
+	const size_t lineCount = manifestContent ? manifestContent->lineCount : 0;
+	const size_t validLineCount = validContent.records.size() + validContent.accessRecords.size();
+	const bool shouldCompact = lineCount >= MANIFEST_COMPACTION_MIN_RECORDS && lineCount > 2 * validLineCount;
+	if (!manifestContent || shouldCompact) {
+		if (!writeManifest(manifestPath, validContent))
+			LOG_WRN << "Failed to write asset cache manifest " << manifestPath;
+	}
+
+	std::ofstream& manifest = mManifests[cacheRootDir.wstring()];
+	manifest.open(manifestPath, std::ofstream::binary | std::ofstream::app);
+	if (!manifest)
+		LOG_WRN << "Failed to open asset cache manifest " << manifestPath << ", cache entries will not be persisted";
+}
+
+void AssetCache::appendToManifest(const std::filesystem::path& cacheRootDir, const std::string& line) {
+	std::lock_guard<std::shared_mutex> lock(mManifestMutex);
+	const auto manifestIt = mManifests.find(cacheRootDir.wstring());
+	if (manifestIt == mManifests.end() || !manifestIt->second)
+		return;
+
+	std::ofstream& manifest = manifestIt->second;
+	manifest << line << '\n';
+	manifest.flush(); // keep the manifest consistent if maya is terminated
+}
+
+void AssetCache::recordAccess(const std::filesystem::path& cacheRootDir, const std::filesystem::path& assetPath) {
+	const time_t now = std::time(nullptr);
+	const std::wstring assetKey = getAssetKey(assetPath);
+	{
+		Shard& shard = getShard(assetKey);
+		std::lock_guard<std::mutex> lock(shard.mMutex);
+		time_t& lastAccess = shard.mLastAccess[assetKey];
+		if (now - lastAccess < ACCESS_RECORD_INTERVAL)
+			return;
+		lastAccess = now;
+	}
+
+	const std::filesystem::path assetFile = assetPath.lexically_relative(cacheRootDir);
+	if (assetFile.empty())
+		return;
+	appendToManifest(cacheRootDir, formatManifestAccessRecord({assetFile, now}));
+}
+
+std::optional<time_t> AssetCache::getLastAccess(const std::wstring& assetKey) {
+	Shard& shard = getShard(assetKey);
+	std::lock_guard<std::mutex> lock(shard.mMutex);
+	const auto it = shard.mLastAccess.find(assetKey);
+	if (it == shard.mLastAccess.end())
 		return {};
+	return it->second;
+}
+
+void AssetCache::removeEntries(const std::unordered_set<std::wstring>& assetKeys) {
+	auto isRemoved = [&assetKeys](const auto& entry) { return assetKeys.count(getAssetKey(entry.second)) > 0; };
+	for (Shard& shard : mShards) {
+		std::lock_guard<std::mutex> lock(shard.mMutex);
+		for (auto it = shard.mCache.begin(); it != shard.mCache.end();)
+			it = isRemoved(*it) ? shard.mCache.erase(it) : std::next(it);
+		for (auto it = shard.mFastPathCache.begin(); it != shard.mFastPathCache.end();)
+			it = isRemoved(*it) ? shard.mFastPathCache.erase(it) : std::next(it);
+		for (auto it = shard.mContentPaths.begin(); it != shard.mContentPaths.end();)
+			it = isRemoved(*it) ? shard.mContentPaths.erase(it) : std::next(it);
+	}
+	for (const std::wstring& assetKey : assetKeys) {
+		Shard& shard = getShard(assetKey);
+		std::lock_guard<std::mutex> lock(shard.mMutex);
+		shard.mLastAccess.erase(assetKey);
+	}
+}
+
+bool AssetCache::isAvailable(const std::filesystem::path& assetPath) {
+	{
+		std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+		if (mPendingWrites.find(getAssetKey(assetPath)) != mPendingWrites.end())
+			return true;
+	}
+	return std::filesystem::exists(assetPath);
+}
+
+// returns false if the asset is pending already
+bool AssetCache::markPending(const std::filesystem::path& assetPath) {
+	std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+	return mPendingWrites.try_emplace(getAssetKey(assetPath)).second;
+}
+
+void AssetCache::unmarkPending(const std::filesystem::path& assetPath, bool success) {
+	std::vector<AssetWriter::Callback> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+		const auto it = mPendingWrites.find(getAssetKey(assetPath));
+		if (it == mPendingWrites.end())
+			return;
+		callbacks = std::move(it->second);
+		mPendingWrites.erase(it);
+	}
+	for (const AssetWriter::Callback& callback : callbacks)
+		callback(success);
+}
+
+// calls onWritten once the pending write of the asset has finished, right away if it is not pending
+void AssetCache::whenWritten(const std::filesystem::path& assetPath, AssetWriter::Callback onWritten) {
+	{
+		std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+		const auto it = mPendingWrites.find(getAssetKey(assetPath));
+		if (it != mPendingWrites.end()) {
+			it->second.push_back(std::move(onWritten));
+			return;
+		}
+	}
+	std::error_code ec;
+	onWritten(std::filesystem::exists(assetPath, ec));
+}
+
+void AssetCache::flush() {
+	mWriter.flush();
+}
+
+void AssetCache::stop() {
+	mWriter.stop();
+}
+
+std::filesystem::path AssetCache::getManifestPath(const std::filesystem::path& cacheRootDir) {
+	std::filesystem::path manifestPath = cacheRootDir;
+	manifestPath += MANIFEST_EXTENSION;
+	return manifestPath;
+}
+
+AssetCache::Usage AssetCache::getUsage(const std::filesystem::path& cacheRootDir) {
+	mWriter.flush();
+
+	Usage usage;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(cacheRootDir, ec)) {
+		if (!entry.is_regular_file(ec))
+			continue;
+		const uintmax_t size = entry.file_size(ec);
+		if (ec)
+			continue;
+		usage.mAssetCount++;
+		usage.mSize += size;
+	}
+	return usage;
+}
+
+AssetCache::Usage AssetCache::prune(const std::filesystem::path& cacheRootDir, uintmax_t budget,
+                                    const std::vector<std::filesystem::path>& protectedAssets) {
+	// no new assets are put meanwhile, the callbacks of the pending writes do not need the prune lock
+	std::lock_guard<std::shared_mutex> pruneLock(mPruneMutex);
+	mWriter.flush();
+	loadManifest(cacheRootDir);
+
+	std::unordered_set<std::wstring> protectedAssetKeys;
+	for (const std::filesystem::path& protectedAsset : protectedAssets)
+		protectedAssetKeys.insert(getAssetKey(protectedAsset));
+
+	struct Candidate {
+		std::filesystem::path assetPath;
+		uintmax_t size;
+		time_t lastAccess;
+	};
+	std::vector<Candidate> candidates;
+	uintmax_t totalSize = 0;
+
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(cacheRootDir, ec)) {
+		if (!entry.is_regular_file(ec))
+			continue;
+		const uintmax_t size = entry.file_size(ec);
+		if (ec)
+			continue;
+		totalSize += size;
+
+		const std::wstring assetKey = getAssetKey(entry.path());
+		if (protectedAssetKeys.count(assetKey) > 0)
+			continue;
+
+		const std::optional<time_t> lastAccess = getLastAccess(assetKey);
+		candidates.push_back(
+		        {entry.path(), size, lastAccess ? *lastAccess : prtu::getFileModificationTime(entry.path().wstring())});
 	}
 
-	if (it == mCache.end()) {
-		mCache.emplace(key, newAssetPath);
+	Usage removed;
+	if (totalSize <= budget)
+		return removed;
+
+	std::sort(candidates.begin(), candidates.end(),
+	          [](const Candidate& a, const Candidate& b) { return a.lastAccess < b.lastAccess; });
+
+	std::unordered_set<std::wstring> removedAssetKeys;
+	for (const Candidate& candidate : candidates) {
+		if (totalSize <= budget)
+			break;
+		if (!std::filesystem::remove(candidate.assetPath, ec) || ec)
+			continue;
+		totalSize -= candidate.size;
+		removed.mAssetCount++;
+		removed.mSize += candidate.size;
+		removedAssetKeys.insert(getAssetKey(candidate.assetPath));
 	}
-	else {
-		it->second = newAssetPath;
+
+	// the manifest records of the removed assets are dropped when the manifest is loaded again
+	removeEntries(removedAssetKeys);
+
+	if (totalSize > budget)
+		LOG_WRN << "The asset cache " << cacheRootDir << " exceeds its budget, all remaining assets are in use";
+
+	return removed;
+}
+
+std::filesystem::path AssetCache::createStagingDir(const std::filesystem::path cacheRootDir) {
+	const std::filesystem::path stagingRoot = cacheRootDir / STAGING_DIR;
+	std::error_code ec;
+	std::filesystem::create_directories(stagingRoot, ec);
+	if (ec) {
+		LOG_ERR << "Failed to create asset staging directory " << stagingRoot << ": " << ec.message();
+		return {};
+	}
+
+	// the timestamp avoids collisions with leftovers of previous sessions
+	const auto timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+	for (int attempt = 0; attempt < 16; attempt++) {
+		const std::wstring name = std::to_wstring(timestamp) + L"_" + std::to_wstring(mStagingDirCounter++);
+		const std::filesystem::path stagingDir = stagingRoot / name;
+		if (std::filesystem::create_directory(stagingDir, ec))
+			return stagingDir;
 	}
 
-	return newAssetPath;
+	LOG_ERR << "Failed to create asset staging directory in " << stagingRoot;
+	return {};
 }
 
 std::filesystem::path AssetCache::getCachedPath(const wchar_t* fileName, const std::filesystem::path cacheRootDir,
-                                                const size_t hash) const {
+                                                const uint64_t hash) const {
 	// we get the filename constructed by the encoder from the URI
 	assert(fileName != nullptr);
 	std::filesystem::path assetFile(fileName);
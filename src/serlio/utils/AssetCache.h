@@ -19,20 +19,209 @@
 
 #pragma once
 
+#include "utils/AssetWriter.h"
 #include "utils/Utilities.h"
 
+#include <array>
+#include <atomic>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+/**
+ * Thread-safe, assets may be put concurrently from PRT worker threads. The entries are distributed over independently
+ * locked shards. Concurrent puts of the same asset wait for the first one instead of hashing and writing it again.
+ * Assets with identical content are stored only once, additional uris and names resolve to the file of the first one.
+ * The cache entries of each cache root dir are persisted in a manifest next to it (see getManifestPath). The manifest
+ * is loaded at the first access to the cache root dir and appended to whenever an entry is added or an asset is
+ * accessed for the first time in a while, the access records allow to evict the least recently used assets.
+ */
 class AssetCache {
 public:
-	std::filesystem::path put(const wchar_t* uri, const wchar_t* fileName, const std::filesystem::path workspaceRoot,
-	                          const uint8_t* buffer, size_t size);
+	/**
+	 * Returns the final path of the asset right away, the file is written in the background (see flush).
+	 * @param textureProfile the texture profile the asset has been encoded with (see EO_TEXTURE_PROFILE), the variants
+	 * of different profiles are cached independently
+	 */
+	std::filesystem::path put(const wchar_t* uri, const wchar_t* fileName, const std::wstring& textureProfile,
+	                          const std::filesystem::path workspaceRoot, const uint8_t* buffer, size_t size);
+
+	/**
+	 * Moves an asset file, which has been written to a directory obtained from createStagingDir, to its cached path.
+	 * The staging dir is removed.
+	 * @param contentHash of the staged file, e.g. computed while writing it (see StagingOutputCallbacks), the file is
+	 * hashed in chunks if it is not given
+	 */
+	std::filesystem::path putFile(const wchar_t* uri, const wchar_t* fileName, const std::wstring& textureProfile,
+	                              const std::filesystem::path workspaceRoot, const std::filesystem::path& stagedFile,
+	                              std::optional<uint64_t> contentHash = {});
+
+	// blocks until all assets returned by put so far have been written, call before accessing the asset files
+	void flush();
+
+	// writes the pending assets and stops the writer thread, the next put starts it again
+	void stop();
+
+	/**
+	 * Creates a new empty directory within the cache root dir (on the same file system to allow atomic renames).
+	 * The staging dirs left behind by crashed sessions are removed when the cache root dir is loaded.
+	 */
+	std::filesystem::path createStagingDir(const std::filesystem::path workspaceRoot);
+
+	// e.g. <workspace>/assets/serlio_assets.manifest for the cache root dir <workspace>/assets/serlio_assets
+	static std::filesystem::path getManifestPath(const std::filesystem::path& cacheRootDir);
+
+	struct Usage {
+		size_t mAssetCount = 0;
+		uintmax_t mSize = 0; // bytes
+	};
+
+	// all asset files in the cache root dir, including the ones cached in previous sessions
+	Usage getUsage(const std::filesystem::path& cacheRootDir);
+
+	/**
+	 * Removes the least recently used assets until the asset files in the cache root dir fit into the budget (bytes).
+	 * Assets without access record (e.g. orphaned by older serlio versions) are ordered by their modification time.
+	 * @param protectedAssets are never removed, e.g. the textures referenced by the open scene
+	 * @return the removed assets
+	 */
+	Usage prune(const std::filesystem::path& cacheRootDir, uintmax_t budget,
+	            const std::vector<std::filesystem::path>& protectedAssets);
 
 private:
 	std::filesystem::path getCachedPath(const wchar_t* fileName, const std::filesystem::path workspaceRoot,
-	                                    const size_t hash) const;
+	                                    const uint64_t hash) const;
+
+	struct Key {
+		std::wstring mUri;
+		std::wstring mTextureProfile;
+		uint64_t mHash;
+
+		bool operator==(const Key& other) const {
+			return mHash == other.mHash && mUri == other.mUri && mTextureProfile == other.mTextureProfile;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const {
+			size_t seed = static_cast<size_t>(key.mHash);
+			prtu::hash_combine(seed, std::hash<std::wstring>{}(key.mUri));
+			prtu::hash_combine(seed, std::hash<std::wstring>{}(key.mTextureProfile));
+			return seed;
+		}
+	};
+
+	// assets from an rpk are identified by the rpk modification time, no need to hash their content again
+	struct FastPathKey {
+		std::wstring mUri;
+		std::wstring mTextureProfile;
+		std::filesystem::path mCacheRootDir;
+		size_t mSize;
+		time_t mRPKModificationTime;
+
+		bool operator==(const FastPathKey& other) const {
+			return mSize == other.mSize && mRPKModificationTime == other.mRPKModificationTime && mUri == other.mUri &&
+			       mTextureProfile == other.mTextureProfile && mCacheRootDir == other.mCacheRootDir;
+		}
+	};
+
+	struct FastPathKeyHash {
+		size_t operator()(const FastPathKey& key) const {
+			size_t seed = std::hash<std::wstring>{}(key.mUri);
+			prtu::hash_combine(seed, std::hash<std::wstring>{}(key.mTextureProfile));
+			prtu::hash_combine(seed, std::filesystem::hash_value(key.mCacheRootDir));
+			prtu::hash_combine(seed, key.mSize);
+			prtu::hash_combine(seed, static_cast<size_t>(key.mRPKModificationTime));
+			return seed;
+		}
+	};
+
+	// assets with the same content share one file, regardless of their uri and name
+	struct ContentKey {
+		std::filesystem::path mCacheRootDir;
+		uint64_t mHash;
+		uintmax_t mSize;
+		std::wstring mExtension;
+
+		bool operator==(const ContentKey& other) const {
+			return mHash == other.mHash && mSize == other.mSize && mExtension == other.mExtension &&
+			       mCacheRootDir == other.mCacheRootDir;
+		}
+	};
+
+	struct ContentKeyHash {
+		size_t operator()(const ContentKey& key) const {
+			size_t seed = static_cast<size_t>(key.mHash);
+			prtu::hash_combine(seed, static_cast<size_t>(key.mSize));
+			prtu::hash_combine(seed, std::hash<std::wstring>{}(key.mExtension));
+			prtu::hash_combine(seed, std::filesystem::hash_value(key.mCacheRootDir));
+			return seed;
+		}
+	};
+
+	std::optional<FastPathKey> getFastPathKey(const wchar_t* uri, const std::wstring& textureProfile,
+	                                          const std::filesystem::path& cacheRootDir, size_t size) const;
+
+	// the entries of an uri are kept in the same shard, the access times are sharded by asset path and the content
+	// paths by content hash
+	struct Shard {
+		std::mutex mMutex;
+		std::unordered_map<Key, std::filesystem::path, KeyHash> mCache;
+		std::unordered_map<FastPathKey, std::filesystem::path, FastPathKeyHash> mFastPathCache;
+		std::unordered_map<Key, std::shared_future<std::filesystem::path>, KeyHash> mInFlight;
+		std::unordered_map<FastPathKey, std::shared_future<std::filesystem::path>, FastPathKeyHash> mInFlightFastPath;
+		std::unordered_map<std::wstring, time_t> mLastAccess; // by normalized asset path
+		std::unordered_map<ContentKey, std::filesystem::path, ContentKeyHash> mContentPaths;
+		std::unordered_map<ContentKey, std::shared_future<std::filesystem::path>, ContentKeyHash> mInFlightContent;
+	};
+
+	// stores the asset file at the given path, returns false if this failed, calls onStored once the file is written
+	using StoreAssetFunc = std::function<bool(const std::filesystem::path&, AssetWriter::Callback onStored)>;
+
+	Shard& getShard(const std::wstring& key);
+	std::filesystem::path putFastPath(Shard& shard, const std::filesystem::path& cacheRootDir,
+	                                  const FastPathKey& fastPathKey,
+	                                  const std::function<std::filesystem::path()>& putContent);
+	std::filesystem::path putEntry(Shard& shard, const std::filesystem::path& cacheRootDir, const Key& key,
+	                               const std::optional<FastPathKey>& fastPathKey, const wchar_t* fileName,
+	                               uintmax_t size, const StoreAssetFunc& storeAsset);
+	std::filesystem::path claimContentPath(const ContentKey& contentKey, const std::filesystem::path& assetPath);
+	std::optional<std::filesystem::path> lookupFastPath(Shard& shard, const FastPathKey& fastPathKey);
+	void addEntry(Shard& shard, const Key& key, const std::optional<FastPathKey>& fastPathKey,
+	              const std::filesystem::path& assetPath);
+	void persistEntry(const std::filesystem::path& cacheRootDir, const Key& key,
+	                  const std::optional<FastPathKey>& fastPathKey, const std::filesystem::path& assetPath);
+	void persistEntryWhenWritten(const std::filesystem::path& cacheRootDir, const Key& key,
+	                             const std::optional<FastPathKey>& fastPathKey, const std::filesystem::path& assetPath);
+	void removeEntries(const std::unordered_set<std::wstring>& assetKeys);
+	bool isAvailable(const std::filesystem::path& assetPath);
+	bool markPending(const std::filesystem::path& assetPath);
+	void unmarkPending(const std::filesystem::path& assetPath, bool success);
+	void whenWritten(const std::filesystem::path& assetPath, AssetWriter::Callback onWritten);
+	void loadManifest(const std::filesystem::path& cacheRootDir);
+	void appendToManifest(const std::filesystem::path& cacheRootDir, const std::string& line);
+	void recordAccess(const std::filesystem::path& cacheRootDir, const std::filesystem::path& assetPath);
+	std::optional<time_t> getLastAccess(const std::wstring& assetKey);
+
+	// lock order: mPruneMutex, mManifestMutex, Shard::mMutex, mPendingWritesMutex (never hold two shard locks)
+	static constexpr size_t SHARD_COUNT = 16;
+	std::array<Shard, SHARD_COUNT> mShards;
+	std::shared_mutex mPruneMutex; // held shared while putting assets, prune must not remove them meanwhile
+	std::unordered_map<std::wstring, std::ofstream> mManifests; // opened for appending, by cache root dir
+	std::shared_mutex mManifestMutex;
+	// normalized paths of assets not written yet, with the callbacks waiting for them
+	std::unordered_map<std::wstring, std::vector<AssetWriter::Callback>> mPendingWrites;
+	std::mutex mPendingWritesMutex;
+	std::atomic<uint64_t> mStagingDirCounter{0};
 
-	std::unordered_map<std::pair<std::wstring, size_t>, std::filesystem::path, prtu::pair_hash> mCache;
+	// must be destroyed first, the pending writes call back into the cache
+	AssetWriter mWriter;
 };
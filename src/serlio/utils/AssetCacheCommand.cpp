@@ -0,0 +1,237 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/AssetCacheCommand.h"
+
+#include "materials/MaterialUtils.h"
+
+#include "modifiers/PRTModifierAction.h"
+
+#include "utils/MayaUtilities.h"
+
+#include "PRTContext.h"
+
+#include "maya/MArgDatabase.h"
+#include "maya/MGlobal.h"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace {
+
+constexpr const char* FLAG_BUDGET = "-b";
+constexpr const char* FLAG_BUDGET_LONG = "-budget";
+constexpr const char* FLAG_PRUNE = "-p";
+constexpr const char* FLAG_PRUNE_LONG = "-prune";
+constexpr const char* FLAG_REPORT = "-r";
+constexpr const char* FLAG_REPORT_LONG = "-report";
+constexpr const char* FLAG_RPK_BUDGET = "-rpb";
+constexpr const char* FLAG_RPK_BUDGET_LONG = "-rulePackageBudget";
+constexpr const char* FLAG_RPK_REPORT = "-rpr";
+constexpr const char* FLAG_RPK_REPORT_LONG = "-rulePackageReport";
+constexpr const char* FLAG_TEXTURE_THREADS = "-tet";
+constexpr const char* FLAG_TEXTURE_THREADS_LONG = "-textureEncodingThreads";
+
+const MString BUDGET_OPTION_VAR = "serlioAssetCacheBudget";
+constexpr int DEFAULT_BUDGET_MB = 4096;
+const MString RPK_BUDGET_OPTION_VAR = "serlioRulePackageCacheBudget";
+constexpr int DEFAULT_RPK_BUDGET_MB = 512;
+constexpr uintmax_t BYTES_PER_MB = 1024 * 1024;
+const MString TEXTURE_THREADS_OPTION_VAR = "serlioTextureEncodingThreads";
+constexpr int DEFAULT_TEXTURE_THREADS = 0; // one per hardware thread
+
+int getBudgetMB(const MString& optionVar, int defaultBudgetMB) {
+	bool exists = false;
+	const int budgetMB = MGlobal::optionVarIntValue(optionVar, &exists);
+	return exists ? budgetMB : defaultBudgetMB;
+}
+
+int getBudgetMB() {
+	return getBudgetMB(BUDGET_OPTION_VAR, DEFAULT_BUDGET_MB);
+}
+
+int getRulePackageBudgetMB() {
+	return getBudgetMB(RPK_BUDGET_OPTION_VAR, DEFAULT_RPK_BUDGET_MB);
+}
+
+MString getBudgetString(int budgetMB) {
+	if (budgetMB <= 0)
+		return "unlimited";
+	MString budget;
+	budget += budgetMB;
+	budget += " MB";
+	return budget;
+}
+
+double toMB(uintmax_t bytes) {
+	return static_cast<double>(bytes) / static_cast<double>(BYTES_PER_MB);
+}
+
+AssetCache::Usage prune(const std::filesystem::path& assetDir) {
+	const int budgetMB = getBudgetMB();
+	if (assetDir.empty() || budgetMB <= 0)
+		return {};
+
+	const uintmax_t budget = static_cast<uintmax_t>(budgetMB) * BYTES_PER_MB;
+	const AssetCache::Usage removed =
+	        PRTContext::get().mAssetCache.prune(assetDir, budget, MaterialUtils::getSceneTexturePaths());
+	if (removed.mAssetCount > 0)
+		LOG_INF << "Removed " << removed.mAssetCount << " assets (" << toMB(removed.mSize) << " MB) from the asset cache "
+		        << assetDir;
+	return removed;
+}
+
+} // namespace
+
+MSyntax AssetCacheCommand::newSyntax() {
+	MSyntax syntax;
+	syntax.addFlag(FLAG_BUDGET, FLAG_BUDGET_LONG, MSyntax::kLong);
+	syntax.addFlag(FLAG_PRUNE, FLAG_PRUNE_LONG);
+	syntax.addFlag(FLAG_REPORT, FLAG_REPORT_LONG);
+	syntax.addFlag(FLAG_RPK_BUDGET, FLAG_RPK_BUDGET_LONG, MSyntax::kLong);
+	syntax.addFlag(FLAG_RPK_REPORT, FLAG_RPK_REPORT_LONG);
+	syntax.addFlag(FLAG_TEXTURE_THREADS, FLAG_TEXTURE_THREADS_LONG, MSyntax::kLong);
+	return syntax;
+}
+
+bool AssetCacheCommand::isUndoable() const {
+	return false;
+}
+
+MStatus AssetCacheCommand::doIt(const MArgList& argList) {
+	MStatus status;
+	const MArgDatabase argData(syntax(), argList, &status);
+	if (status != MS::kSuccess)
+		return status;
+
+	// the resolve map cache only exists if PRT has been initialized
+	ResolveMapCache* resolveMapCache = PRTContext::get().mResolveMapCache.get();
+	if ((argData.isFlagSet(FLAG_RPK_BUDGET) || argData.isFlagSet(FLAG_RPK_REPORT)) && !resolveMapCache) {
+		displayError("The rule package cache is not available, PRT failed to initialize");
+		return MS::kFailure;
+	}
+
+	if (argData.isFlagSet(FLAG_BUDGET)) {
+		int budgetMB = 0;
+		status = argData.getFlagArgument(FLAG_BUDGET, 0, budgetMB);
+		if (status != MS::kSuccess)
+			return status;
+		if (budgetMB < 0) {
+			displayError("The asset cache budget must not be negative");
+			return MS::kInvalidParameter;
+		}
+		MGlobal::setOptionVarValue(BUDGET_OPTION_VAR, budgetMB);
+	}
+
+	if (argData.isFlagSet(FLAG_RPK_BUDGET)) {
+		int budgetMB = 0;
+		status = argData.getFlagArgument(FLAG_RPK_BUDGET, 0, budgetMB);
+		if (status != MS::kSuccess)
+			return status;
+		if (budgetMB < 0) {
+			displayError("The rule package cache budget must not be negative");
+			return MS::kInvalidParameter;
+		}
+		MGlobal::setOptionVarValue(RPK_BUDGET_OPTION_VAR, budgetMB);
+		resolveMapCache->setBudget(getRulePackageBudget());
+	}
+
+	if (argData.isFlagSet(FLAG_TEXTURE_THREADS)) {
+		int threadCount = 0;
+		status = argData.getFlagArgument(FLAG_TEXTURE_THREADS, 0, threadCount);
+		if (status != MS::kSuccess)
+			return status;
+		if (threadCount < 0) {
+			displayError("The texture encoding thread count must not be negative");
+			return MS::kInvalidParameter;
+		}
+		MGlobal::setOptionVarValue(TEXTURE_THREADS_OPTION_VAR, threadCount);
+		PRTModifierAction::setTextureEncodingThreads(getTextureEncodingThreads());
+	}
+
+	const std::filesystem::path assetDir = mu::findAssetDir();
+
+	if (argData.isFlagSet(FLAG_PRUNE)) {
+		const AssetCache::Usage removed = prune(assetDir);
+		setResult(static_cast<int>(removed.mAssetCount));
+	}
+
+	const bool reportRequested = argData.isFlagSet(FLAG_REPORT);
+	const bool otherFlagSet = argData.isFlagSet(FLAG_PRUNE) || argData.isFlagSet(FLAG_BUDGET) ||
+	                          argData.isFlagSet(FLAG_RPK_BUDGET) || argData.isFlagSet(FLAG_RPK_REPORT) ||
+	                          argData.isFlagSet(FLAG_TEXTURE_THREADS);
+	if (reportRequested || !otherFlagSet) {
+		const AssetCache::Usage usage =
+		        assetDir.empty() ? AssetCache::Usage{} : PRTContext::get().mAssetCache.getUsage(assetDir);
+		const int budgetMB = getBudgetMB();
+
+		MString info = "Serlio asset cache ";
+		info += MString(assetDir.wstring().c_str());
+		info += ": ";
+		info += static_cast<int>(usage.mAssetCount);
+		info += " assets, ";
+		info += toMB(usage.mSize);
+		info += " MB, budget ";
+		info += getBudgetString(budgetMB);
+		displayInfo(info);
+
+		clearResult();
+		appendToResult(static_cast<int>(usage.mAssetCount));
+		appendToResult(toMB(usage.mSize));
+		appendToResult(budgetMB);
+	}
+
+	if (argData.isFlagSet(FLAG_RPK_REPORT)) {
+		const ResolveMapCache::Usage usage = resolveMapCache->getUsage();
+		const int budgetMB = getRulePackageBudgetMB();
+
+		MString info = "Serlio rule package cache: ";
+		info += static_cast<int>(usage.mRulePackageCount);
+		info += " rule packages (";
+		info += static_cast<int>(usage.mInUseCount);
+		info += " in use), ";
+		info += toMB(usage.mSize);
+		info += " MB, budget ";
+		info += getBudgetString(budgetMB);
+		displayInfo(info);
+
+		clearResult();
+		appendToResult(static_cast<int>(usage.mRulePackageCount));
+		appendToResult(static_cast<int>(usage.mInUseCount));
+		appendToResult(toMB(usage.mSize));
+		appendToResult(budgetMB);
+	}
+
+	return MS::kSuccess;
+}
+
+void AssetCacheCommand::pruneToBudget() {
+	prune(mu::findAssetDir());
+}
+
+int32_t AssetCacheCommand::getTextureEncodingThreads() {
+	bool exists = false;
+	const int threadCount = MGlobal::optionVarIntValue(TEXTURE_THREADS_OPTION_VAR, &exists);
+	return exists ? std::max(threadCount, 0) : DEFAULT_TEXTURE_THREADS;
+}
+
+uintmax_t AssetCacheCommand::getRulePackageBudget() {
+	const int budgetMB = getRulePackageBudgetMB();
+	return budgetMB > 0 ? static_cast<uintmax_t>(budgetMB) * BYTES_PER_MB : 0;
+}
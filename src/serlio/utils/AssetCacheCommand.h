@@ -0,0 +1,58 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "maya/MPxCommand.h"
+#include "maya/MSyntax.h"
+
+#include <cstdint>
+
+/**
+ * serlioCache [-report] [-prune] [-budget <MB>] [-rulePackageReport] [-rulePackageBudget <MB>]
+ *             [-textureEncodingThreads <count>]
+ *   -budget (-b): sets the size budget of the asset cache in MB (0: unlimited), it is kept across sessions
+ *   -prune (-p):  removes the least recently used assets of the current workspace until the budget is met, the textures
+ *                 referenced by the open scene are kept, returns the number of removed assets
+ *   -report (-r): returns the asset count, the size (MB) and the budget (MB) of the asset cache (default)
+ *   -rulePackageBudget (-rpb): sets the budget of the cached rule packages in MB (0: unlimited), it is kept across
+ *                              sessions, the rule packages used by nodes are never evicted, the compiled rules and
+ *                              assets of evicted ones are released from the PRT cache (measured by the rpk sizes)
+ *   -rulePackageReport (-rpr): returns the count of cached rule packages, how many of them are in use, their size (MB)
+ *                              and the budget (MB)
+ *   -textureEncodingThreads (-tet): sets the maximum number of threads re-encoding the textures of a generate
+ *                                   (0: one per hardware thread), it is kept across sessions
+ * The asset cache is also pruned whenever a scene is opened or created.
+ */
+class AssetCacheCommand : public MPxCommand {
+public:
+	static MSyntax newSyntax();
+
+	bool isUndoable() const override;
+	MStatus doIt(const MArgList& argList) override;
+
+	// prunes the asset cache of the current workspace, does nothing if the workspace has no asset cache yet
+	static void pruneToBudget();
+
+	// the budget of the resolve map cache kept across sessions in bytes (0: unlimited)
+	static uintmax_t getRulePackageBudget();
+
+	// the texture encoding thread count kept across sessions (0: one per hardware thread), call on the main thread
+	static int32_t getTextureEncodingThreads();
+};
@@ -0,0 +1,129 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/AssetWriter.h"
+
+#include "utils/LogHandler.h"
+
+#include <fstream>
+
+namespace {
+
+bool writeFile(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+	std::filesystem::path tmpPath = path;
+	tmpPath += L".tmp";
+	{
+		std::ofstream stream(tmpPath, std::ofstream::binary | std::ofstream::trunc);
+		if (!stream)
+			return false;
+		stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!stream) {
+			stream.close();
+			std::error_code ec;
+			std::filesystem::remove(tmpPath, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) {
+		LOG_ERR << "Failed to move " << tmpPath << " to " << path << ": " << ec.message();
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+AssetWriter::AssetWriter(size_t maxPendingBytes) : mMaxPendingBytes(maxPendingBytes) {}
+
+AssetWriter::~AssetWriter() {
+	stop();
+}
+
+void AssetWriter::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mRunning || mStopping)
+			return;
+		mStopping = true;
+	}
+	mJobAvailable.notify_all();
+
+	// the thread is only replaced by write(), which waits while stopping
+	mThread.join();
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRunning = false;
+		mStopping = false;
+	}
+	mJobDone.notify_all();
+}
+
+void AssetWriter::write(const std::filesystem::path& path, const uint8_t* buffer, size_t size, Callback onWritten) {
+	Job job{path, std::vector<uint8_t>(buffer, buffer + size), std::move(onWritten)};
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	// a single job larger than the limit must not block forever, a stopping writer is started again afterwards
+	mJobDone.wait(lock, [this, size]() {
+		return !mStopping && (mPendingBytes == 0 || mPendingBytes + size <= mMaxPendingBytes);
+	});
+
+	mPendingBytes += size;
+	mJobs.emplace_back(std::move(job));
+	if (!mRunning) {
+		mRunning = true;
+		mThread = std::thread(&AssetWriter::run, this);
+	}
+	lock.unlock();
+	mJobAvailable.notify_one();
+}
+
+void AssetWriter::flush() {
+	std::unique_lock<std::mutex> lock(mMutex);
+	mJobDone.wait(lock, [this]() { return mJobs.empty() && mActiveJobs == 0; });
+}
+
+void AssetWriter::run() {
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true) {
+		mJobAvailable.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+		if (mJobs.empty())
+			return; // stopping and all pending files have been written
+
+		Job job = std::move(mJobs.front());
+		mJobs.pop_front();
+		mActiveJobs++;
+		lock.unlock();
+
+		const bool success = writeFile(job.mPath, job.mData);
+		if (!success)
+			LOG_ERR << "Failed to write asset " << job.mPath;
+		if (job.mOnWritten)
+			job.mOnWritten(success);
+
+		lock.lock();
+		mActiveJobs--;
+		mPendingBytes -= job.mData.size();
+		mJobDone.notify_all();
+	}
+}
@@ -0,0 +1,78 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes asset files on a background thread, so that generating does not wait for the disk. Each file is written to a
+ * temporary file first and then renamed, i.e. a file either is complete or does not exist.
+ */
+class AssetWriter {
+public:
+	using Callback = std::function<void(bool success)>;
+
+	static constexpr size_t DEFAULT_MAX_PENDING_BYTES = 256 * 1024 * 1024;
+
+	explicit AssetWriter(size_t maxPendingBytes = DEFAULT_MAX_PENDING_BYTES);
+	AssetWriter(const AssetWriter&) = delete;
+	AssetWriter& operator=(const AssetWriter&) = delete;
+	~AssetWriter(); // writes all pending files
+
+	/**
+	 * Copies the buffer and returns immediately, unless the pending files exceed maxPendingBytes. onWritten is called on
+	 * the writer thread once the file is in place (or failed to be written).
+	 */
+	void write(const std::filesystem::path& path, const uint8_t* buffer, size_t size, Callback onWritten);
+
+	// blocks until all files passed to write() so far are in place
+	void flush();
+
+	// writes all pending files and stops the writer thread, the next write() starts it again
+	void stop();
+
+private:
+	struct Job {
+		std::filesystem::path mPath;
+		std::vector<uint8_t> mData;
+		Callback mOnWritten;
+	};
+
+	void run();
+
+	const size_t mMaxPendingBytes;
+
+	std::mutex mMutex;
+	std::condition_variable mJobAvailable;
+	std::condition_variable mJobDone;
+	std::deque<Job> mJobs;
+	size_t mPendingBytes = 0; // including the job being written
+	size_t mActiveJobs = 0;
+	bool mRunning = false;
+	bool mStopping = false;
+	std::thread mThread; // started with the first job
+};
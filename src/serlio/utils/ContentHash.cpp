@@ -0,0 +1,166 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/ContentHash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+constexpr size_t HASH_CHUNK_SIZE = 1 << 16;
+
+inline uint64_t rotl(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+// all supported platforms are little endian
+inline uint64_t read64(const uint8_t* p) {
+	uint64_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint32_t read32(const uint8_t* p) {
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+	acc += input * PRIME2;
+	acc = rotl(acc, 31);
+	return acc * PRIME1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+	acc ^= round(0, val);
+	return acc * PRIME1 + PRIME4;
+}
+
+} // namespace
+
+ContentHash::ContentHash(uint64_t seed)
+    : mSeed(seed), mAccumulators{seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1} {}
+
+void ContentHash::consumeStripe(const uint8_t* stripe) {
+	for (size_t i = 0; i < mAccumulators.size(); i++)
+		mAccumulators[i] = round(mAccumulators[i], read64(stripe + 8 * i));
+}
+
+void ContentHash::update(const void* data, size_t size) {
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	const uint8_t* const end = p + size;
+	mTotalSize += size;
+
+	if (mBufferSize + size < STRIPE_SIZE) {
+		std::copy(p, end, mBuffer.begin() + mBufferSize);
+		mBufferSize += size;
+		return;
+	}
+
+	if (mBufferSize > 0) {
+		const size_t fill = STRIPE_SIZE - mBufferSize;
+		std::copy(p, p + fill, mBuffer.begin() + mBufferSize);
+		consumeStripe(mBuffer.data());
+		p += fill;
+		mBufferSize = 0;
+	}
+
+	while (static_cast<size_t>(end - p) >= STRIPE_SIZE) {
+		consumeStripe(p);
+		p += STRIPE_SIZE;
+	}
+
+	std::copy(p, end, mBuffer.begin());
+	mBufferSize = static_cast<size_t>(end - p);
+}
+
+uint64_t ContentHash::digest() const {
+	uint64_t h;
+	if (mTotalSize >= STRIPE_SIZE) {
+		const auto& v = mAccumulators;
+		h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+		for (const uint64_t acc : v)
+			h = mergeRound(h, acc);
+	}
+	else {
+		h = mSeed + PRIME5;
+	}
+	h += mTotalSize;
+
+	const uint8_t* p = mBuffer.data();
+	size_t remaining = mBufferSize;
+	while (remaining >= 8) {
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * PRIME1 + PRIME4;
+		p += 8;
+		remaining -= 8;
+	}
+	if (remaining >= 4) {
+		h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+		h = rotl(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+		remaining -= 4;
+	}
+	while (remaining > 0) {
+		h ^= static_cast<uint64_t>(*p) * PRIME5;
+		h = rotl(h, 11) * PRIME1;
+		p++;
+		remaining--;
+	}
+
+	// avalanche
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t ContentHash::hash(const void* data, size_t size, uint64_t seed) {
+	ContentHash contentHash(seed);
+	contentHash.update(data, size);
+	return contentHash.digest();
+}
+
+std::optional<uint64_t> ContentHash::hashFile(const std::filesystem::path& path) {
+	std::ifstream stream(path, std::ifstream::binary);
+	if (!stream)
+		return {};
+
+	ContentHash contentHash;
+	std::vector<char> chunk(HASH_CHUNK_SIZE);
+	while (stream) {
+		stream.read(chunk.data(), chunk.size());
+		contentHash.update(chunk.data(), static_cast<size_t>(stream.gcount()));
+	}
+	if (stream.bad())
+		return {};
+	return contentHash.digest();
+}
@@ -0,0 +1,56 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "serlioPlugin.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+/**
+ * Streaming 64bit content hash (XXH64, see https://github.com/Cyan4973/xxHash), used to identify asset content.
+ * Feeding the data in several update() calls yields the same digest as hashing it at once.
+ */
+class SRL_TEST_EXPORTS_API ContentHash {
+public:
+	explicit ContentHash(uint64_t seed = 0);
+
+	void update(const void* data, size_t size);
+	uint64_t digest() const;
+
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = 0);
+
+	// hashes the file content in chunks, does not load the whole file into memory
+	static std::optional<uint64_t> hashFile(const std::filesystem::path& path);
+
+private:
+	static constexpr size_t STRIPE_SIZE = 32;
+
+	void consumeStripe(const uint8_t* stripe);
+
+	uint64_t mSeed;
+	std::array<uint64_t, 4> mAccumulators;
+	std::array<uint8_t, STRIPE_SIZE> mBuffer;
+	size_t mBufferSize = 0;
+	uint64_t mTotalSize = 0;
+};
@@ -0,0 +1,258 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "utils/FileWatcher.h"
+
+#include "utils/LogHandler.h"
+
+#ifdef __linux__
+#	include <cerrno>
+#	include <poll.h>
+#	include <sys/eventfd.h>
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr bool DBG = false;
+
+std::wstring getFileKey(const std::filesystem::path& file) {
+	return file.lexically_normal().make_preferred().wstring();
+}
+
+#ifdef __linux__
+// tools either write the file in place or rename a new one over it
+constexpr uint32_t NOTIFY_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+constexpr size_t NOTIFY_BUFFER_SIZE = 16 * 1024;
+#endif
+
+} // namespace
+
+FileWatcher::FileWatcher(Listener listener) : mListener(std::move(listener)) {}
+
+FileWatcher::~FileWatcher() {
+	stop();
+}
+
+void FileWatcher::watch(const std::filesystem::path& file) {
+	const std::wstring fileKey = getFileKey(file);
+	const FileState state = getFileState(file);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	const auto [it, inserted] = mFiles.try_emplace(fileKey, WatchedFile{file, state});
+
+	// start() watches all files, while stopping they are only watched again after the next start
+	if (!mRunning) {
+		if (!mStopping)
+			start();
+		return;
+	}
+
+	if (!inserted)
+		return;
+
+#ifdef __linux__
+	addNotifyWatch(file);
+#endif
+
+	if constexpr (DBG)
+		LOG_DBG << "watching " << file;
+}
+
+void FileWatcher::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mRunning || mStopping)
+			return;
+		mStopping = true;
+	}
+	mStopRequested.notify_all();
+
+	// the thread and the file descriptors are only replaced by start(), which is not called while stopping
+#ifdef __linux__
+	if (mStopFd >= 0) {
+		const uint64_t value = 1;
+		[[maybe_unused]] const ssize_t written = ::write(mStopFd, &value, sizeof(value));
+	}
+#endif
+
+	mThread.join();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+#ifdef __linux__
+	if (mNotifyFd >= 0)
+		::close(mNotifyFd);
+	if (mStopFd >= 0)
+		::close(mStopFd);
+	mNotifyFd = -1;
+	mStopFd = -1;
+	mWatchedDirs.clear();
+#endif
+	mRunning = false;
+	mStopping = false;
+}
+
+FileWatcher::FileState FileWatcher::getFileState(const std::filesystem::path& file) {
+	FileState state;
+	std::error_code ec;
+	state.mSize = std::filesystem::file_size(file, ec);
+	if (ec)
+		return {};
+	state.mModificationTime = std::filesystem::last_write_time(file, ec);
+	if (ec)
+		return {};
+	state.mExists = true;
+	return state;
+}
+
+// must be called with locked mMutex
+void FileWatcher::start() {
+#ifdef __linux__
+	mNotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	mStopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (mNotifyFd < 0 || mStopFd < 0) {
+		LOG_WRN << "Failed to initialize inotify, polling watched files instead: " << std::strerror(errno);
+		if (mNotifyFd >= 0)
+			::close(mNotifyFd);
+		mNotifyFd = -1;
+	}
+	for (const auto& entry : mFiles)
+		addNotifyWatch(entry.second.mPath);
+#endif
+	mRunning = true;
+	mThread = std::thread(&FileWatcher::run, this);
+}
+
+void FileWatcher::run() {
+#ifdef __linux__
+	if (mNotifyFd >= 0) {
+		runNotify();
+		return;
+	}
+#endif
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (!mStopRequested.wait_for(lock, POLL_INTERVAL, [this]() { return mStopping; })) {
+		lock.unlock();
+		poll();
+		lock.lock();
+	}
+}
+
+void FileWatcher::poll() {
+	std::vector<WatchedFile> files;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		files.reserve(mFiles.size());
+		for (const auto& entry : mFiles)
+			files.push_back(entry.second);
+	}
+
+	std::vector<std::filesystem::path> changedFiles;
+	for (const WatchedFile& file : files) {
+		const FileState state = getFileState(file.mPath);
+		if (state == file.mState)
+			continue;
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		const auto it = mFiles.find(getFileKey(file.mPath));
+		if (it != mFiles.end())
+			it->second.mState = state;
+		changedFiles.push_back(file.mPath);
+	}
+
+	for (const std::filesystem::path& file : changedFiles)
+		mListener(file);
+}
+
+#ifdef __linux__
+// must be called with locked mMutex
+void FileWatcher::addNotifyWatch(const std::filesystem::path& file) {
+	if (mNotifyFd < 0)
+		return;
+
+	const std::filesystem::path dir = file.parent_path().empty() ? "." : file.parent_path();
+	const int wd = ::inotify_add_watch(mNotifyFd, dir.c_str(), NOTIFY_EVENTS);
+	if (wd < 0)
+		LOG_WRN << "Failed to watch " << dir << " for changes of " << file << ": " << std::strerror(errno);
+	else
+		mWatchedDirs[wd] = dir;
+}
+
+void FileWatcher::runNotify() {
+	alignas(inotify_event) char buffer[NOTIFY_BUFFER_SIZE];
+
+	while (true) {
+		pollfd fds[2] = {{mNotifyFd, POLLIN, 0}, {mStopFd, POLLIN, 0}};
+		if (::poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			LOG_ERR << "Failed to wait for file changes, stopped watching files: " << std::strerror(errno);
+			return;
+		}
+		if (fds[1].revents != 0)
+			return;
+
+		const ssize_t length = ::read(mNotifyFd, buffer, sizeof(buffer));
+		if (length <= 0)
+			continue;
+
+		// a batch usually contains several events per file, report each file once
+		std::vector<std::filesystem::path> changedFiles;
+		auto addChangedFile = [&changedFiles](const std::filesystem::path& file) {
+			if (std::find(changedFiles.begin(), changedFiles.end(), file) == changedFiles.end())
+				changedFiles.push_back(file);
+		};
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			for (const char* p = buffer; p < buffer + length;) {
+				const auto* event = reinterpret_cast<const inotify_event*>(p);
+				p += sizeof(inotify_event) + event->len;
+
+				// events have been lost, assume all files changed
+				if ((event->mask & IN_Q_OVERFLOW) != 0) {
+					for (const auto& entry : mFiles)
+						addChangedFile(entry.second.mPath);
+					continue;
+				}
+
+				const auto dirIt = mWatchedDirs.find(event->wd);
+				if (event->len == 0 || dirIt == mWatchedDirs.end())
+					continue;
+
+				const auto fileIt = mFiles.find(getFileKey(dirIt->second / event->name));
+				if (fileIt != mFiles.end())
+					addChangedFile(fileIt->second.mPath);
+			}
+		}
+
+		for (const std::filesystem::path& file : changedFiles) {
+			if constexpr (DBG)
+				LOG_DBG << "detected change of " << file;
+			mListener(file);
+		}
+	}
+}
+#endif
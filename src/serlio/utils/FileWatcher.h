@@ -0,0 +1,97 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "serlioPlugin.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Watches files on a background thread and reports modifications, replacements and removals to the listener.
+ * Uses inotify on the parent directories on Linux (tools usually replace a file by renaming a new one over it), the
+ * other platforms poll the size and modification time of the watched files every POLL_INTERVAL.
+ */
+class SRL_TEST_EXPORTS_API FileWatcher {
+public:
+	// called on the watcher thread with the path as passed to watch()
+	using Listener = std::function<void(const std::filesystem::path& file)>;
+
+	static constexpr std::chrono::milliseconds POLL_INTERVAL{1000};
+
+	explicit FileWatcher(Listener listener);
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+	~FileWatcher();
+
+	// watching a file again is a no-op, the watcher thread is started with the first file
+	void watch(const std::filesystem::path& file);
+
+	// stops the watcher thread, the next watch() starts it again (for all files)
+	void stop();
+
+private:
+	struct FileState {
+		bool mExists = false;
+		uintmax_t mSize = 0;
+		std::filesystem::file_time_type mModificationTime;
+
+		bool operator==(const FileState& other) const {
+			return mExists == other.mExists && mSize == other.mSize && mModificationTime == other.mModificationTime;
+		}
+	};
+
+	struct WatchedFile {
+		std::filesystem::path mPath;
+		FileState mState; // only used for polling
+	};
+
+	static FileState getFileState(const std::filesystem::path& file);
+
+	void start();
+	void run();
+	void poll();
+
+	const Listener mListener;
+
+	std::mutex mMutex;
+	std::condition_variable mStopRequested;
+	std::unordered_map<std::wstring, WatchedFile> mFiles; // by normalized path
+	bool mRunning = false;
+	bool mStopping = false;
+
+#ifdef __linux__
+	void addNotifyWatch(const std::filesystem::path& file);
+	void runNotify();
+
+	int mNotifyFd = -1; // -1 if inotify is not available, falls back to polling
+	int mStopFd = -1;
+	std::unordered_map<int, std::filesystem::path> mWatchedDirs; // by inotify watch descriptor
+#endif
+
+	std::thread mThread;
+};
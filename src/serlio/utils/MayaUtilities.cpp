@@ -27,65 +27,108 @@
 #include "maya/MStringResourceId.h"
 #include "maya/MUuid.h"
 
+#include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 
 namespace {
-constexpr const wchar_t KEY_URL_SEPARATOR = L'=';
+constexpr const wchar_t* MAYA_ASSET_FOLDER = L"assets";
+constexpr const wchar_t* SERLIO_ASSET_FOLDER = L"serlio_assets";
+
+// resolved once per workspace/scene, see mu::invalidateAssetDir()
+std::mutex assetDirMutex;
+std::optional<std::filesystem::path> cachedAssetDir;
+
+constexpr const char* KEY_URL_SEPARATOR = "=";
 const MString INDIRECTION_URL = L"https://raw.githubusercontent.com/Esri/serlio/data/urls.json";
 const MString SERLIO_HOME_KEY = "SERLIO_HOME";
 const MString CGA_REFERENCE_KEY = "CGA_REFERENCE";
 const MString RPK_MANUAL_KEY = "RPK_MANUAL";
 
+// the urls downloaded by a previous session, they are only used from the next session on (one key=url pair per line)
+constexpr const char* URL_CACHE_FILE = "serlio_urls_" SRL_VERSION_MAJOR "." SRL_VERSION_MINOR ".txt";
+constexpr int URL_CACHE_MAX_AGE_HOURS = 24;
+constexpr int URL_DOWNLOAD_TIMEOUT_SECONDS = 10;
+
 const std::map<std::string, std::string> fallbackKeyToUrlMap = {
         {SERLIO_HOME_KEY.asChar(), "https://esri.github.io/cityengine/serlio"},
         {CGA_REFERENCE_KEY.asChar(), "https://doc.arcgis.com/en/cityengine/latest/cga/cityengine-cga-introduction.htm"},
         {RPK_MANUAL_KEY.asChar(), "https://doc.arcgis.com/en/cityengine/latest/help/help-rule-package.htm"}};
 
-std::map<std::string, std::string> getKeyToUrlMap() {
-	MString pyCmd1;
-	pyCmd1 += "def getIndirectionStrings():\n";
-	pyCmd1 += " from six.moves import urllib\n";
-	pyCmd1 += " import json\n";
-	// Download indirection links
-	pyCmd1 += " url = \"" + INDIRECTION_URL + "\"\n";
-	pyCmd1 += " try:\n";
-	pyCmd1 += "  response = urllib.request.urlopen(url, timeout=3)\n";
-	pyCmd1 += "  jsonString = response.read()\n";
-	// Parse json into array
-	pyCmd1 += "  jsonObject = json.loads(jsonString)\n";
-	pyCmd1 += "  serlioHomeKey = \"" + SERLIO_HOME_KEY + "\"\n";
-	pyCmd1 += "  cgaReferenceKey = \"" + CGA_REFERENCE_KEY + "\"\n";
-	pyCmd1 += "  rpkManualKey = \"" + RPK_MANUAL_KEY + "\"\n";
-	pyCmd1 += "  serlioVersionKey = \"" SRL_VERSION_MAJOR "." SRL_VERSION_MINOR "\"\n";
-	pyCmd1 += "  serlioHome = jsonObject[serlioVersionKey][serlioHomeKey]\n";
-	pyCmd1 += "  cgaReference = jsonObject[serlioVersionKey][cgaReferenceKey]\n";
-	pyCmd1 += "  rpkManual = jsonObject[serlioVersionKey][rpkManualKey]\n";
-	pyCmd1 += "  return [serlioHomeKey, serlioHome, cgaReferenceKey, cgaReference, rpkManualKey, rpkManual]\n";
-	pyCmd1 += " except:\n";
-	pyCmd1 += "  return []";
-
-	MStatus status = MGlobal::executePythonCommand(pyCmd1);
-	if (status != MStatus::kSuccess)
+std::filesystem::path getUrlCacheFile() {
+	MString userAppDir;
+	const MStatus status = MGlobal::executeCommand("internalVar -userAppDir", userAppDir);
+	if ((status != MStatus::kSuccess) || userAppDir.length() == 0)
 		return {};
+	return std::filesystem::path(userAppDir.asWChar()) / URL_CACHE_FILE;
+}
 
-	MString pyCmd2 = "getIndirectionStrings()";
-	MStringArray result;
-	status = MGlobal::executePythonCommand(pyCmd2, result);
-	if ((status != MStatus::kSuccess) || result.length() < 6)
+std::map<std::string, std::string> readUrlCache(const std::filesystem::path& cacheFile) {
+	std::ifstream stream(cacheFile);
+	if (!stream)
 		return {};
 
 	std::map<std::string, std::string> keyToUrlMap;
-	for (uint32_t i = 0; i + 1 < result.length(); i += 2) {
-		const std::string key = result[i].asChar();
-		const std::string value = result[i + 1].asChar();
-		keyToUrlMap[key] = value;
+	std::string line;
+	while (std::getline(stream, line)) {
+		const size_t separator = line.find(KEY_URL_SEPARATOR);
+		if (separator == std::string::npos || separator == 0 || separator + 1 == line.size())
+			continue;
+		keyToUrlMap[line.substr(0, separator)] = line.substr(separator + 1);
 	}
-
 	return keyToUrlMap;
 }
 
+// downloads the indirection links on a python thread and writes them to the cache file, nothing waits for it
+void refreshUrlCacheAsync(const std::filesystem::path& cacheFile) {
+	MString pyCmd1;
+	pyCmd1 += "def serlioRefreshUrlCache(url, versionKey, keys, cacheFile, maxAgeSeconds, timeoutSeconds):\n";
+	pyCmd1 += " import os, threading, time\n";
+	pyCmd1 += " if os.path.exists(cacheFile) and time.time() - os.path.getmtime(cacheFile) < maxAgeSeconds:\n";
+	pyCmd1 += "  return\n";
+	pyCmd1 += " def refresh():\n";
+	pyCmd1 += "  try:\n";
+	pyCmd1 += "   from six.moves import urllib\n";
+	pyCmd1 += "   import json\n";
+	pyCmd1 += "   response = urllib.request.urlopen(url, timeout=timeoutSeconds)\n";
+	pyCmd1 += "   jsonObject = json.loads(response.read())[versionKey]\n";
+	pyCmd1 += "   lines = [key + \"";
+	pyCmd1 += KEY_URL_SEPARATOR;
+	pyCmd1 += "\" + jsonObject[key] + \"\\n\" for key in keys]\n";
+	// write the complete file at once, a concurrent session must not read a partial file
+	pyCmd1 += "   tmpFile = cacheFile + \".tmp\"\n";
+	pyCmd1 += "   with open(tmpFile, \"w\") as f:\n";
+	pyCmd1 += "    f.write(\"\".join(lines))\n";
+	// readers see either the old or the new cache file, python 2 has no os.replace but renames atomically on posix
+	pyCmd1 += "   if hasattr(os, \"replace\"):\n";
+	pyCmd1 += "    os.replace(tmpFile, cacheFile)\n";
+	pyCmd1 += "   else:\n";
+	pyCmd1 += "    if os.name == \"nt\" and os.path.exists(cacheFile):\n";
+	pyCmd1 += "     os.remove(cacheFile)\n";
+	pyCmd1 += "    os.rename(tmpFile, cacheFile)\n";
+	pyCmd1 += "  except:\n";
+	pyCmd1 += "   pass\n";
+	pyCmd1 += " thread = threading.Thread(target=refresh)\n";
+	pyCmd1 += " thread.daemon = True\n";
+	pyCmd1 += " thread.start()";
+
+	MStatus status = MGlobal::executePythonCommand(pyCmd1);
+	if (status != MStatus::kSuccess)
+		return;
+
+	MString pyCmd2 = "serlioRefreshUrlCache(\"" + INDIRECTION_URL + "\", ";
+	pyCmd2 += "\"" SRL_VERSION_MAJOR "." SRL_VERSION_MINOR "\", ";
+	pyCmd2 += "[\"" + SERLIO_HOME_KEY + "\", \"" + CGA_REFERENCE_KEY + "\", \"" + RPK_MANUAL_KEY + "\"], ";
+	pyCmd2 += "u\"" + MString(cacheFile.generic_wstring().c_str()) + "\", ";
+	pyCmd2 += URL_CACHE_MAX_AGE_HOURS * 3600;
+	pyCmd2 += ", ";
+	pyCmd2 += URL_DOWNLOAD_TIMEOUT_SECONDS;
+	pyCmd2 += ")";
+	MCHECK(MGlobal::executePythonCommand(pyCmd2));
+}
+
 MObject findNamedObject(const MString& name, MFn::Type fnType) {
 	MStatus status;
 	MItDependencyNodes nodeIt(fnType, &status);
@@ -143,8 +186,53 @@ std::filesystem::path getWorkspaceRoot(MStatus& status) {
 	}
 }
 
+std::filesystem::path getAssetDir() {
+	std::lock_guard<std::mutex> lock(assetDirMutex);
+	if (cachedAssetDir)
+		return *cachedAssetDir;
+
+	MStatus status;
+	const std::filesystem::path workspaceRoot = getWorkspaceRoot(status);
+
+	if (status != MS::kSuccess)
+		return {};
+
+	std::filesystem::path assetDir = workspaceRoot / MAYA_ASSET_FOLDER / SERLIO_ASSET_FOLDER;
+	// create dir if it does not exist
+	try {
+		std::filesystem::create_directories(assetDir);
+	}
+	catch (std::exception& e) {
+		LOG_ERR << "Error while creating the asset cache directory at " << assetDir << ": " << e.what();
+		return {};
+	}
+
+	cachedAssetDir = assetDir;
+	return assetDir;
+}
+
+std::filesystem::path findAssetDir() {
+	MStatus status;
+	const std::filesystem::path workspaceRoot = getWorkspaceRoot(status);
+	if (status != MS::kSuccess)
+		return {};
+
+	const std::filesystem::path assetDir = workspaceRoot / MAYA_ASSET_FOLDER / SERLIO_ASSET_FOLDER;
+	std::error_code ec;
+	if (!std::filesystem::is_directory(assetDir, ec))
+		return {};
+	return assetDir;
+}
+
+void invalidateAssetDir() {
+	std::lock_guard<std::mutex> lock(assetDirMutex);
+	cachedAssetDir.reset();
+}
+
 MStatus registerMStringResources() {
-	std::map<std::string, std::string> keyToUrlMap = getKeyToUrlMap();
+	// never wait for the network here, this is called while Maya loads serlio (also for batch renders)
+	const std::filesystem::path urlCacheFile = getUrlCacheFile();
+	const std::map<std::string, std::string> keyToUrlMap = readUrlCache(urlCacheFile);
 
 	for (const auto& [key, url] : fallbackKeyToUrlMap) {
 		auto it = keyToUrlMap.find(key);
@@ -158,6 +246,10 @@ MStatus registerMStringResources() {
 		}
 	}
 
+	// the links are only shown in the UI, there is no need to download them in batch mode
+	if (!urlCacheFile.empty() && MGlobal::mayaState() == MGlobal::kInteractive)
+		refreshUrlCacheAsync(urlCacheFile);
+
 	return MS::kSuccess;
 }
 
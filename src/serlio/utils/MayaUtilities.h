@@ -71,6 +71,15 @@ private:
 
 std::filesystem::path getWorkspaceRoot(MStatus& status);
 
+// returns the (cached) serlio asset directory inside the current workspace, creates it if necessary
+std::filesystem::path getAssetDir();
+
+// returns the serlio asset directory of the current workspace if it already exists, does not create it
+std::filesystem::path findAssetDir();
+
+// forces getAssetDir() to query the workspace again, e.g. after the workspace or scene has changed
+void invalidateAssetDir();
+
 MStatus registerMStringResources();
 
 MStatus setEnumOptions(const MObject& node, MFnEnumAttribute& enumAttr, const std::vector<std::wstring>& enumOptions,
@@ -17,11 +17,20 @@
  * limitations under the License.
  */
 
+
+#include "utils/ContentHash.h"
 #include "utils/LogHandler.h"
 #include "utils/ResolveMapCache.h"
 #include "utils/Utilities.h"
 
-#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cwchar>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 
 namespace {
 
@@ -29,54 +38,622 @@ constexpr bool DBG = false;
 
 const ResolveMapSPtr RESOLVE_MAP_NONE;
 const ResolveMapCache::LookupResult LOOKUP_FAILURE = {RESOLVE_MAP_NONE, ResolveMapCache::CacheStatus::MISS};
-std::mutex resolveMapCacheMutex;
+
+std::chrono::steady_clock::rep now() {
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+const std::wstring MIRROR_INDEX_FILE = L"serlio_rpk_index";
+const std::string MIRROR_INDEX_HEADER = "serlio_rpk_index\t2";
+const std::string MIRROR_RELATIVE_PREFIX = "./"; // the entries are relative to the mirror dir, it is renamed
+const std::wstring MIRROR_EXTRACTION_SUFFIX = L".tmp_";
+
+std::wstring getMirrorDirName(uint64_t hash, uintmax_t size) {
+	std::wostringstream name;
+	name << std::hex << std::setw(16) << std::setfill(L'0') << hash << L'_' << std::dec << size;
+	return name.str();
+}
+
+// the compiled rule and the assets are cached by the URIs the resolve map points to
+void flushPRTCacheEntries(prt::Cache* prtCache, const prt::ResolveMap& resolveMap) {
+	if (prtCache == nullptr)
+		return;
+	size_t keyCount = 0;
+	const wchar_t* const* keys = resolveMap.getKeys(&keyCount);
+	for (size_t k = 0; k < keyCount; k++) {
+		const wchar_t* uri = resolveMap.getString(keys[k]);
+		if (uri != nullptr)
+			prtCache->flushEntry(uri);
+	}
+}
+
+// returns nothing if there is no complete index or if the extracted rule file is gone (e.g. deleted by a cleanup)
+ResolveMapSPtr readMirrorIndex(const std::filesystem::path& mirrorDir) {
+	std::ifstream stream(mirrorDir / MIRROR_INDEX_FILE, std::ifstream::binary);
+	if (!stream)
+		return {};
+
+	std::string line;
+	if (!std::getline(stream, line) || line != MIRROR_INDEX_HEADER)
+		return {};
+
+	ResolveMapBuilderUPtr builder(prt::ResolveMapBuilder::create());
+	while (std::getline(stream, line)) {
+		const size_t separator = line.find('\t');
+		if (separator == std::string::npos)
+			return {};
+		const std::wstring key = prtu::toUTF16FromUTF8(line.substr(0, separator));
+		const std::string value = line.substr(separator + 1);
+		std::wstring uri;
+		if (value.compare(0, MIRROR_RELATIVE_PREFIX.size(), MIRROR_RELATIVE_PREFIX) == 0) {
+			const std::filesystem::path relativePath(prtu::toUTF16FromUTF8(value.substr(MIRROR_RELATIVE_PREFIX.size())));
+			uri = prtu::toFileURI((mirrorDir / relativePath).make_preferred().wstring());
+		}
+		else
+			uri = prtu::toUTF16FromUTF8(value);
+		if (builder->addEntry(key.c_str(), uri.c_str()) != prt::STATUS_OK)
+			return {};
+	}
+
+	prt::Status status = prt::STATUS_UNSPECIFIED_ERROR;
+	ResolveMapSPtr resolveMap(builder->createResolveMap(&status), PRTDestroyer());
+	if (status != prt::STATUS_OK)
+		return {};
+
+	const std::wstring ruleFile = prtu::getRuleFileEntry(resolveMap);
+	const wchar_t* ruleFileURI = ruleFile.empty() ? nullptr : resolveMap->getString(ruleFile.c_str());
+	if (ruleFileURI == nullptr)
+		return {};
+	const std::filesystem::path ruleFilePath = prtu::fromFileURI(ruleFileURI);
+	std::error_code ec;
+	if (!ruleFilePath.empty() && !std::filesystem::is_regular_file(ruleFilePath, ec))
+		return {};
+
+	return resolveMap;
+}
+
+// the files extracted into mirrorDir are written relative to it, the index stays valid when the dir is renamed
+bool writeMirrorIndex(const std::filesystem::path& mirrorDir, const prt::ResolveMap& resolveMap) {
+	std::ofstream stream(mirrorDir / MIRROR_INDEX_FILE, std::ofstream::binary | std::ofstream::trunc);
+	if (!stream)
+		return false;
+	stream << MIRROR_INDEX_HEADER << '\n';
+
+	const std::filesystem::path normalizedMirrorDir = mirrorDir.lexically_normal();
+	size_t keyCount = 0;
+	const wchar_t* const* keys = resolveMap.getKeys(&keyCount);
+	for (size_t k = 0; k < keyCount; k++) {
+		const wchar_t* value = resolveMap.getString(keys[k]);
+		if (value == nullptr)
+			continue;
+		const std::wstring key = keys[k];
+		if (key.find_first_of(L"\t\r\n") != std::wstring::npos || std::wcspbrk(value, L"\r\n") != nullptr)
+			return false;
+
+		std::string indexValue = prtu::toUTF8FromUTF16(value);
+		const std::filesystem::path path = prtu::fromFileURI(value);
+		if (!path.empty()) {
+			const std::filesystem::path relativePath = path.lexically_normal().lexically_relative(normalizedMirrorDir);
+			if (!relativePath.empty() && *relativePath.begin() != L"..")
+				indexValue = MIRROR_RELATIVE_PREFIX + prtu::toUTF8FromUTF16(relativePath.generic_wstring());
+		}
+		stream << prtu::toUTF8FromUTF16(key) << '\t' << indexValue << '\n';
+	}
+	return static_cast<bool>(stream);
+}
+
+const ResolveMapCache::RuleDataSPtr RULE_DATA_NONE;
+const ResolveMapCache::RuleDataLookupResult RULE_DATA_LOOKUP_FAILURE = {RULE_DATA_NONE,
+                                                                        ResolveMapCache::CacheStatus::MISS};
 
 } // namespace
 
-ResolveMapCache::LookupResult ResolveMapCache::get(const std::wstring& rpk) {
+ResolveMapCache::ResolveMapCache(prt::Cache* prtCache, const std::filesystem::path& mirrorDir)
+    : mPRTCache(prtCache), mMirrorDir(mirrorDir), mCache(std::make_shared<const Cache>()),
+      mWatcher([this](const std::filesystem::path& rpkPath) { invalidate(rpkPath); }) {}
 
-	std::lock_guard<std::mutex> lock(resolveMapCacheMutex);
+ResolveMapCache::~ResolveMapCache() {
+	stop();
+}
 
-	const time_t timeStamp = prtu::getFileModificationTime(rpk);
-	if (DBG)
-		LOG_DBG << "rpk: " << rpk << " current timestamp: " << timeStamp;
+void ResolveMapCache::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mPrefetchMutex);
+		for (std::future<void>& prefetch : mPrefetches)
+			prefetch.wait();
+		mPrefetches.clear();
+	}
+	mWatcher.stop();
+}
 
-	// verify timestamp
-	if (timeStamp == -1)
+ResolveMapCache::LookupResult ResolveMapCache::get(const std::wstring& rpk) {
+	const RulePackageLookupResult lookupResult = lookup(rpk);
+	if (!lookupResult.first.mResolveMap)
 		return LOOKUP_FAILURE;
+	return {lookupResult.first.mResolveMap, lookupResult.second};
+}
 
-	CacheStatus cs = CacheStatus::HIT;
-	auto it = mCache.find(rpk);
-	if (it != mCache.end()) {
-		if (DBG)
-			LOG_DBG << "rpk: cache timestamp: " << it->second.mTimeStamp;
-		if (it->second.mTimeStamp != timeStamp) {
-			mCache.erase(it);
+ResolveMapCache::RuleDataLookupResult ResolveMapCache::getRuleData(const std::wstring& rpk) {
+	const RulePackageLookupResult lookupResult = lookup(rpk);
+	if (!lookupResult.first.mResolveMap)
+		return RULE_DATA_LOOKUP_FAILURE;
+	return {lookupResult.first.mRuleData, lookupResult.second};
+}
 
-			if (DBG)
-				LOG_DBG << "RPK change detected, forcing reload and clearing cache for " << rpk;
-			cs = CacheStatus::MISS;
+ResolveMapCache::RulePackageLookupResult ResolveMapCache::lookup(const std::wstring& rpk) {
+	{
+		const std::shared_ptr<const Cache> cache = std::atomic_load(&mCache);
+		const auto it = cache->find(rpk);
+		if (it != cache->end())
+			return {it->second.mRulePackage, CacheStatus::HIT};
+	}
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	// another thread might have added it meanwhile
+	const std::shared_ptr<const Cache> cache = std::atomic_load(&mCache);
+	const auto it = cache->find(rpk);
+	if (it != cache->end())
+		return {it->second.mRulePackage, CacheStatus::HIT};
+
+	// another thread is creating it right now, e.g. a prefetch
+	const auto inFlightIt = mInFlight.find(rpk);
+	if (inFlightIt != mInFlight.end()) {
+		const std::shared_future<RulePackage> inFlight = inFlightIt->second.mRulePackage;
+		lock.unlock();
+		return {inFlight.get(), CacheStatus::HIT};
+	}
+
+	std::promise<RulePackage> promise;
+	mInFlight.emplace(rpk, InFlight{promise.get_future().share(), {}});
+	lock.unlock();
+
+	// resolving the rpk may take a while, do not block the lookups of other rpks meanwhile
+	RulePackageLookupResult lookupResult = {RulePackage(), CacheStatus::MISS};
+	std::error_code ec;
+	const std::filesystem::path rpkPath = std::filesystem::canonical(rpk, ec);
+	std::optional<ContentKey> contentKey;
+	if (!ec) {
+		lock.lock();
+		mInFlight.at(rpk).mRPKPath = rpkPath;
+		lock.unlock();
+
+		// watch before reading the rpk, a modification in between would be missed otherwise
+		mWatcher.watch(rpkPath);
+
+		contentKey = getContentKey(rpkPath);
+		if (contentKey)
+			lookupResult = lookupContent(*contentKey, rpkPath);
+	}
+	const RulePackage& rulePackage = lookupResult.first;
+
+	InvalidationListener listener;
+	lock.lock();
+	mInFlight.erase(rpk);
+	const bool isStale = (mStaleInFlight.erase(rpk) > 0);
+	if (rulePackage.mResolveMap && !isStale) {
+		// the rpk the shared resolve map was created from might have been modified meanwhile
+		const auto contentIt = mContent.find(*contentKey);
+		if (contentIt != mContent.end() &&
+		    contentIt->second.mRulePackage.mResolveMap == rulePackage.mResolveMap) {
+			auto newCache = std::make_shared<Cache>(*std::atomic_load(&mCache));
+			newCache->emplace(rpk, ResolveMapCacheEntry{rulePackage, rpkPath, *contentKey});
+			std::atomic_store(&mCache, std::shared_ptr<const Cache>(std::move(newCache)));
 		}
+		else
+			listener = mInvalidationListener;
+	}
+	lock.unlock();
+
+	promise.set_value(rulePackage);
+	if (listener)
+		listener({rpk});
+	return lookupResult;
+}
+
+std::optional<ResolveMapCache::ContentKey> ResolveMapCache::getContentKey(const std::filesystem::path& rpkPath) {
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(rpkPath, ec);
+	if (ec)
+		return {};
+	const std::filesystem::file_time_type modificationTime = std::filesystem::last_write_time(rpkPath, ec);
+	if (ec)
+		return {};
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		const auto it = mFileHashes.find(rpkPath.wstring());
+		if (it != mFileHashes.end() && it->second.mSize == size && it->second.mModificationTime == modificationTime)
+			return ContentKey{it->second.mHash, size};
+	}
+
+	const std::optional<uint64_t> hash = ContentHash::hashFile(rpkPath);
+	if (!hash)
+		return {};
+	if (DBG)
+		LOG_DBG << "hashed " << rpkPath << ": " << *hash;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mFileHashes[rpkPath.wstring()] = FileHash{size, modificationTime, *hash};
+	return ContentKey{*hash, size};
+}
+
+ResolveMapCache::RulePackageLookupResult ResolveMapCache::lookupContent(const ContentKey& contentKey,
+                                                                        const std::filesystem::path& rpkPath) {
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	// an identical rpk has already been resolved
+	const auto it = mContent.find(contentKey);
+	if (it != mContent.end())
+		return {it->second.mRulePackage, CacheStatus::HIT};
+
+	const auto inFlightIt = mInFlightContent.find(contentKey);
+	if (inFlightIt != mInFlightContent.end()) {
+		const std::shared_future<RulePackage> inFlight = inFlightIt->second.mRulePackage;
+		lock.unlock();
+		return {inFlight.get(), CacheStatus::HIT};
+	}
+
+	std::promise<RulePackage> promise;
+	mInFlightContent.emplace(contentKey, InFlight{promise.get_future().share(), rpkPath});
+	lock.unlock();
+
+	const RulePackage rulePackage = createRulePackage(rpkPath, contentKey);
+
+	lock.lock();
+	mInFlightContent.erase(contentKey);
+	const bool isStale = (mStaleInFlightContent.erase(contentKey) > 0);
+	if (rulePackage.mResolveMap && !isStale) {
+		auto users = std::make_shared<Users>();
+		users->mLastUse = now();
+		mContent.emplace(contentKey, ContentEntry{rulePackage, rpkPath, std::move(users)});
+		evictUnused(contentKey);
 	}
-	else
-		cs = CacheStatus::MISS;
+	else if (rulePackage.mResolveMap) {
+		// the rule has been compiled from the outdated rpk, the next lookup must not find it in the PRT cache
+		flushPRTCacheEntries(mPRTCache, *rulePackage.mResolveMap);
+	}
+	lock.unlock();
 
-	if (cs == CacheStatus::MISS) {
+	promise.set_value(rulePackage);
+	return {rulePackage, CacheStatus::MISS};
+}
 
-		const auto rpkURI = prtu::toFileURI(rpk);
+ResolveMapCache::RulePackage ResolveMapCache::createRulePackage(const std::filesystem::path& rpkPath,
+                                                                const ContentKey& contentKey) {
+	ResolveMapSPtr resolveMap;
+	if (!mMirrorDir.empty())
+		resolveMap = createMirroredResolveMap(rpkPath, contentKey);
 
-		ResolveMapCacheEntry rmce;
-		rmce.mTimeStamp = timeStamp;
+	// read the assets from within the rpk
+	if (!resolveMap) {
+		const auto rpkURI = prtu::toFileURI(rpkPath.wstring());
 
 		prt::Status status = prt::STATUS_UNSPECIFIED_ERROR;
 		if (DBG)
-			LOG_DBG << "createResolveMap from " << rpk;
-		rmce.mResolveMap.reset(prt::createResolveMap(rpkURI.c_str(), nullptr, &status), PRTDestroyer());
+			LOG_DBG << "createResolveMap from " << rpkPath;
+		resolveMap.reset(prt::createResolveMap(rpkURI.c_str(), nullptr, &status), PRTDestroyer());
 		if (status != prt::STATUS_OK)
-			return LOOKUP_FAILURE;
+			return {};
+	}
+
+	RuleDataSPtr ruleData = createRuleData(resolveMap);
+	return {std::move(resolveMap), std::move(ruleData)};
+}
+
+ResolveMapSPtr ResolveMapCache::createMirroredResolveMap(const std::filesystem::path& rpkPath,
+                                                         const ContentKey& contentKey) {
+	const std::wstring mirrorDirName = getMirrorDirName(contentKey.mHash, contentKey.mSize);
+	const std::filesystem::path unpackDir = mMirrorDir / mirrorDirName;
+
+	// the rpk has already been extracted, e.g. in a previous session
+	if (ResolveMapSPtr resolveMap = readMirrorIndex(unpackDir)) {
+		if (DBG)
+			LOG_DBG << "using mirror " << unpackDir << " of " << rpkPath;
+		return resolveMap;
+	}
 
-		it = mCache.emplace(rpk, std::move(rmce)).first;
+	// concurrent sessions (e.g. another Maya) extract the same rpk into their own dirs, the first one is moved in place
+	const std::filesystem::path extractionDir = createMirrorExtractionDir(mirrorDirName);
+	if (extractionDir.empty())
+		return {};
+
+	const std::wstring rpkURI = prtu::toFileURI(rpkPath.wstring());
+	const std::wstring extractionDirURI = prtu::toFileURI(extractionDir.wstring());
+	prt::Status status = prt::STATUS_UNSPECIFIED_ERROR;
+	if (DBG)
+		LOG_DBG << "createResolveMap from " << rpkPath << ", extracting to " << extractionDir;
+	const ResolveMapSPtr extractedResolveMap(
+	        prt::createResolveMap(rpkURI.c_str(), extractionDirURI.c_str(), &status), PRTDestroyer());
+	std::error_code ec;
+	if (!extractedResolveMap || status != prt::STATUS_OK) {
+		LOG_WRN << "Failed to extract " << rpkPath << " to " << extractionDir << ": "
+		        << prt::getStatusDescription(status);
+		std::filesystem::remove_all(extractionDir, ec);
+		return {};
+	}
+	if (!writeMirrorIndex(extractionDir, *extractedResolveMap)) {
+		LOG_WRN << "Failed to write the index of the rule package mirror " << extractionDir;
+		std::filesystem::remove_all(extractionDir, ec);
+		return {};
+	}
+
+	// an incomplete mirror, e.g. with deleted files, is replaced
+	if (ResolveMapSPtr resolveMap = readMirrorIndex(unpackDir)) {
+		std::filesystem::remove_all(extractionDir, ec);
+		return resolveMap;
+	}
+	std::filesystem::remove_all(unpackDir, ec);
+
+	std::filesystem::rename(extractionDir, unpackDir, ec);
+	if (ec) {
+		if (DBG)
+			LOG_DBG << "rule package mirror " << unpackDir << " has been created by another session: " << ec.message();
+		std::filesystem::remove_all(extractionDir, ec);
+	}
+
+	// the resolve map refers to the moved files
+	ResolveMapSPtr resolveMap = readMirrorIndex(unpackDir);
+	if (!resolveMap)
+		LOG_WRN << "Failed to create the rule package mirror " << unpackDir << " of " << rpkPath;
+	return resolveMap;
+}
+
+std::filesystem::path ResolveMapCache::createMirrorExtractionDir(const std::wstring& mirrorDirName) const {
+	std::error_code ec;
+	std::filesystem::create_directories(mMirrorDir, ec);
+	if (ec) {
+		LOG_WRN << "Failed to create the rule package mirror " << mMirrorDir << ": " << ec.message();
+		return {};
+	}
+
+	// the timestamp avoids collisions with the extractions of other sessions, create_directory fails for them anyway
+	const auto timestamp = std::chrono::system_clock::now().time_since_epoch().count();
+	for (int attempt = 0; attempt < 16; attempt++) {
+		const std::filesystem::path extractionDir = mMirrorDir / (mirrorDirName + MIRROR_EXTRACTION_SUFFIX +
+		                                                          std::to_wstring(timestamp) + L"_" +
+		                                                          std::to_wstring(attempt));
+		if (std::filesystem::create_directory(extractionDir, ec))
+			return extractionDir;
+	}
+
+	LOG_WRN << "Failed to create a rule package extraction directory in " << mMirrorDir;
+	return {};
+}
+
+ResolveMapCache::RuleDataSPtr ResolveMapCache::createRuleData(const ResolveMapSPtr& resolveMap) const {
+	auto ruleData = std::make_shared<RuleData>();
+
+	ruleData->mRuleFile = prtu::getRuleFileEntry(resolveMap);
+	if (ruleData->mRuleFile.empty()) {
+		ruleData->mStatus = RuleData::Status::NO_RULE_FILE;
+		return ruleData;
+	}
+
+	const wchar_t* ruleFileURI = resolveMap->getString(ruleData->mRuleFile.c_str());
+	if (ruleFileURI == nullptr) {
+		ruleData->mStatus = RuleData::Status::NO_RULE_FILE_URI;
+		return ruleData;
+	}
+
+	// also loads the compiled rule into the PRT cache
+	prt::Status infoStatus = prt::STATUS_UNSPECIFIED_ERROR;
+	ruleData->mRuleFileInfo.reset(prt::createRuleFileInfo(ruleFileURI, mPRTCache, &infoStatus));
+	if (!ruleData->mRuleFileInfo || infoStatus != prt::STATUS_OK) {
+		ruleData->mRuleFileInfo.reset();
+		ruleData->mStatus = RuleData::Status::NO_RULE_FILE_INFO;
+		return ruleData;
+	}
+
+	ruleData->mStartRule = prtu::detectStartRule(ruleData->mRuleFileInfo);
+	ruleData->mRuleAttributes = getRuleAttributes(ruleData->mRuleFile, ruleData->mRuleFileInfo.get());
+	for (const RuleAttribute& ruleAttr : ruleData->mRuleAttributes)
+		ruleData->mRuleAttributeMap[ruleAttr.mayaFullName] = ruleAttr;
+	ruleData->mAttributeTraits = getAttributeTraits(ruleData->mRuleFileInfo.get());
+
+	return ruleData;
+}
+
+void ResolveMapCache::prefetch(const std::vector<std::wstring>& rpks) {
+	auto pendingRPKs = std::make_shared<std::vector<std::wstring>>(rpks);
+	std::sort(pendingRPKs->begin(), pendingRPKs->end());
+	pendingRPKs->erase(std::unique(pendingRPKs->begin(), pendingRPKs->end()), pendingRPKs->end());
+	if (pendingRPKs->empty())
+		return;
+
+	const size_t workerCount =
+	        std::min<size_t>(pendingRPKs->size(), std::max<size_t>(std::thread::hardware_concurrency(), 1));
+	auto nextRPK = std::make_shared<std::atomic<size_t>>(0);
+	auto work = [this, pendingRPKs, nextRPK]() {
+		for (size_t i = (*nextRPK)++; i < pendingRPKs->size(); i = (*nextRPK)++)
+			lookup((*pendingRPKs)[i]);
+	};
+
+	std::lock_guard<std::mutex> lock(mPrefetchMutex);
+	auto isDone = [](const std::future<void>& prefetch) {
+		return prefetch.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	};
+	mPrefetches.erase(std::remove_if(mPrefetches.begin(), mPrefetches.end(), isDone), mPrefetches.end());
+	for (size_t w = 0; w < workerCount; w++)
+		mPrefetches.push_back(std::async(std::launch::async, work));
+
+	if (DBG)
+		LOG_DBG << "prefetching " << pendingRPKs->size() << " rpks on " << workerCount << " threads";
+}
+
+ResolveMapCache::UsageToken ResolveMapCache::acquire(const std::wstring& rpk) {
+	if (!lookup(rpk).first.mResolveMap)
+		return {};
+
+	std::shared_ptr<Users> users;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		const std::shared_ptr<const Cache> cache = std::atomic_load(&mCache);
+		const auto it = cache->find(rpk);
+		if (it == cache->end())
+			return {};
+		const auto contentIt = mContent.find(it->second.mContentKey);
+		if (contentIt == mContent.end())
+			return {};
+		users = contentIt->second.mUsers;
+
+		// while locked, the entry must not be evicted before it is in use
+		users->mCount++;
+		users->mLastUse = now();
 	}
 
-	return {it->second.mResolveMap, cs};
+	auto release = [users](void*) {
+		users->mLastUse = now();
+		users->mCount--;
+	};
+	return UsageToken(users.get(), release);
+}
+
+ResolveMapCache::Usage ResolveMapCache::getUsage() {
+	std::lock_guard<std::mutex> lock(mMutex);
+	Usage usage;
+	for (const auto& content : mContent) {
+		usage.mRulePackageCount++;
+		if (content.second.mUsers->mCount > 0)
+			usage.mInUseCount++;
+		usage.mSize += content.first.mSize;
+	}
+	return usage;
+}
+
+void ResolveMapCache::setBudget(uintmax_t budget) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mBudget = budget;
+	evictUnused({});
+}
+
+void ResolveMapCache::evictUnused(const std::optional<ContentKey>& keptContentKey) {
+	if (mBudget == 0)
+		return;
+
+	uintmax_t totalSize = 0;
+	for (const auto& content : mContent)
+		totalSize += content.first.mSize;
+	if (totalSize <= mBudget)
+		return;
+
+	std::vector<std::pair<std::chrono::steady_clock::rep, ContentKey>> unused;
+	for (const auto& content : mContent) {
+		if (content.second.mUsers->mCount == 0 && !(keptContentKey && content.first == *keptContentKey))
+			unused.emplace_back(content.second.mUsers->mLastUse.load(), content.first);
+	}
+	std::sort(unused.begin(), unused.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	std::unordered_set<ContentKey, ContentKeyHash> evictedContent;
+	for (const auto& candidate : unused) {
+		if (totalSize <= mBudget)
+			break;
+		totalSize -= candidate.second.mSize;
+		const auto contentIt = mContent.find(candidate.second);
+		flushPRTCacheEntries(mPRTCache, *contentIt->second.mRulePackage.mResolveMap);
+		mContent.erase(contentIt);
+		evictedContent.insert(candidate.second);
+	}
+	if (evictedContent.empty())
+		return;
+
+	auto newCache = std::make_shared<Cache>(*std::atomic_load(&mCache));
+	for (auto it = newCache->begin(); it != newCache->end();) {
+		if (evictedContent.count(it->second.mContentKey) > 0) {
+			if (DBG)
+				LOG_DBG << "evicting resolve map of " << it->first;
+			it = newCache->erase(it);
+		}
+		else
+			++it;
+	}
+	std::atomic_store(&mCache, std::shared_ptr<const Cache>(std::move(newCache)));
+}
+
+void ResolveMapCache::setInvalidationListener(InvalidationListener listener) {
+	std::lock_guard<std::mutex> lock(mMutex);
+	mInvalidationListener = std::move(listener);
+}
+
+bool ResolveMapCache::revalidate(const std::wstring& rpk) {
+	std::error_code ec;
+	const std::filesystem::path rpkPath = std::filesystem::canonical(rpk, ec);
+	if (ec)
+		return false;
+	const uintmax_t size = std::filesystem::file_size(rpkPath, ec);
+	if (ec)
+		return false;
+	const std::filesystem::file_time_type modificationTime = std::filesystem::last_write_time(rpkPath, ec);
+	if (ec)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		// not read yet or already invalidated, the next lookup reads it anyway
+		const auto it = mFileHashes.find(rpkPath.wstring());
+		if (it == mFileHashes.end() ||
+		    (it->second.mSize == size && it->second.mModificationTime == modificationTime))
+			return false;
+	}
+
+	LOG_INF << "rule package " << rpkPath << " has been modified, reloading it";
+	invalidate(rpkPath);
+	return true;
+}
+
+void ResolveMapCache::invalidate(const std::filesystem::path& rpkPath) {
+	const std::filesystem::path normalizedRPKPath = rpkPath.lexically_normal();
+
+	std::vector<KeyType> invalidatedKeys;
+	InvalidationListener listener;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFileHashes.erase(normalizedRPKPath.wstring());
+
+		// the lookups waiting for them get the outdated resolve map, their nodes need to be reloaded as well
+		for (const auto& inFlight : mInFlight) {
+			if (inFlight.second.mRPKPath == normalizedRPKPath) {
+				mStaleInFlight.insert(inFlight.first);
+				invalidatedKeys.push_back(inFlight.first);
+			}
+		}
+		for (const auto& inFlight : mInFlightContent) {
+			if (inFlight.second.mRPKPath == normalizedRPKPath)
+				mStaleInFlightContent.insert(inFlight.first);
+		}
+
+		// the resolve maps created from the modified rpk are also dropped for its identical copies
+		// the compiled rules and assets are cached by their URIs, which are the same for the modified rpk
+		std::unordered_set<ContentKey, ContentKeyHash> invalidatedContent;
+		for (auto it = mContent.begin(); it != mContent.end();) {
+			if (it->second.mRPKPath == normalizedRPKPath) {
+				flushPRTCacheEntries(mPRTCache, *it->second.mRulePackage.mResolveMap);
+				invalidatedContent.insert(it->first);
+				it = mContent.erase(it);
+			}
+			else
+				++it;
+		}
+
+		auto newCache = std::make_shared<Cache>(*std::atomic_load(&mCache));
+		for (auto it = newCache->begin(); it != newCache->end();) {
+			if (it->second.mRPKPath == normalizedRPKPath || invalidatedContent.count(it->second.mContentKey) > 0) {
+				invalidatedKeys.push_back(it->first);
+				it = newCache->erase(it);
+			}
+			else
+				++it;
+		}
+		if (invalidatedKeys.empty())
+			return;
+		std::atomic_store(&mCache, std::shared_ptr<const Cache>(std::move(newCache)));
+		listener = mInvalidationListener;
+	}
+
+	if (DBG) {
+		for (const KeyType& rpk : invalidatedKeys)
+			LOG_DBG << "RPK change detected, clearing cache for " << rpk;
+	}
+	if (listener)
+		listener(invalidatedKeys);
 }
@@ -17,35 +17,196 @@
  * limitations under the License.
  */
 
+
 #pragma once
 
+#include "modifiers/RuleAttributes.h"
+
+#include "utils/FileWatcher.h"
 #include "utils/Utilities.h"
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
-#include <map>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+/**
+ * Cached lookups do not lock and do not access the file system: the rpks in use are watched and the entry of an rpk
+ * is dropped as soon as it is modified on disk. Concurrent lookups of the same rpk create its resolve map only once.
+ * Each entry also holds the rule data derived from the rpk, i.e. all nodes using the same rpk share it.
+ *
+ * The resolve maps are keyed by the content of the rpks: different spellings of the path (relative, symlinks) and
+ * copies of the same rpk share one resolve map, and thus the compiled rule in the PRT cache.
+ *
+ * Optionally, the rpks are extracted into a local mirror dir (one sub dir per rpk content) and the resolve maps point
+ * to the extracted files. The assets are then read from the local file system instead of through the rpk archive.
+ */
 class ResolveMapCache {
 public:
 	using KeyType = std::wstring;
 
-	ResolveMapCache() = default;
+	/**
+	 * Called on the file watcher thread after the entries of a modified rpk (all its spellings and identical copies)
+	 * have been dropped and its compiled rules and assets have been flushed from the PRT cache.
+	 */
+	using InvalidationListener = std::function<void(const std::vector<KeyType>& rpks)>;
+
+	struct RuleData {
+		enum class Status { OK, NO_RULE_FILE, NO_RULE_FILE_URI, NO_RULE_FILE_INFO };
+		Status mStatus = Status::OK;
+
+		std::wstring mRuleFile;
+		std::wstring mStartRule;
+		RuleFileInfoUPtr mRuleFileInfo;
+		RuleAttributeSet mRuleAttributes;   // sorted
+		RuleAttributeMap mRuleAttributeMap; // key is the maya full name
+		AttributeTraitMap mAttributeTraits; // the annotations are owned by mRuleFileInfo
+	};
+	using RuleDataSPtr = std::shared_ptr<const RuleData>;
+
+	// rpks are not mirrored if mirrorDir is empty
+	explicit ResolveMapCache(prt::Cache* prtCache, const std::filesystem::path& mirrorDir = {});
 	ResolveMapCache(const ResolveMapCache&) = delete;
 	ResolveMapCache(ResolveMapCache&&) = delete;
 	ResolveMapCache& operator=(ResolveMapCache const&) = delete;
 	ResolveMapCache& operator=(ResolveMapCache&&) = delete;
+	~ResolveMapCache(); // waits for running prefetches
 
 	enum class CacheStatus { HIT, MISS };
 	using LookupResult = std::pair<ResolveMapSPtr, CacheStatus>;
 	LookupResult get(const std::wstring& rpk);
 
+	using RuleDataLookupResult = std::pair<RuleDataSPtr, CacheStatus>;
+	RuleDataLookupResult getRuleData(const std::wstring& rpk);
+
+	// keeps the resolve map of an rpk (and of its identical copies) from being evicted while it is held
+	using UsageToken = std::shared_ptr<void>;
+	UsageToken acquire(const std::wstring& rpk);
+
+	struct Usage {
+		size_t mRulePackageCount = 0; // distinct rpk contents
+		size_t mInUseCount = 0;       // rpks with a usage token
+		uintmax_t mSize = 0;          // approximated by the rpk sizes
+	};
+	Usage getUsage();
+
+	/**
+	 * Evicts the least recently used resolve maps without usage tokens while the cache exceeds the budget
+	 * (0: unlimited). The compiled rules and assets of the evicted rpks are flushed from the PRT cache as well.
+	 */
+	void setBudget(uintmax_t budget);
+
+	/**
+	 * Creates the resolve maps and rule data of the rpks on worker threads and returns immediately. The first lookups
+	 * (e.g. when the nodes of an opened scene are evaluated) are hits and the compiled rules are in the PRT cache.
+	 */
+	void prefetch(const std::vector<std::wstring>& rpks);
+
+	void setInvalidationListener(InvalidationListener listener);
+
+	/**
+	 * Invalidates the rpk like a reported change if its size or modification time differs from when it was read, e.g.
+	 * when the file watcher missed the change on a network share. Returns true if the rpk was invalidated.
+	 */
+	bool revalidate(const std::wstring& rpk);
+
+	// waits for running prefetches and stops watching the rpks, the next lookup starts watching again
+	void stop();
+
 private:
+	struct RulePackage {
+		ResolveMapSPtr mResolveMap; // null if the rpk could not be read
+		RuleDataSPtr mRuleData;
+	};
+	using RulePackageLookupResult = std::pair<RulePackage, CacheStatus>;
+
+	// identifies the content of an rpk
+	struct ContentKey {
+		uint64_t mHash;
+		uintmax_t mSize;
+
+		bool operator==(const ContentKey& other) const {
+			return mHash == other.mHash && mSize == other.mSize;
+		}
+	};
+
+	struct ContentKeyHash {
+		size_t operator()(const ContentKey& key) const {
+			size_t seed = static_cast<size_t>(key.mHash);
+			prtu::hash_combine(seed, static_cast<size_t>(key.mSize));
+			return seed;
+		}
+	};
+
+	RulePackageLookupResult lookup(const std::wstring& rpk);
+	std::optional<ContentKey> getContentKey(const std::filesystem::path& rpkPath);
+	RulePackageLookupResult lookupContent(const ContentKey& contentKey, const std::filesystem::path& rpkPath);
+	RulePackage createRulePackage(const std::filesystem::path& rpkPath, const ContentKey& contentKey);
+	ResolveMapSPtr createMirroredResolveMap(const std::filesystem::path& rpkPath, const ContentKey& contentKey);
+	std::filesystem::path createMirrorExtractionDir(const std::wstring& mirrorDirName) const;
+	RuleDataSPtr createRuleData(const ResolveMapSPtr& resolveMap) const;
+	void invalidate(const std::filesystem::path& rpkPath);
+	void evictUnused(const std::optional<ContentKey>& keptContentKey); // expects mMutex to be locked
+
 	struct ResolveMapCacheEntry {
-		ResolveMapSPtr mResolveMap;
-		time_t mTimeStamp;
+		RulePackage mRulePackage;
+		std::filesystem::path mRPKPath; // canonical, to match the paths reported by the file watcher
+		ContentKey mContentKey;
 	};
-	using Cache = std::map<KeyType, ResolveMapCacheEntry>;
-	Cache mCache;
+	using Cache = std::unordered_map<KeyType, ResolveMapCacheEntry>;
+
+	struct InFlight {
+		std::shared_future<RulePackage> mRulePackage;
+		std::filesystem::path mRPKPath; // canonical, empty while the path of an rpk lookup is being resolved
+	};
+
+	// shared with the usage tokens, which might outlive the entry
+	struct Users {
+		std::atomic<size_t> mCount{0};
+		std::atomic<std::chrono::steady_clock::rep> mLastUse{0};
+	};
+
+	struct ContentEntry {
+		RulePackage mRulePackage;
+		std::filesystem::path mRPKPath; // the rpk the resolve map was created from, its URIs point into it
+		std::shared_ptr<Users> mUsers;
+	};
+
+	// the content hash of an rpk is only computed again if its size or modification time changed
+	struct FileHash {
+		uintmax_t mSize;
+		std::filesystem::file_time_type mModificationTime;
+		uint64_t mHash;
+	};
+
+	prt::Cache* const mPRTCache; // for the rule file infos, the entries of evicted and modified rpks are flushed
+	const std::filesystem::path mMirrorDir;
+
+	std::shared_ptr<const Cache> mCache; // copy-on-write, always accessed with std::atomic_load/std::atomic_store
+	std::mutex mMutex;                   // serializes the updates of mCache and guards the members below
+	std::unordered_map<KeyType, InFlight> mInFlight;
+	std::unordered_set<KeyType> mStaleInFlight; // modified while their resolve map was being created
+	std::unordered_map<ContentKey, ContentEntry, ContentKeyHash> mContent;
+	std::unordered_map<ContentKey, InFlight, ContentKeyHash> mInFlightContent;
+	std::unordered_set<ContentKey, ContentKeyHash> mStaleInFlightContent;
+	std::unordered_map<std::wstring, FileHash> mFileHashes; // by canonical path
+	uintmax_t mBudget = 0;
+	InvalidationListener mInvalidationListener;
+
+	std::mutex mPrefetchMutex;
+	std::vector<std::future<void>> mPrefetches;
+
+	// must be destroyed first, its thread calls invalidate
+	FileWatcher mWatcher;
 };
 
 using ResolveMapCacheUPtr = std::unique_ptr<ResolveMapCache>;
\ No newline at end of file
@@ -0,0 +1,136 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/StagingOutputCallbacks.h"
+
+#include "utils/LogHandler.h"
+
+#include <algorithm>
+#include <string>
+
+StagingOutputCallbacks::StagingOutputCallbacks(const std::filesystem::path& stagingDir) : mStagingDir(stagingDir) {}
+
+StagingOutputCallbacks::~StagingOutputCallbacks() {
+	mStream.close();
+	std::error_code ec;
+	std::filesystem::remove_all(mStagingDir, ec);
+}
+
+const std::filesystem::path& StagingOutputCallbacks::getStagedFile() const {
+	return mStagedFile;
+}
+
+std::optional<uint64_t> StagingOutputCallbacks::getContentHash() const {
+	return mStagedContentHash;
+}
+
+uint64_t StagingOutputCallbacks::open(const wchar_t* /*encoderId*/, const prt::ContentType /*contentType*/,
+                                      const wchar_t* name, StringEncoding /*enc*/, OpenMode /*openMode*/,
+                                      prt::Status* status) {
+	if (mStream.is_open() || !mFile.empty() || name == nullptr) {
+		LOG_ERR << "Cannot stage more than one asset in " << mStagingDir;
+		if (status != nullptr)
+			*status = prt::STATUS_UNSPECIFIED_ERROR;
+		return 0;
+	}
+
+	mFile = mStagingDir / std::filesystem::path(name).filename();
+	mStream.open(mFile, std::ofstream::binary | std::ofstream::trunc);
+	if (!mStream) {
+		LOG_ERR << "Failed to open staged asset " << mFile;
+		mFailed = true;
+		if (status != nullptr)
+			*status = prt::STATUS_UNSPECIFIED_ERROR;
+		return 0;
+	}
+
+	if (status != nullptr)
+		*status = prt::STATUS_OK;
+	return FILE_HANDLE;
+}
+
+prt::Status StagingOutputCallbacks::write(uint64_t handle, const wchar_t* string) {
+	if (string == nullptr)
+		return prt::STATUS_UNSPECIFIED_ERROR;
+	const std::string utf8String = prtu::toUTF8FromUTF16(string);
+	return write(handle, reinterpret_cast<const uint8_t*>(utf8String.data()), utf8String.size());
+}
+
+prt::Status StagingOutputCallbacks::write(uint64_t handle, const uint8_t* buffer, size_t size) {
+	if (handle != FILE_HANDLE || !mStream.is_open())
+		return prt::STATUS_UNSPECIFIED_ERROR;
+
+	mStream.write(reinterpret_cast<const char*>(buffer), size);
+	if (!mStream) {
+		mFailed = true;
+		return prt::STATUS_UNSPECIFIED_ERROR;
+	}
+
+	// overwriting previously written content invalidates the hash
+	if (mPosition != mSize)
+		mIsSequential = false;
+	else if (mIsSequential)
+		mContentHash.update(buffer, size);
+	mPosition += size;
+	mSize = std::max(mSize, mPosition);
+	return prt::STATUS_OK;
+}
+
+prt::Status StagingOutputCallbacks::close(uint64_t handle, const size_t* /*calls*/, size_t /*callsCount*/) {
+	if (handle != FILE_HANDLE || !mStream.is_open())
+		return prt::STATUS_UNSPECIFIED_ERROR;
+
+	mStream.close();
+	if (mFailed || mStream.fail()) {
+		LOG_ERR << "Failed to write staged asset " << mFile;
+		return prt::STATUS_UNSPECIFIED_ERROR;
+	}
+
+	mStagedFile = mFile;
+	if (mIsSequential)
+		mStagedContentHash = mContentHash.digest();
+	return prt::STATUS_OK;
+}
+
+uint64_t StagingOutputCallbacks::tell(uint64_t handle, prt::Status* status) {
+	if (status != nullptr)
+		*status = (handle == FILE_HANDLE && mStream.is_open()) ? prt::STATUS_OK : prt::STATUS_UNSPECIFIED_ERROR;
+	return mPosition;
+}
+
+prt::Status StagingOutputCallbacks::seek(uint64_t handle, int64_t offset, SeekOrigin origin) {
+	if (handle != FILE_HANDLE || !mStream.is_open())
+		return prt::STATUS_UNSPECIFIED_ERROR;
+
+	int64_t position = offset;
+	if (origin == SO_CURRENT)
+		position += static_cast<int64_t>(mPosition);
+	else if (origin == SO_END)
+		position += static_cast<int64_t>(mSize);
+	if (position < 0)
+		return prt::STATUS_UNSPECIFIED_ERROR;
+
+	mStream.seekp(position);
+	if (!mStream) {
+		mFailed = true;
+		return prt::STATUS_UNSPECIFIED_ERROR;
+	}
+	mPosition = static_cast<uint64_t>(position);
+	return prt::STATUS_OK;
+}
@@ -0,0 +1,160 @@
+/**
+ * Serlio - Esri CityEngine Plugin for Autodesk Maya
+ *
+ * See https://github.com/esri/serlio for build and usage instructions.
+ *
+ * Copyright (c) 2012-2022 Esri R&D Center Zurich
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "utils/ContentHash.h"
+#include "utils/Utilities.h"
+
+#include "prt/SimpleOutputCallbacks.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+/**
+ * Writes a single asset (e.g. a re-encoded texture) into a staging dir of the asset cache and hashes its content while
+ * it is written, the asset cache does not need to read the file again (see AssetCache::putFile). If the encoder seeks
+ * within the file, the content hash is not available and the file needs to be hashed after all.
+ * Removes the staging dir when destroyed, unless the file has been moved into the cache.
+ */
+class StagingOutputCallbacks : public prt::SimpleOutputCallbacks {
+public:
+	explicit StagingOutputCallbacks(const std::filesystem::path& stagingDir);
+	StagingOutputCallbacks(const StagingOutputCallbacks&) = delete;
+	StagingOutputCallbacks& operator=(const StagingOutputCallbacks&) = delete;
+	~StagingOutputCallbacks() override;
+
+	// empty until a file has been written and closed successfully
+	const std::filesystem::path& getStagedFile() const;
+	std::optional<uint64_t> getContentHash() const;
+
+	// prt::SimpleOutputCallbacks interface
+	uint64_t open(const wchar_t* encoderId, const prt::ContentType contentType, const wchar_t* name,
+	              StringEncoding enc, OpenMode openMode, prt::Status* status) override;
+	prt::Status write(uint64_t handle, const wchar_t* string) override;
+	prt::Status write(uint64_t handle, const uint8_t* buffer, size_t size) override;
+	prt::Status close(uint64_t handle, const size_t* calls, size_t callsCount) override;
+	uint64_t tell(uint64_t handle, prt::Status* status) override;
+	prt::Status seek(uint64_t handle, int64_t offset, SeekOrigin origin) override;
+
+	prt::Status openCGAError(const wchar_t* /*name*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status openCGAPrint(const wchar_t* /*name*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status openCGAReport(const wchar_t* /*name*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status closeCGAError() override {
+		return prt::STATUS_OK;
+	}
+	prt::Status closeCGAPrint() override {
+		return prt::STATUS_OK;
+	}
+	prt::Status closeCGAReport() override {
+		return prt::STATUS_OK;
+	}
+
+	// prt::Callbacks interface, not used by the texture encoders
+	prt::Status generateError(size_t /*isIndex*/, prt::Status /*status*/, const wchar_t* /*message*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status assetError(size_t /*isIndex*/, prt::CGAErrorLevel /*level*/, const wchar_t* /*key*/,
+	                       const wchar_t* /*uri*/, const wchar_t* /*message*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status cgaError(size_t /*isIndex*/, int32_t /*shapeID*/, prt::CGAErrorLevel /*level*/, int32_t /*methodId*/,
+	                     int32_t /*pc*/, const wchar_t* /*message*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status cgaPrint(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*txt*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status cgaReportBool(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/, bool /*value*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status cgaReportFloat(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/,
+	                           double /*value*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status cgaReportString(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/,
+	                            const wchar_t* /*value*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status attrBool(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/, bool /*value*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status attrFloat(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/, double /*value*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status attrString(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/,
+	                       const wchar_t* /*value*/) override {
+		return prt::STATUS_OK;
+	}
+
+// PRT version >= 2.3
+#if PRT_VERSION_GTE(2, 3)
+
+	prt::Status attrBoolArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/, const bool* /*values*/,
+	                          size_t /*size*/, size_t /*nRows*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status attrFloatArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/,
+	                           const double* /*values*/, size_t /*size*/, size_t /*nRows*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status attrStringArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/,
+	                            const wchar_t* const* /*values*/, size_t /*size*/, size_t /*nRows*/) override {
+		return prt::STATUS_OK;
+	}
+
+#elif PRT_VERSION_GTE(2, 1)
+
+	prt::Status attrBoolArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/, const bool* /*values*/,
+	                          size_t /*size*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status attrFloatArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/,
+	                           const double* /*values*/, size_t /*size*/) override {
+		return prt::STATUS_OK;
+	}
+	prt::Status attrStringArray(size_t /*isIndex*/, int32_t /*shapeID*/, const wchar_t* /*key*/,
+	                            const wchar_t* const* /*values*/, size_t /*size*/) override {
+		return prt::STATUS_OK;
+	}
+
+#endif // PRT version >= 2.1
+
+private:
+	static constexpr uint64_t FILE_HANDLE = 1; // a single file per staging dir
+
+	const std::filesystem::path mStagingDir;
+	std::filesystem::path mFile;
+	std::ofstream mStream;
+	ContentHash mContentHash;
+	uint64_t mPosition = 0;
+	uint64_t mSize = 0;
+	bool mIsSequential = true; // the content hash is only valid if the file has been written front to back
+	bool mFailed = false;
+	std::filesystem::path mStagedFile;
+	std::optional<uint64_t> mStagedContentHash;
+};
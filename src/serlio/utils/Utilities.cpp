@@ -219,6 +219,21 @@ std::string percentEncode(const std::string& utf8String) {
 	return stringConversionWrapper<char, char>(prt::StringUtils::percentEncode, utf8String);
 }
 
+std::string percentDecode(const std::string& utf8String) {
+	std::string decoded;
+	decoded.reserve(utf8String.size());
+	for (size_t i = 0; i < utf8String.size(); i++) {
+		if (utf8String[i] == '%' && i + 2 < utf8String.size()) {
+			decoded.push_back(static_cast<char>((fromHex(utf8String[i + 1]) << 4) + fromHex(utf8String[i + 2])));
+			i += 2;
+		}
+		else {
+			decoded.push_back(utf8String[i]);
+		}
+	}
+	return decoded;
+}
+
 std::wstring toFileURI(const std::wstring& p) {
 #ifdef _WIN32
 	static const std::wstring schema = L"file:/";
@@ -231,6 +246,19 @@ std::wstring toFileURI(const std::wstring& p) {
 	return schema + u16String;
 }
 
+std::filesystem::path fromFileURI(const std::wstring& uri) {
+#ifdef _WIN32
+	static const std::wstring schema = L"file:/";
+#else
+	static const std::wstring schema = L"file:";
+#endif
+	if (uri.compare(0, schema.size(), schema) != 0)
+		return {};
+
+	const std::string utf8Path = percentDecode(prtu::toUTF8FromUTF16(uri.substr(schema.size())));
+	return std::filesystem::path(toUTF16FromUTF8(utf8Path));
+}
+
 time_t getFileModificationTime(const std::wstring& p) {
 	std::wstring pn = std::filesystem::path(p).make_preferred().wstring();
 
@@ -136,7 +136,9 @@ SRL_TEST_EXPORTS_API std::wstring toUTF16FromUTF8(const std::string& u8String);
 SRL_TEST_EXPORTS_API std::string toUTF8FromUTF16(const std::wstring& u16String);
 
 SRL_TEST_EXPORTS_API std::wstring toFileURI(const std::wstring& p);
+SRL_TEST_EXPORTS_API std::filesystem::path fromFileURI(const std::wstring& uri); // empty if not a file URI
 std::string percentEncode(const std::string& utf8String);
+std::string percentDecode(const std::string& utf8String);
 
 std::string objectToXML(prt::Object const* obj);
 template <typename T>
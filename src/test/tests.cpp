@@ -19,16 +19,36 @@
 
 #include "PRTContext.h"
 
+#include "modifiers/MeshHoles.h"
 #include "modifiers/RuleAttributes.h"
 
+#include "utils/AssetCache.h"
+#include "utils/AssetWriter.h"
+#include "utils/ContentHash.h"
+#include "utils/FileWatcher.h"
 #include "utils/LogHandler.h"
 #include "utils/Utilities.h"
 
+#include "encoder/JobPool.h"
+#include "encoder/VertexWelding.h"
+
 #define CATCH_CONFIG_RUNNER
 #define CATCH_CONFIG_FAST_COMPILE
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch2/catch.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <string_view>
+#include <thread>
 
 namespace {
 
@@ -138,6 +158,178 @@ TEST_CASE("default attribute values") {
 	// TODO: add assertion for value, needs interface into PRTModifierAction.cpp without introducing maya dep here
 }
 
+TEST_CASE("cached rule data") {
+	const std::wstring rpk = testDataPath + L"/CE-6813-wrong-attr-style.rpk";
+	const ResolveMapCache::RuleDataLookupResult lookupResult = prtCtx->mResolveMapCache->getRuleData(rpk);
+	const ResolveMapCache::RuleDataSPtr ruleData = lookupResult.first;
+	REQUIRE(ruleData);
+	REQUIRE(ruleData->mStatus == ResolveMapCache::RuleData::Status::OK);
+	CHECK(ruleData->mRuleFile == L"bin/r1.cgb");
+
+	// derived once per rule package and shared by all lookups
+	CHECK(prtCtx->mResolveMapCache->getRuleData(rpk).first == ruleData);
+
+	const RuleAttributeSet ruleAttrs = getRuleAttributes(ruleData->mRuleFile, ruleData->mRuleFileInfo.get());
+	CHECK(ruleAttrs.size() == ruleData->mRuleAttributes.size());
+	CHECK(ruleData->mRuleAttributeMap.size() == ruleData->mRuleAttributes.size());
+}
+
+TEST_CASE("identical rule packages share a resolve map") {
+	const std::filesystem::path rpk = testDataPath + L"/CE-6813-wrong-attr-style.rpk";
+	const std::filesystem::path copyDir = std::filesystem::temp_directory_path() / L"serlio_test_rpk_copies";
+	std::filesystem::remove_all(copyDir);
+	std::filesystem::create_directories(copyDir / L"sub");
+	const std::filesystem::path rpkCopy = copyDir / L"copy.rpk";
+	std::filesystem::copy_file(rpk, rpkCopy);
+
+	const ResolveMapSPtr resolveMap = prtCtx->mResolveMapCache->get(rpk.wstring()).first;
+	REQUIRE(resolveMap);
+	CHECK(prtCtx->mResolveMapCache->get(rpkCopy.wstring()).first == resolveMap);
+	CHECK(prtCtx->mResolveMapCache->get((copyDir / L"sub" / L".." / L"copy.rpk").wstring()).first == resolveMap);
+	CHECK(prtCtx->mResolveMapCache->getRuleData(rpkCopy.wstring()).first ==
+	      prtCtx->mResolveMapCache->getRuleData(rpk.wstring()).first);
+
+	std::filesystem::remove_all(copyDir);
+}
+
+TEST_CASE("rule package mirror") {
+	const std::filesystem::path rpk = testDataPath + L"/CE-6813-wrong-attr-style.rpk";
+	const std::filesystem::path mirrorDir = std::filesystem::temp_directory_path() / L"serlio_test_rpk_mirror";
+	std::filesystem::remove_all(mirrorDir);
+
+	auto getRuleFilePath = [](const ResolveMapSPtr& resolveMap) -> std::filesystem::path {
+		const std::wstring ruleFile = prtu::getRuleFileEntry(resolveMap);
+		const wchar_t* ruleFileURI = resolveMap->getString(ruleFile.c_str());
+		return (ruleFileURI != nullptr) ? prtu::fromFileURI(ruleFileURI) : std::filesystem::path();
+	};
+	auto getMirrorDirs = [&mirrorDir]() {
+		std::vector<std::filesystem::path> dirs;
+		for (const auto& entry : std::filesystem::directory_iterator(mirrorDir))
+			dirs.push_back(entry.path());
+		return dirs;
+	};
+
+	std::filesystem::path ruleFilePath;
+	{
+		ResolveMapCache resolveMapCache(prtCtx->mPRTCache.get(), mirrorDir);
+		const ResolveMapSPtr resolveMap = resolveMapCache.get(rpk.wstring()).first;
+		REQUIRE(resolveMap);
+		ruleFilePath = getRuleFilePath(resolveMap);
+		CHECK(std::filesystem::is_regular_file(ruleFilePath));
+	}
+
+	// one dir per rpk content, no leftovers of the extraction
+	const std::vector<std::filesystem::path> mirrorDirs = getMirrorDirs();
+	REQUIRE(mirrorDirs.size() == 1);
+	CHECK(ruleFilePath.lexically_relative(mirrorDirs.front()).begin()->wstring() != L"..");
+
+	SECTION("reused by the next session") {
+		const auto modificationTime = std::filesystem::last_write_time(ruleFilePath);
+		ResolveMapCache resolveMapCache(prtCtx->mPRTCache.get(), mirrorDir);
+		const ResolveMapSPtr resolveMap = resolveMapCache.get(rpk.wstring()).first;
+		REQUIRE(resolveMap);
+		CHECK(getRuleFilePath(resolveMap) == ruleFilePath);
+		CHECK(std::filesystem::last_write_time(ruleFilePath) == modificationTime);
+	}
+
+	SECTION("extracted again if files are missing") {
+		std::filesystem::remove(ruleFilePath);
+		ResolveMapCache resolveMapCache(prtCtx->mPRTCache.get(), mirrorDir);
+		const ResolveMapSPtr resolveMap = resolveMapCache.get(rpk.wstring()).first;
+		REQUIRE(resolveMap);
+		CHECK(getRuleFilePath(resolveMap) == ruleFilePath);
+		CHECK(std::filesystem::is_regular_file(ruleFilePath));
+		CHECK(getMirrorDirs() == mirrorDirs);
+	}
+
+	std::filesystem::remove_all(mirrorDir);
+}
+
+TEST_CASE("rule package modified without the file watcher noticing") {
+	const std::filesystem::path rpk = testDataPath + L"/CE-6813-wrong-attr-style.rpk";
+	const std::filesystem::path copyDir = std::filesystem::temp_directory_path() / L"serlio_test_rpk_revalidate";
+	std::filesystem::remove_all(copyDir);
+	std::filesystem::create_directories(copyDir);
+	const std::filesystem::path rpkCopy = copyDir / L"copy.rpk";
+	std::filesystem::copy_file(rpk, rpkCopy);
+
+	const std::filesystem::path rpkCopySpelling = copyDir / L"." / L"copy.rpk";
+
+	ResolveMapCache& resolveMapCache = *prtCtx->mResolveMapCache;
+	const ResolveMapSPtr resolveMap = resolveMapCache.get(rpkCopy.wstring()).first;
+	REQUIRE(resolveMap);
+	REQUIRE(resolveMapCache.get(rpkCopySpelling.wstring()).first == resolveMap);
+	CHECK_FALSE(resolveMapCache.revalidate(rpkCopy.wstring()));
+
+	std::vector<std::vector<std::wstring>> invalidations;
+	resolveMapCache.setInvalidationListener(
+	        [&invalidations](const std::vector<std::wstring>& rpks) { invalidations.push_back(rpks); });
+
+	// e.g. a network share, the watcher does not report the modification
+	resolveMapCache.stop();
+	std::filesystem::last_write_time(rpkCopy, std::filesystem::last_write_time(rpkCopy) + std::chrono::hours(1));
+	CHECK(resolveMapCache.revalidate(rpkCopy.wstring()));
+	CHECK_FALSE(resolveMapCache.revalidate(rpkCopy.wstring()));
+	resolveMapCache.setInvalidationListener({});
+
+	// all spellings of the rpk are reported at once
+	REQUIRE(invalidations.size() == 1);
+	std::sort(invalidations[0].begin(), invalidations[0].end());
+	CHECK(invalidations[0] == std::vector<std::wstring>{rpkCopySpelling.wstring(), rpkCopy.wstring()});
+
+	const ResolveMapCache::LookupResult lookupResult = resolveMapCache.get(rpkCopy.wstring());
+	CHECK(lookupResult.second == ResolveMapCache::CacheStatus::MISS);
+	CHECK(lookupResult.first != resolveMap);
+
+	std::filesystem::remove_all(copyDir);
+}
+
+TEST_CASE("resolve map cache budget") {
+	const std::filesystem::path rpk = testDataPath + L"/CE-6813-wrong-attr-style.rpk";
+	const std::filesystem::path copyDir = std::filesystem::temp_directory_path() / L"serlio_test_rpk_budget";
+	std::filesystem::remove_all(copyDir);
+	std::filesystem::create_directories(copyDir);
+
+	// a copy with different content, the trailing byte after the archive is ignored when reading it
+	const std::filesystem::path rpkCopy = copyDir / L"copy.rpk";
+	std::filesystem::copy_file(rpk, rpkCopy);
+	std::ofstream(rpkCopy, std::ofstream::binary | std::ofstream::app).put('\0');
+	const uintmax_t rpkSize = std::filesystem::file_size(rpk);
+	const uintmax_t rpkCopySize = std::filesystem::file_size(rpkCopy);
+
+	ResolveMapCache resolveMapCache(prtCtx->mPRTCache.get());
+	ResolveMapCache::UsageToken token = resolveMapCache.acquire(rpk.wstring());
+	REQUIRE(token);
+	REQUIRE(resolveMapCache.get(rpkCopy.wstring()).first);
+
+	ResolveMapCache::Usage usage = resolveMapCache.getUsage();
+	CHECK(usage.mRulePackageCount == 2);
+	CHECK(usage.mInUseCount == 1);
+	CHECK(usage.mSize == rpkSize + rpkCopySize);
+
+	// the unused copy is evicted, the rpk in use is kept although it exceeds the budget
+	resolveMapCache.setBudget(1);
+	usage = resolveMapCache.getUsage();
+	CHECK(usage.mRulePackageCount == 1);
+	CHECK(usage.mInUseCount == 1);
+	CHECK(usage.mSize == rpkSize);
+	CHECK(resolveMapCache.get(rpk.wstring()).second == ResolveMapCache::CacheStatus::HIT);
+	CHECK(resolveMapCache.get(rpkCopy.wstring()).second == ResolveMapCache::CacheStatus::MISS);
+
+	// the entry just looked up is not evicted right away
+	CHECK(resolveMapCache.getUsage().mRulePackageCount == 2);
+
+	token.reset();
+	resolveMapCache.setBudget(1);
+	usage = resolveMapCache.getUsage();
+	CHECK(usage.mRulePackageCount == 0);
+	CHECK(usage.mSize == 0);
+	CHECK(resolveMapCache.get(rpk.wstring()).second == ResolveMapCache::CacheStatus::MISS);
+
+	resolveMapCache.stop();
+	std::filesystem::remove_all(copyDir);
+}
+
 const AttributeGroup AG_NONE = {};
 const AttributeGroup AG_A = {L"a"};
 const AttributeGroup AG_AK = {L"a", L"k"};
@@ -346,6 +538,538 @@ TEST_CASE("toFileURI") {
 #endif
 }
 
+TEST_CASE("fromFileURI") {
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / L"foo bar.jpg";
+	CHECK(prtu::fromFileURI(prtu::toFileURI(path.generic_wstring())) == path.generic_wstring());
+	CHECK(prtu::fromFileURI(L"file:/tmp/foo%20bar.jpg").generic_wstring().find(L"foo bar.jpg") != std::wstring::npos);
+	CHECK(prtu::fromFileURI(L"memory://1234/foo.jpg").empty());
+}
+
+TEST_CASE("ContentHash") {
+	SECTION("reference values") {
+		CHECK(ContentHash::hash(nullptr, 0) == 0xef46db3751d8e999ull);
+		CHECK(ContentHash::hash("abc", 3) == 0x44bc2cf5ad770999ull);
+	}
+	SECTION("streaming") {
+		std::vector<uint8_t> data(1000);
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = static_cast<uint8_t>(i * 31);
+
+		ContentHash contentHash;
+		for (size_t offset = 0; offset < data.size(); offset += 7)
+			contentHash.update(data.data() + offset, std::min<size_t>(7, data.size() - offset));
+		CHECK(contentHash.digest() == ContentHash::hash(data.data(), data.size()));
+	}
+}
+
+TEST_CASE("moveHolesToParentFaces") {
+	// face 0: quad with the hole face 1, face 2: triangle
+	IMayaCallbacks::MeshBuffer mesh;
+	mesh.mCoords.resize(11 * 3);
+	mesh.mFaceCounts = {4, 4, 3};
+	mesh.mVertexIndices = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+	mesh.mNormalIndices = mesh.mVertexIndices;
+	mesh.mHoleCounts = {1, 0, 0};
+	mesh.mHoleIndices = {1};
+	mesh.mUvs = {std::vector<double>(11 * 2), std::vector<double>(3 * 2)};
+	mesh.mUvCounts = {{4, 4, 3}, {0, 0, 3}};
+	mesh.mUvIndices = {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10}, {0, 1, 2}};
+	mesh.mFaceRanges = {0, 2, 3};
+
+	const OuterLoops outerLoops = moveHolesToParentFaces(mesh);
+
+	CHECK(outerLoops.faceCounts == std::vector<uint32_t>{4, 3});
+	CHECK(outerLoops.vertexIndices == std::vector<uint32_t>{0, 1, 2, 3, 8, 9, 10});
+	REQUIRE(outerLoops.holes.size() == 1);
+	CHECK(outerLoops.holes[0].face == 0);
+	CHECK(outerLoops.holes[0].loopCounts == std::vector<uint32_t>{4});
+	CHECK(outerLoops.holes[0].vertexIndices == std::vector<uint32_t>{4, 5, 6, 7});
+
+	// the hole loops are appended to the loop of their parent face
+	CHECK(mesh.mFaceCounts == std::vector<uint32_t>{8, 3});
+	CHECK(mesh.mVertexIndices == std::vector<uint32_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+	CHECK(mesh.mNormalIndices == mesh.mVertexIndices);
+	CHECK(mesh.mHoleCounts.empty());
+	CHECK(mesh.mHoleIndices.empty());
+
+	// uvs are dropped for faces with a loop without uvs
+	CHECK(mesh.mUvCounts[0] == std::vector<uint32_t>{8, 3});
+	CHECK(mesh.mUvIndices[0] == std::vector<uint32_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+	CHECK(mesh.mUvCounts[1] == std::vector<uint32_t>{0, 3});
+	CHECK(mesh.mUvIndices[1] == std::vector<uint32_t>{0, 1, 2});
+
+	CHECK(mesh.mFaceRanges == std::vector<uint32_t>{0, 1, 2});
+}
+
+TEST_CASE("weldVertices") {
+	// two quads with coincident vertices along their shared edge
+	std::vector<double> coords = {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 0, 0, 2, 0, 0, 2, 1, 0, 1, 1.00001, 0};
+	const std::vector<uint32_t> counts = {4, 4};
+	std::vector<uint32_t> vertexIndices = {0, 1, 2, 3, 4, 5, 6, 7};
+
+	SECTION("coincident vertices") {
+		REQUIRE(VertexWelding::weldVertices(coords, counts, vertexIndices, 1e-4));
+		CHECK(coords.size() == 6 * 3);
+		CHECK(vertexIndices == std::vector<uint32_t>{0, 1, 2, 3, 1, 4, 5, 2});
+	}
+
+	SECTION("tolerance smaller than the distance") {
+		REQUIRE(VertexWelding::weldVertices(coords, counts, vertexIndices, 1e-6));
+		CHECK(coords.size() == 7 * 3);
+		CHECK(vertexIndices == std::vector<uint32_t>{0, 1, 2, 3, 1, 4, 5, 6});
+	}
+
+	SECTION("collapsing face") {
+		const std::vector<uint32_t> triangleCounts = {3, 3};
+		std::vector<uint32_t> triangleIndices = {0, 1, 2, 1, 4, 5};
+		REQUIRE(VertexWelding::weldVertices(coords, triangleCounts, triangleIndices, 1e-4));
+		CHECK(triangleIndices == std::vector<uint32_t>{0, 1, 2, 1, 3, 4});
+		CHECK(coords.size() == 5 * 3);
+	}
+
+	SECTION("invalid tolerance") {
+		const std::vector<double> originalCoords = coords;
+		const std::vector<uint32_t> originalIndices = vertexIndices;
+		for (const double tolerance : {0.0, -1.0, std::numeric_limits<double>::quiet_NaN(),
+		                               std::numeric_limits<double>::infinity()}) {
+			CHECK_FALSE(VertexWelding::weldVertices(coords, counts, vertexIndices, tolerance));
+			CHECK(coords == originalCoords);
+			CHECK(vertexIndices == originalIndices);
+		}
+	}
+
+	SECTION("tiny tolerance and huge coordinates") {
+		std::vector<double> farCoords = {1e300, 0, 0, -1e300, 1, 0, 1e300, 0, 0, 0, 0, 0};
+		farCoords.insert(farCoords.end(), {std::numeric_limits<double>::infinity(), 0, 0});
+		const std::vector<uint32_t> farCounts = {5};
+		std::vector<uint32_t> farIndices = {0, 1, 2, 3, 4};
+		REQUIRE(VertexWelding::weldVertices(farCoords, farCounts, farIndices, 1e-300));
+		CHECK(farIndices == std::vector<uint32_t>{0, 1, 2, 3, 4}); // collapses, keeps its vertices
+		CHECK(farCoords.size() == 5 * 3);
+	}
+}
+
+// not run by default, use "serlio_test [benchmark]"
+TEST_CASE("JobPool") {
+	constexpr size_t JOB_COUNT = 1000;
+
+	SECTION("concurrent runs") {
+		constexpr size_t CALLER_COUNT = 4;
+		JobPool pool(3);
+		std::vector<std::vector<std::atomic<size_t>>> executions;
+		for (size_t c = 0; c < CALLER_COUNT; c++)
+			executions.emplace_back(JOB_COUNT);
+
+		std::vector<std::thread> callers;
+		for (size_t c = 0; c < CALLER_COUNT; c++)
+			callers.emplace_back([&, c]() { pool.run(JOB_COUNT, 8, [&](size_t i) { executions[c][i]++; }); });
+		for (std::thread& caller : callers)
+			caller.join();
+
+		for (const std::vector<std::atomic<size_t>>& callerExecutions : executions) {
+			CHECK(std::all_of(callerExecutions.begin(), callerExecutions.end(),
+			                  [](const std::atomic<size_t>& e) { return e == 1; }));
+		}
+	}
+
+	SECTION("on the calling thread only") {
+		const std::thread::id caller = std::this_thread::get_id();
+		size_t jobCount = 0;
+		auto job = [&](size_t) {
+			if (std::this_thread::get_id() == caller)
+				jobCount++;
+		};
+
+		JobPool pool(4);
+		pool.run(JOB_COUNT, 1, job);
+		CHECK(jobCount == JOB_COUNT);
+
+		// without helper threads
+		JobPool emptyPool(0);
+		emptyPool.run(JOB_COUNT, 8, job);
+		CHECK(jobCount == 2 * JOB_COUNT);
+	}
+}
+
+TEST_CASE("asset cache with large texture sets", "[.][benchmark]") {
+	constexpr size_t TEXTURE_COUNT = 64;
+	constexpr size_t TEXTURE_SIZE = 4 * 1024 * 1024;
+
+	std::vector<std::vector<uint8_t>> textures(TEXTURE_COUNT, std::vector<uint8_t>(TEXTURE_SIZE));
+	for (size_t t = 0; t < textures.size(); t++) {
+		for (size_t i = 0; i < TEXTURE_SIZE; i++)
+			textures[t][i] = static_cast<uint8_t>((i + t) * 2654435761u >> 24);
+	}
+
+	BENCHMARK("std::hash") {
+		size_t result = 0;
+		for (const auto& texture : textures)
+			result ^= std::hash<std::string_view>{}({reinterpret_cast<const char*>(texture.data()), texture.size()});
+		return result;
+	};
+
+	BENCHMARK("ContentHash") {
+		uint64_t result = 0;
+		for (const auto& texture : textures)
+			result ^= ContentHash::hash(texture.data(), texture.size());
+		return result;
+	};
+
+	const std::filesystem::path cacheRootDir = std::filesystem::temp_directory_path() / L"serlio_test_asset_cache";
+	std::filesystem::create_directories(cacheRootDir);
+	const std::wstring rpkURI = L"rpk:" + prtu::toFileURI(testDataPath + L"/CE-6813-wrong-attr-style.rpk");
+
+	AssetCache assetCache;
+	auto putAll = [&]() {
+		for (size_t t = 0; t < textures.size(); t++) {
+			const std::wstring uri = rpkURI + L"!/textures/t" + std::to_wstring(t) + L".png";
+			const std::wstring fileName = L"t" + std::to_wstring(t) + L".png";
+			assetCache.put(uri.c_str(), fileName.c_str(), L"final", cacheRootDir, textures[t].data(),
+			               textures[t].size());
+		}
+	};
+
+	putAll(); // populates the cache, subsequent puts take the rpk fast path
+	BENCHMARK("AssetCache::put (cached)") {
+		putAll();
+	};
+
+	assetCache.flush();
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+}
+
+TEST_CASE("FileWatcher") {
+	const std::filesystem::path watchedDir = std::filesystem::temp_directory_path() / L"serlio_test_file_watcher";
+	std::filesystem::create_directories(watchedDir);
+	const std::filesystem::path watchedFile = watchedDir / L"rules.rpk";
+	std::ofstream(watchedFile) << "initial";
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::vector<std::filesystem::path> changedFiles;
+	auto waitForChange = [&]() -> std::filesystem::path {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!changed.wait_for(lock, 10 * FileWatcher::POLL_INTERVAL, [&]() { return !changedFiles.empty(); }))
+			return {};
+		return changedFiles.front();
+	};
+
+	{
+		FileWatcher fileWatcher([&](const std::filesystem::path& file) {
+			std::lock_guard<std::mutex> lock(mutex);
+			changedFiles.push_back(file);
+			changed.notify_all();
+		});
+		fileWatcher.watch(watchedFile);
+
+		SECTION("modified in place") {
+			std::ofstream(watchedFile) << "modified";
+			CHECK(waitForChange() == watchedFile);
+		}
+
+		SECTION("replaced") {
+			const std::filesystem::path newFile = watchedDir / L"rules.rpk.new";
+			std::ofstream(newFile) << "replaced";
+			std::filesystem::rename(newFile, watchedFile);
+			CHECK(waitForChange() == watchedFile);
+		}
+
+		SECTION("stopped and started again") {
+			fileWatcher.stop();
+			fileWatcher.watch(watchedFile);
+			std::ofstream(watchedFile) << "modified";
+			CHECK(waitForChange() == watchedFile);
+		}
+	}
+
+	std::filesystem::remove_all(watchedDir);
+}
+
+TEST_CASE("concurrent asset cache puts") {
+	constexpr size_t THREAD_COUNT = 8;
+	constexpr size_t TEXTURE_COUNT = 32;
+	constexpr size_t TEXTURE_SIZE = 64 * 1024;
+	constexpr size_t ITERATIONS = 4;
+
+	// every second texture shares its content with its predecessor
+	std::vector<std::vector<uint8_t>> textures(TEXTURE_COUNT, std::vector<uint8_t>(TEXTURE_SIZE));
+	for (size_t t = 0; t < textures.size(); t++) {
+		for (size_t i = 0; i < TEXTURE_SIZE; i++)
+			textures[t][i] = static_cast<uint8_t>((i + t / 2) * 2654435761u >> 24);
+	}
+
+	const std::filesystem::path cacheRootDir =
+	        std::filesystem::temp_directory_path() / L"serlio_test_concurrent_asset_cache";
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+	std::filesystem::create_directories(cacheRootDir);
+	const std::wstring rpkURI = L"rpk:" + prtu::toFileURI(testDataPath + L"/CE-6813-wrong-attr-style.rpk");
+
+	AssetCache assetCache;
+	std::vector<std::vector<std::filesystem::path>> results(THREAD_COUNT);
+	std::vector<std::thread> threads;
+	for (size_t thread = 0; thread < THREAD_COUNT; thread++) {
+		threads.emplace_back([&, thread]() {
+			for (size_t iteration = 0; iteration < ITERATIONS; iteration++) {
+				for (size_t t = 0; t < textures.size(); t++) {
+					// the rpk textures take the fast path, the in-memory ones are hashed each time
+					const std::wstring uri = ((t % 4 < 2) ? rpkURI + L"!/textures/t" : L"memory://textures/t") +
+					                         std::to_wstring(t) + L".png";
+					const std::wstring fileName = L"t" + std::to_wstring(t) + L".png";
+					const std::filesystem::path assetPath = assetCache.put(
+					        uri.c_str(), fileName.c_str(), L"final", cacheRootDir, textures[t].data(), TEXTURE_SIZE);
+					if (iteration == 0)
+						results[thread].push_back(assetPath);
+					else if (results[thread][t] != assetPath)
+						results[thread][t].clear(); // CHECK is not thread-safe
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	assetCache.flush();
+
+	for (size_t t = 0; t < TEXTURE_COUNT; t++) {
+		REQUIRE_FALSE(results[0][t].empty());
+		CHECK(std::filesystem::file_size(results[0][t]) == TEXTURE_SIZE);
+		for (size_t thread = 1; thread < THREAD_COUNT; thread++)
+			CHECK(results[thread][t] == results[0][t]);
+	}
+
+	// textures with the same content share one file, regardless of their uri and name
+	for (size_t t = 0; t < TEXTURE_COUNT; t += 2)
+		CHECK(results[0][t] == results[0][t + 1]);
+	const auto fileCount = std::distance(std::filesystem::directory_iterator(cacheRootDir), {});
+	CHECK(fileCount == TEXTURE_COUNT / 2);
+
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+}
+
+TEST_CASE("asset cache manifest") {
+	const std::filesystem::path cacheRootDir =
+	        std::filesystem::temp_directory_path() / L"serlio_test_asset_cache_manifest";
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+	std::filesystem::create_directories(cacheRootDir);
+
+	const std::wstring uri =
+	        L"rpk:" + prtu::toFileURI(testDataPath + L"/CE-6813-wrong-attr-style.rpk") + L"!/textures/a.png";
+	const std::vector<uint8_t> texture(64 * 1024, 1);
+	// same uri and size, only a fast path hit returns the path of the first texture without hashing this one
+	const std::vector<uint8_t> otherTexture(texture.size(), 2);
+
+	std::filesystem::path assetPath;
+	{
+		AssetCache assetCache;
+		assetPath = assetCache.put(uri.c_str(), L"a.png", L"final", cacheRootDir, texture.data(), texture.size());
+	}
+	REQUIRE(std::filesystem::exists(assetPath));
+
+	{
+		AssetCache assetCache;
+		CHECK(assetCache.put(uri.c_str(), L"a.png", L"final", cacheRootDir, otherTexture.data(),
+		                     otherTexture.size()) == assetPath);
+		CHECK(assetCache.getUsage(cacheRootDir).mAssetCount == 1);
+	}
+
+	// the record does not match the modified file anymore
+	std::ofstream(assetPath, std::ofstream::binary | std::ofstream::app).put('\0');
+	{
+		AssetCache assetCache;
+		const std::filesystem::path otherAssetPath = assetCache.put(uri.c_str(), L"a.png", L"final", cacheRootDir,
+		                                                            otherTexture.data(), otherTexture.size());
+		CHECK(otherAssetPath != assetPath);
+		assetCache.flush();
+		CHECK(std::filesystem::file_size(otherAssetPath) == otherTexture.size());
+	}
+
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+}
+
+TEST_CASE("asset cache manifest records of shared files") {
+	const std::filesystem::path cacheRootDir =
+	        std::filesystem::temp_directory_path() / L"serlio_test_asset_cache_shared_records";
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+	std::filesystem::create_directories(cacheRootDir);
+
+	// the second uri shares the file of the first one while it is still being written (behind the large ones)
+	const std::vector<uint8_t> texture(64 * 1024, 42);
+	std::filesystem::path assetPath;
+	{
+		AssetCache assetCache;
+		for (uint8_t i = 0; i < 4; i++) {
+			const std::vector<uint8_t> largeTexture(16 * 1024 * 1024, i);
+			const std::wstring uri = L"memory://large" + std::to_wstring(i) + L".png";
+			assetCache.put(uri.c_str(), L"large.png", L"final", cacheRootDir, largeTexture.data(), largeTexture.size());
+		}
+		assetPath = assetCache.put(L"memory://a.png", L"a.png", L"final", cacheRootDir, texture.data(), texture.size());
+		CHECK(assetCache.put(L"memory://b.png", L"b.png", L"final", cacheRootDir, texture.data(), texture.size()) ==
+		      assetPath);
+	}
+
+	std::ifstream manifest(AssetCache::getManifestPath(cacheRootDir));
+	std::vector<std::string> records;
+	for (std::string line; std::getline(manifest, line);) {
+		if (line.compare(0, 2, "@\t") != 0)
+			records.push_back(line);
+	}
+	REQUIRE(records.size() == 7); // including the header
+	CHECK(std::count_if(records.begin(), records.end(), [](const std::string& record) {
+		      return record.compare(0, 15, "memory://a.png\t") == 0 || record.compare(0, 15, "memory://b.png\t") == 0;
+	      }) == 2);
+
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+}
+
+TEST_CASE("AssetWriter") {
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / L"serlio_test_asset_writer";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+
+	auto hasTemporaryFiles = [&dir]() {
+		return std::any_of(std::filesystem::directory_iterator(dir), {},
+		                   [](const auto& entry) { return entry.path().extension() == L".tmp"; });
+	};
+
+	SECTION("flush waits for all files") {
+		constexpr size_t FILE_COUNT = 16;
+		const std::vector<uint8_t> data(256 * 1024, 42);
+		std::atomic<size_t> writtenCount = 0;
+		AssetWriter writer;
+		for (size_t i = 0; i < FILE_COUNT; i++) {
+			writer.write(dir / (std::to_wstring(i) + L".png"), data.data(), data.size(), [&writtenCount](bool success) {
+				if (success)
+					writtenCount++;
+			});
+		}
+		writer.flush();
+
+		CHECK(writtenCount == FILE_COUNT);
+		for (size_t i = 0; i < FILE_COUNT; i++)
+			CHECK(std::filesystem::file_size(dir / (std::to_wstring(i) + L".png")) == data.size());
+		CHECK_FALSE(hasTemporaryFiles());
+	}
+
+	SECTION("a job larger than the limit is admitted, the next one waits for it") {
+		constexpr size_t MAX_PENDING_BYTES = 1024;
+		const std::vector<uint8_t> data(4 * MAX_PENDING_BYTES, 42);
+		std::promise<void> release;
+		std::shared_future<void> released = release.get_future().share();
+
+		AssetWriter writer(MAX_PENDING_BYTES);
+		writer.write(dir / L"large.png", data.data(), data.size(), [released](bool) { released.wait(); });
+
+		// the large job stays pending until its callback returns
+		std::future<void> smallWrite = std::async(std::launch::async, [&]() {
+			writer.write(dir / L"small.png", data.data(), 16, {});
+		});
+		CHECK(smallWrite.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout);
+
+		release.set_value();
+		smallWrite.get();
+		writer.flush();
+		CHECK(std::filesystem::file_size(dir / L"large.png") == data.size());
+		CHECK(std::filesystem::file_size(dir / L"small.png") == 16);
+	}
+
+	SECTION("failed writes") {
+		const std::vector<uint8_t> data(1024, 42);
+		std::filesystem::create_directories(dir / L"existing_dir.png" / L"file");
+		std::vector<bool> results;
+		std::mutex resultsMutex;
+		auto onWritten = [&](bool success) {
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			results.push_back(success);
+		};
+
+		AssetWriter writer;
+		writer.write(dir / L"missing_dir" / L"a.png", data.data(), data.size(), onWritten);
+		writer.write(dir / L"existing_dir.png", data.data(), data.size(), onWritten); // fails to replace the dir
+		writer.flush();
+
+		CHECK(results == std::vector<bool>{false, false});
+		CHECK(std::filesystem::is_directory(dir / L"existing_dir.png"));
+		CHECK_FALSE(hasTemporaryFiles());
+	}
+
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("asset cache pruning") {
+	const std::filesystem::path cacheRootDir = std::filesystem::temp_directory_path() / L"serlio_test_asset_cache_prune";
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+	std::filesystem::create_directories(cacheRootDir);
+
+	constexpr size_t TEXTURE_SIZE = 1000;
+	const std::wstring rpkURI = L"rpk:" + prtu::toFileURI(testDataPath + L"/CE-6813-wrong-attr-style.rpk");
+	const std::vector<std::wstring> uris = {L"memory://a.png", L"memory://b.png", L"memory://c.png",
+	                                        rpkURI + L"!/textures/d.png", L"memory://e.png"};
+	std::vector<std::vector<uint8_t>> textures;
+	for (size_t t = 0; t < uris.size(); t++)
+		textures.emplace_back(TEXTURE_SIZE, static_cast<uint8_t>(t));
+
+	auto putTexture = [&](AssetCache& assetCache, size_t t) {
+		const std::wstring fileName = std::filesystem::path(uris[t]).filename().wstring();
+		return assetCache.put(uris[t].c_str(), fileName.c_str(), L"final", cacheRootDir, textures[t].data(),
+		                      TEXTURE_SIZE);
+	};
+
+	std::vector<std::filesystem::path> assetPaths;
+	{
+		AssetCache assetCache;
+		for (size_t t = 0; t < uris.size(); t++)
+			assetPaths.push_back(putTexture(assetCache, t));
+	}
+
+	// access records of later sessions, the least recently used asset (e) is protected
+	const std::vector<time_t> accessOffsets = {3, 1, 4, 2}; // hours
+	{
+		std::ofstream manifest(AssetCache::getManifestPath(cacheRootDir), std::ofstream::app);
+		for (size_t t = 0; t < accessOffsets.size(); t++) {
+			const time_t accessTime =
+			        prtu::getFileModificationTime(assetPaths[t].wstring()) + accessOffsets[t] * 60 * 60;
+			manifest << "@\t" << assetPaths[t].filename().string() << '\t' << accessTime << '\n';
+		}
+	}
+
+	AssetCache assetCache;
+	const AssetCache::Usage usage = assetCache.getUsage(cacheRootDir);
+	CHECK(usage.mAssetCount == uris.size());
+	CHECK(usage.mSize == uris.size() * TEXTURE_SIZE);
+
+	const uintmax_t budget = 2 * TEXTURE_SIZE + TEXTURE_SIZE / 2;
+	const AssetCache::Usage removed = assetCache.prune(cacheRootDir, budget, {assetPaths[4]});
+	CHECK(removed.mAssetCount == 3);
+	CHECK(removed.mSize == 3 * TEXTURE_SIZE);
+	CHECK_FALSE(std::filesystem::exists(assetPaths[0]));
+	CHECK_FALSE(std::filesystem::exists(assetPaths[1]));
+	CHECK(std::filesystem::exists(assetPaths[2]));
+	CHECK_FALSE(std::filesystem::exists(assetPaths[3]));
+	CHECK(std::filesystem::exists(assetPaths[4]));
+	CHECK(assetCache.getUsage(cacheRootDir).mAssetCount == 2);
+
+	// the cache and fast path entries of the removed assets are gone, they are written again
+	for (size_t t = 0; t < uris.size(); t++)
+		CHECK(putTexture(assetCache, t) == assetPaths[t]);
+	assetCache.flush();
+	for (const std::filesystem::path& assetPath : assetPaths)
+		CHECK(std::filesystem::exists(assetPath));
+	CHECK(assetCache.getUsage(cacheRootDir).mAssetCount == uris.size());
+
+	// nothing to remove within the budget
+	CHECK(assetCache.prune(cacheRootDir, uris.size() * TEXTURE_SIZE, {}).mAssetCount == 0);
+
+	std::filesystem::remove_all(cacheRootDir);
+	std::filesystem::remove(AssetCache::getManifestPath(cacheRootDir));
+}
+
 TEST_CASE("getDuplicateCountSuffix") {
 	std::map<std::wstring, int> duplicateCountMap;
 